@@ -0,0 +1,224 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Throughput of the neovideoconv element in
+ *   appsrc ! neovideoconv ! video/x-raw,format=GRAY8 ! fakesink
+ * for several resolutions, input formats and kernel sets, the latter forced
+ * through NEOVIDEOCONV_KERNELS. Prints one JSON document on stdout.
+ *
+ * Run from the build directory with GST_PLUGIN_PATH pointing at the
+ * videoeffects plugin, `meson test --benchmark` does that.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+#include <gst/video/video.h>
+
+#include "neovideoconv-kernels.h"
+
+/* roughly this many pixels go through each configuration */
+#define PIXELS_PER_RUN 2000000000.0
+#define MIN_FRAMES 10
+#define MAX_FRAMES 1000
+
+static const struct
+{
+  const gchar *name;
+  gint width;
+  gint height;
+} resolutions[] = {
+  {"720p", 1280, 720},
+  {"1080p", 1920, 1080},
+  {"4k", 3840, 2160},
+  {"8k", 7680, 4320},
+};
+
+static const struct
+{
+  const gchar *format;
+  gboolean uses_kernels;
+} formats[] = {
+  {"RGB", TRUE},
+  {"BGRx", TRUE},
+  {"RGBA", TRUE},
+  {"I420", FALSE},
+  {"NV12", FALSE},
+};
+
+/* Pushes @n_frames frames through the pipeline and returns the elapsed
+ * time in microseconds, or -1 if the pipeline failed */
+static gint64
+run_pipeline (const gchar * format, gint width, gint height, guint n_threads,
+    guint n_frames)
+{
+  GstElement *pipeline, *src;
+  GstVideoInfo info;
+  GstCaps *caps;
+  GstBuffer *frame;
+  GstBus *bus;
+  GstMessage *msg;
+  GError *err = NULL;
+  gchar *desc;
+  gint64 start, elapsed = -1;
+  guint i;
+
+  desc = g_strdup_printf ("appsrc name=src format=time block=true "
+      "max-bytes=0 ! neovideoconv n-threads=%u ! "
+      "video/x-raw,format=GRAY8 ! fakesink sync=false", n_threads);
+  pipeline = gst_parse_launch (desc, &err);
+  g_free (desc);
+  if (!pipeline) {
+    g_printerr ("could not create pipeline: %s\n", err->message);
+    g_clear_error (&err);
+    return -1;
+  }
+
+  gst_video_info_set_format (&info, gst_video_format_from_string (format),
+      width, height);
+  GST_VIDEO_INFO_FPS_N (&info) = 30;
+  GST_VIDEO_INFO_FPS_D (&info) = 1;
+  caps = gst_video_info_to_caps (&info);
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  g_object_set (src, "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  /* one frame of noise whose memory is shared by every pushed buffer */
+  frame = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (&info), NULL);
+  {
+    GstMapInfo map;
+    gsize j;
+
+    gst_buffer_map (frame, &map, GST_MAP_WRITE);
+    for (j = 0; j < map.size; j++)
+      map.data[j] = g_random_int_range (0, 256);
+    gst_buffer_unmap (frame, &map);
+  }
+
+  bus = gst_element_get_bus (pipeline);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_frames; i++) {
+    GstBuffer *buf = gst_buffer_copy (frame);
+
+    GST_BUFFER_PTS (buf) = gst_util_uint64_scale (i, GST_SECOND, 30);
+    GST_BUFFER_DURATION (buf) = GST_SECOND / 30;
+    if (gst_app_src_push_buffer (GST_APP_SRC (src), buf) != GST_FLOW_OK)
+      break;
+  }
+  gst_app_src_end_of_stream (GST_APP_SRC (src));
+
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS) {
+    elapsed = g_get_monotonic_time () - start;
+  } else {
+    gst_message_parse_error (msg, &err, NULL);
+    g_printerr ("%s %dx%d failed: %s\n", format, width, height, err->message);
+    g_clear_error (&err);
+  }
+  gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_buffer_unref (frame);
+  gst_object_unref (bus);
+  gst_object_unref (src);
+  gst_object_unref (pipeline);
+
+  return elapsed;
+}
+
+static gboolean
+report (const gchar * format, gint width, gint height, const gchar * res,
+    const gchar * kernel, guint n_threads, gboolean * first)
+{
+  gdouble pixels = (gdouble) width * height;
+  guint n_frames;
+  gint64 usecs;
+
+  n_frames = CLAMP (PIXELS_PER_RUN / pixels, MIN_FRAMES, MAX_FRAMES);
+  usecs = run_pipeline (format, width, height, n_threads, n_frames);
+  if (usecs <= 0)
+    return FALSE;
+
+  g_print ("%s\n    {\"format\": \"%s\", \"resolution\": \"%s\", "
+      "\"width\": %d, \"height\": %d, \"kernel\": \"%s\", \"n_threads\": %u, "
+      "\"frames\": %u, \"frames_per_sec\": %.1f, \"ns_per_pixel\": %.4f}",
+      *first ? "" : ",", format, res, width, height, kernel, n_threads,
+      n_frames, n_frames * 1e6 / usecs, usecs * 1000.0 / (pixels * n_frames));
+  *first = FALSE;
+
+  return TRUE;
+}
+
+int
+main (int argc, char *argv[])
+{
+  const NeoKernels *const *k;
+  GstElementFactory *factory;
+  gboolean first = TRUE, ok = TRUE;
+  guint r, f;
+
+  gst_init (&argc, &argv);
+
+  factory = gst_element_factory_find ("neovideoconv");
+  if (!factory) {
+    g_printerr ("neovideoconv not found, check GST_PLUGIN_PATH\n");
+    return 1;
+  }
+  gst_object_unref (factory);
+
+  g_print ("{\n  \"benchmark\": \"neovideoconv\",\n  \"results\": [");
+
+  for (r = 0; r < G_N_ELEMENTS (resolutions); r++) {
+    gint width = resolutions[r].width;
+    gint height = resolutions[r].height;
+    const gchar *res = resolutions[r].name;
+
+    for (f = 0; f < G_N_ELEMENTS (formats); f++) {
+      const gchar *format = formats[f].format;
+
+      if (!formats[f].uses_kernels) {
+        g_unsetenv ("NEOVIDEOCONV_KERNELS");
+        ok &= report (format, width, height, res, "none", 1, &first);
+        continue;
+      }
+
+      /* only the sets this CPU runs, the element would silently fall back
+       * to the best one for any other name */
+      for (k = neo_kernels_get_available (); *k; k++) {
+        g_setenv ("NEOVIDEOCONV_KERNELS", (*k)->name, TRUE);
+        ok &= report (format, width, height, res, (*k)->name, 1, &first);
+      }
+
+      /* best kernels with one thread per processor */
+      g_unsetenv ("NEOVIDEOCONV_KERNELS");
+      ok &= report (format, width, height, res, "default", 0, &first);
+    }
+  }
+
+  g_print ("\n  ]\n}\n");
+
+  return ok ? 0 : 1;
+}
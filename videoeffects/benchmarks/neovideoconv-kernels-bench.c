@@ -0,0 +1,157 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Micro-benchmark of the neovideoconv row kernels, called directly on a
+ * 1920x1080 frame for every kernel set, layout and a weighted and the
+ * lightness method, with regular and with non-temporal stores. Every result
+ * is checked against the scalar reference first, a mismatch fails the run.
+ * Prints one JSON document on stdout.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "neovideoconv-kernels.h"
+
+#define WIDTH 1920
+#define HEIGHT 1080
+/* runs per measurement, the fastest one is reported */
+#define RUNS 5
+
+static const struct
+{
+  const gchar *name;
+  gint pstride;
+} layouts[NEO_N_LAYOUTS] = {
+  [NEO_LAYOUT_RGB] = {"RGB", 3},
+  [NEO_LAYOUT_BGR] = {"BGR", 3},
+  [NEO_LAYOUT_RGBX] = {"RGBx", 4},
+  [NEO_LAYOUT_BGRX] = {"BGRx", 4},
+  [NEO_LAYOUT_XRGB] = {"xRGB", 4},
+  [NEO_LAYOUT_XBGR] = {"xBGR", 4},
+};
+
+static const struct
+{
+  const gchar *name;
+  NeoLumaMethod method;
+} methods[] = {
+  {"bt601", NEO_LUMA_BT601},
+  {"lightness", NEO_LUMA_LIGHTNESS},
+};
+
+static const struct
+{
+  const gchar *name;
+  gboolean stream;
+} stores[] = {
+  {"regular", FALSE},
+  {"streaming", TRUE},
+};
+
+static gint64
+time_frame (NeoToGray8Func func, guint8 * dest, const guint8 * src,
+    gint pstride, const NeoLuma * luma)
+{
+  gint64 start, best = G_MAXINT64;
+  gint run, row;
+
+  for (run = 0; run < RUNS; run++) {
+    start = g_get_monotonic_time ();
+    for (row = 0; row < HEIGHT; row++)
+      func (dest + row * WIDTH, src + row * WIDTH * pstride, WIDTH, luma);
+    best = MIN (best, g_get_monotonic_time () - start);
+  }
+
+  return best;
+}
+
+int
+main (int argc, char *argv[])
+{
+  const NeoKernels *const *kernels = neo_kernels_get_available ();
+  const NeoKernels *reference = neo_kernels_get_by_name ("scalar");
+  const NeoKernels *const *k;
+  NeoLuma *luma = g_new (NeoLuma, 1);
+  guint8 *src, *dest, *expected;
+  gboolean first = TRUE, ok = TRUE;
+  guint i, m, l, s;
+
+  src = g_malloc (WIDTH * HEIGHT * 4);
+  dest = g_malloc (WIDTH * HEIGHT);
+  expected = g_malloc (WIDTH * HEIGHT);
+  for (i = 0; i < WIDTH * HEIGHT * 4; i++)
+    src[i] = g_random_int_range (0, 256);
+
+  g_print ("{\n  \"benchmark\": \"neovideoconv-kernels\",\n");
+  g_print ("  \"width\": %d,\n  \"height\": %d,\n", WIDTH, HEIGHT);
+  g_print ("  \"results\": [");
+
+  for (m = 0; m < G_N_ELEMENTS (methods); m++) {
+    neo_luma_init (luma, methods[m].method);
+
+    for (l = 0; l < NEO_N_LAYOUTS; l++) {
+      time_frame (reference->to_gray8[l], expected, src, layouts[l].pstride,
+          luma);
+
+      for (k = kernels; *k; k++) {
+        for (s = 0; s < G_N_ELEMENTS (stores); s++) {
+          NeoToGray8Func func = stores[s].stream ?
+              (*k)->to_gray8_stream[l] : (*k)->to_gray8[l];
+          gint64 usecs;
+          gdouble ns_per_pixel;
+          gboolean identical;
+
+          memset (dest, 0, WIDTH * HEIGHT);
+          usecs = time_frame (func, dest, src, layouts[l].pstride, luma);
+          identical = memcmp (dest, expected, WIDTH * HEIGHT) == 0;
+          ok &= identical;
+          ns_per_pixel = usecs * 1000.0 / (WIDTH * HEIGHT);
+
+          g_print ("%s\n    {\"kernel\": \"%s\", \"format\": \"%s\", "
+              "\"method\": \"%s\", \"stores\": \"%s\", "
+              "\"ns_per_pixel\": %.4f, \"frames_per_sec\": %.1f, "
+              "\"bit_identical\": %s}",
+              first ? "" : ",", (*k)->name, layouts[l].name, methods[m].name,
+              stores[s].name, ns_per_pixel, usecs > 0 ? 1e6 / usecs : 0.0,
+              identical ? "true" : "false");
+          first = FALSE;
+        }
+      }
+    }
+  }
+
+  g_print ("\n  ]\n}\n");
+
+  if (!ok)
+    g_printerr ("kernel output differs from the scalar reference\n");
+
+  g_free (src);
+  g_free (dest);
+  g_free (expected);
+  g_free (luma);
+
+  return ok ? 0 : 1;
+}
@@ -27,6 +27,12 @@
  */
 
 #include "gstneovideoconv.h"
+#include "gstneocolormatrix.h"
+#include "gstneoconvolve.h"
+#include "gstneolut3d.h"
+#include "gstneobatchconv.h"
+#include "gstneomotion.h"
+#include "neotaskpool.h"
 #ifndef VERSION
 #define VERSION "0.0.2"
 #endif
@@ -44,8 +50,22 @@ static gboolean
 plugin_init (GstPlugin * plugin)
 {
   gboolean ret = FALSE;
+
+  /* the workers every element runs its threaded work on */
+  neo_task_pool_init ();
+
   ret |= gst_element_register (plugin, "neovideoconv", GST_RANK_NONE,
       GST_TYPE_NEOVIDEOCONV);
+  ret |= gst_element_register (plugin, "neocolormatrix", GST_RANK_NONE,
+      GST_TYPE_NEOCOLORMATRIX);
+  ret |= gst_element_register (plugin, "neoconvolve", GST_RANK_NONE,
+      GST_TYPE_NEOCONVOLVE);
+  ret |= gst_element_register (plugin, "neolut3d", GST_RANK_NONE,
+      GST_TYPE_NEOLUT3D);
+  ret |= gst_element_register (plugin, "neobatchconv", GST_RANK_NONE,
+      GST_TYPE_NEOBATCHCONV);
+  ret |= gst_element_register (plugin, "neomotion", GST_RANK_NONE,
+      GST_TYPE_NEOMOTION);
   return ret;
 }
 
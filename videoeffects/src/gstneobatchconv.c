@@ -0,0 +1,838 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+/**
+ * SECTION:element-gstneobatchconv
+ *
+ * The neobatchconv element converts many video streams to GRAY8 at once,
+ * for hosts running one pipeline branch per camera. Each requested
+ * sink_%u pad gets a src_%u pad with the same number, carrying the
+ * BT.601 luma of its frames with the neovideoconv kernels.
+ *
+ * Rather than each stream converting on its own thread, the frames that
+ * arrive while a batch is being converted wait for the next one, and
+ * a batch converts the frames of all its streams in one pass on a fixed
+ * pool of n-threads threads, the stream thread that runs it included.
+ * The other stream threads sleep meanwhile, so the number of threads
+ * converting stays the same however many cameras there are, and a batch
+ * runs through the frames back to back while the kernels and tables are
+ * still warm.
+ *
+ * Every stream is negotiated, flushed and ended on its own and its frames
+ * leave in order. A batch only holds the frames that are there when it
+ * starts, so a stalled camera never holds up the others.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 neobatchconv name=b \
+ *     videotestsrc ! video/x-raw,format=BGRx ! b.sink_0 b.src_0 ! fakesink \
+ *     videotestsrc pattern=ball ! video/x-raw,format=I420 ! b.sink_1 b.src_1 ! fakesink
+ * ]|
+ * Converts two streams with one batch worker pool.
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include "gstneobatchconv.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_neobatchconv_debug_category);
+#define GST_CAT_DEFAULT gst_neobatchconv_debug_category
+
+/* prototypes */
+
+static void gst_neobatchconv_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_neobatchconv_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_neobatchconv_finalize (GObject * object);
+
+static GstPad *gst_neobatchconv_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps);
+static void gst_neobatchconv_release_pad (GstElement * element, GstPad * pad);
+static GstStateChangeReturn gst_neobatchconv_change_state (GstElement *
+    element, GstStateChange transition);
+
+static GstFlowReturn gst_neobatchconv_sink_chain (GstPad * pad,
+    GstObject * parent, GstBuffer * buffer);
+static gboolean gst_neobatchconv_sink_event (GstPad * pad,
+    GstObject * parent, GstEvent * event);
+static gboolean gst_neobatchconv_sink_query (GstPad * pad,
+    GstObject * parent, GstQuery * query);
+static GstIterator *gst_neobatchconv_iterate_internal_links (GstPad * pad,
+    GstObject * parent);
+static void gst_neobatchconv_worker_func (gpointer data, gpointer user_data);
+
+enum
+{
+  PROP_0,
+  PROP_N_THREADS,
+  PROP_STATS
+};
+
+#define DEFAULT_N_THREADS 0
+/* upper bound of the threads converting the batches */
+#define MAX_N_THREADS 1024
+
+/* rows of a frame converted by one thread at a time: small frames are one
+ * task, large ones are spread over the pool */
+#define TASK_ROWS 64
+
+/* pad templates */
+
+/* packed layouts converted by their own kernel, and planar YUV whose Y
+ * plane is copied */
+#define VIDEO_SINK_CAPS \
+    GST_VIDEO_CAPS_MAKE("{ RGB, BGR, RGBx, BGRx, xRGB, xBGR, RGBA, BGRA, " \
+        "ARGB, ABGR, I420, NV12, Y444 }")
+
+#define VIDEO_SRC_CAPS \
+    GST_VIDEO_CAPS_MAKE("{ GRAY8 }")
+
+static GstStaticPadTemplate gst_neobatchconv_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (VIDEO_SINK_CAPS));
+
+static GstStaticPadTemplate gst_neobatchconv_src_template =
+GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_SOMETIMES,
+    GST_STATIC_CAPS (VIDEO_SRC_CAPS));
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstNeobatchconv, gst_neobatchconv, GST_TYPE_ELEMENT,
+    GST_DEBUG_CATEGORY_INIT (gst_neobatchconv_debug_category, "neobatchconv",
+        0, "debug category for neobatchconv element"));
+
+static void
+gst_neobatchconv_class_init (GstNeobatchconvClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_neobatchconv_sink_template);
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_neobatchconv_src_template);
+
+  gst_element_class_set_static_metadata (element_class,
+      "Batched grayscale conversion", "Filter/Converter/Video",
+      "Converts many video streams to GRAY8 in batches on one thread pool",
+      "taruntejk@live.com");
+
+  gobject_class->set_property = gst_neobatchconv_set_property;
+  gobject_class->get_property = gst_neobatchconv_get_property;
+  gobject_class->finalize = gst_neobatchconv_finalize;
+  element_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_neobatchconv_request_new_pad);
+  element_class->release_pad = GST_DEBUG_FUNCPTR (gst_neobatchconv_release_pad);
+  element_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_neobatchconv_change_state);
+
+  g_object_class_install_property (gobject_class,
+      PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of threads converting each batch, shared by all streams "
+          "(0 = number of processors)",
+          0, MAX_N_THREADS, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * GstNeobatchconv:stats:
+   *
+   * Statistics since the element was created, in an
+   * "application/x-neobatchconv-stats" structure: "frames" and "batches"
+   * (guint64) converted, and "avg-batch-size" (gdouble), the frames per
+   * batch. "pool-queue-depth", "pool-max-queue-depth" (guint) and
+   * "pool-utilization" (gdouble) describe the worker threads shared by
+   * the plugin, as in the stats of neovideoconv.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Frame and batch statistics",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gst_neobatchconv_init (GstNeobatchconv * neobatchconv)
+{
+  neobatchconv->kernels = neo_kernels_get_default ();
+  neo_luma_init (&neobatchconv->luma, NEO_LUMA_BT601);
+  neobatchconv->n_threads = DEFAULT_N_THREADS;
+  neobatchconv->pending = g_ptr_array_new ();
+  neobatchconv->batch = g_ptr_array_new ();
+  neobatchconv->tasks = g_array_new (FALSE, FALSE,
+      sizeof (GstNeobatchconvTask));
+  g_mutex_init (&neobatchconv->batch_lock);
+  g_cond_init (&neobatchconv->batch_cond);
+  g_mutex_init (&neobatchconv->worker_lock);
+  g_cond_init (&neobatchconv->worker_cond);
+  GST_INFO_OBJECT (neobatchconv, "using %s kernels",
+      neobatchconv->kernels->name);
+}
+
+void
+gst_neobatchconv_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstNeobatchconv *neobatchconv = GST_NEOBATCHCONV (object);
+
+  GST_DEBUG_OBJECT (neobatchconv, "set_property");
+
+  switch (property_id) {
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (neobatchconv);
+      neobatchconv->n_threads = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (neobatchconv);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_neobatchconv_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstNeobatchconv *neobatchconv = GST_NEOBATCHCONV (object);
+  guint64 frames, batches;
+  NeoTaskPoolCounters pool;
+
+  GST_DEBUG_OBJECT (neobatchconv, "get_property");
+
+  switch (property_id) {
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (neobatchconv);
+      g_value_set_uint (value, neobatchconv->n_threads);
+      GST_OBJECT_UNLOCK (neobatchconv);
+      break;
+    case PROP_STATS:
+      g_mutex_lock (&neobatchconv->batch_lock);
+      frames = neobatchconv->frames;
+      batches = neobatchconv->batches;
+      g_mutex_unlock (&neobatchconv->batch_lock);
+      neo_task_pool_get_counters (&pool);
+      g_value_take_boxed (value,
+          gst_structure_new ("application/x-neobatchconv-stats",
+              "frames", G_TYPE_UINT64, frames,
+              "batches", G_TYPE_UINT64, batches,
+              "avg-batch-size", G_TYPE_DOUBLE,
+              batches > 0 ? (gdouble) frames / batches : 0.0,
+              "pool-queue-depth", G_TYPE_UINT, pool.queue_depth,
+              "pool-max-queue-depth", G_TYPE_UINT, pool.max_queue_depth,
+              "pool-utilization", G_TYPE_DOUBLE, pool.utilization, NULL));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_neobatchconv_finalize (GObject * object)
+{
+  GstNeobatchconv *neobatchconv = GST_NEOBATCHCONV (object);
+
+  GST_DEBUG_OBJECT (neobatchconv, "finalize");
+
+  g_ptr_array_unref (neobatchconv->pending);
+  g_ptr_array_unref (neobatchconv->batch);
+  g_array_unref (neobatchconv->tasks);
+  g_mutex_clear (&neobatchconv->batch_lock);
+  g_cond_clear (&neobatchconv->batch_cond);
+  g_mutex_clear (&neobatchconv->worker_lock);
+  g_cond_clear (&neobatchconv->worker_cond);
+
+  G_OBJECT_CLASS (gst_neobatchconv_parent_class)->finalize (object);
+}
+
+/* pads */
+
+static GstPad *
+gst_neobatchconv_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps)
+{
+  GstNeobatchconv *neobatchconv = GST_NEOBATCHCONV (element);
+  GstNeobatchconvStream *stream;
+  gchar *pad_name;
+  guint index;
+
+  GST_OBJECT_LOCK (neobatchconv);
+  if (!name || sscanf (name, "sink_%u", &index) != 1)
+    index = neobatchconv->next_pad;
+  neobatchconv->next_pad = MAX (neobatchconv->next_pad, index + 1);
+  GST_OBJECT_UNLOCK (neobatchconv);
+
+  stream = g_new0 (GstNeobatchconvStream, 1);
+  stream->neobatchconv = neobatchconv;
+
+  pad_name = g_strdup_printf ("sink_%u", index);
+  stream->sinkpad = gst_pad_new_from_template (templ, pad_name);
+  g_free (pad_name);
+  gst_pad_set_element_private (stream->sinkpad, stream);
+  gst_pad_set_chain_function (stream->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_neobatchconv_sink_chain));
+  gst_pad_set_event_function (stream->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_neobatchconv_sink_event));
+  gst_pad_set_query_function (stream->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_neobatchconv_sink_query));
+  gst_pad_set_iterate_internal_links_function (stream->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_neobatchconv_iterate_internal_links));
+
+  pad_name = g_strdup_printf ("src_%u", index);
+  stream->srcpad =
+      gst_pad_new_from_static_template (&gst_neobatchconv_src_template,
+      pad_name);
+  g_free (pad_name);
+  gst_pad_set_element_private (stream->srcpad, stream);
+  gst_pad_set_iterate_internal_links_function (stream->srcpad,
+      GST_DEBUG_FUNCPTR (gst_neobatchconv_iterate_internal_links));
+  gst_pad_use_fixed_caps (stream->srcpad);
+
+  /* the src pad first, so that it is there once data can flow */
+  gst_pad_set_active (stream->srcpad, TRUE);
+  if (!gst_element_add_pad (element, stream->srcpad)) {
+    gst_object_unref (stream->sinkpad);
+    g_free (stream);
+    GST_WARNING_OBJECT (neobatchconv, "pad %u already exists", index);
+    return NULL;
+  }
+  gst_pad_set_active (stream->sinkpad, TRUE);
+  gst_element_add_pad (element, stream->sinkpad);
+
+  GST_DEBUG_OBJECT (neobatchconv, "added stream %u", index);
+
+  return stream->sinkpad;
+}
+
+static void
+gst_neobatchconv_free_stream (GstNeobatchconvStream * stream)
+{
+  if (stream->pool) {
+    gst_buffer_pool_set_active (stream->pool, FALSE);
+    gst_object_unref (stream->pool);
+  }
+  g_free (stream);
+}
+
+static void
+gst_neobatchconv_release_pad (GstElement * element, GstPad * pad)
+{
+  GstNeobatchconv *neobatchconv = GST_NEOBATCHCONV (element);
+  GstNeobatchconvStream *stream = gst_pad_get_element_private (pad);
+
+  GST_DEBUG_OBJECT (neobatchconv, "releasing %s:%s", GST_DEBUG_PAD_NAME (pad));
+
+  /* waits for the stream thread to leave the chain function, and with it
+   * any batch holding its frame */
+  gst_pad_set_active (stream->srcpad, FALSE);
+  gst_pad_set_active (stream->sinkpad, FALSE);
+  gst_element_remove_pad (element, stream->srcpad);
+  gst_element_remove_pad (element, stream->sinkpad);
+
+  gst_neobatchconv_free_stream (stream);
+}
+
+static GstIterator *
+gst_neobatchconv_iterate_internal_links (GstPad * pad, GstObject * parent)
+{
+  GstNeobatchconvStream *stream = gst_pad_get_element_private (pad);
+  GValue value = G_VALUE_INIT;
+  GstIterator *it;
+
+  g_value_init (&value, GST_TYPE_PAD);
+  g_value_set_object (&value,
+      pad == stream->sinkpad ? stream->srcpad : stream->sinkpad);
+  it = gst_iterator_new_single (GST_TYPE_PAD, &value);
+  g_value_unset (&value);
+
+  return it;
+}
+
+/* Sink caps for the GRAY8 caps of the src pad peer: any input format of
+ * the same size and rate */
+static GstCaps *
+gst_neobatchconv_sink_caps (GstNeobatchconvStream * stream, GstCaps * filter)
+{
+  GstCaps *templ = gst_pad_get_pad_template_caps (stream->sinkpad);
+  GstCaps *peer, *caps, *result;
+  guint i;
+
+  peer = gst_pad_peer_query_caps (stream->srcpad, NULL);
+  if (gst_caps_is_any (peer)) {
+    caps = gst_caps_ref (templ);
+  } else {
+    GstCaps *sized = gst_caps_new_empty ();
+
+    for (i = 0; i < gst_caps_get_size (peer); i++) {
+      GstStructure *s = gst_structure_copy (gst_caps_get_structure (peer, i));
+
+      gst_structure_remove_fields (s, "format", "colorimetry", "chroma-site",
+          NULL);
+      sized = gst_caps_merge_structure (sized, s);
+    }
+    caps = gst_caps_intersect (sized, templ);
+    gst_caps_unref (sized);
+  }
+  gst_caps_unref (peer);
+  gst_caps_unref (templ);
+
+  if (filter) {
+    result = gst_caps_intersect_full (filter, caps, GST_CAPS_INTERSECT_FIRST);
+    gst_caps_unref (caps);
+    caps = result;
+  }
+
+  return caps;
+}
+
+static gboolean
+gst_neobatchconv_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstNeobatchconvStream *stream = gst_pad_get_element_private (pad);
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CAPS:{
+      GstCaps *filter, *caps;
+
+      gst_query_parse_caps (query, &filter);
+      caps = gst_neobatchconv_sink_caps (stream, filter);
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      return TRUE;
+    }
+    case GST_QUERY_ALLOCATION:{
+      GstCaps *caps;
+      GstVideoInfo info;
+
+      /* downstream allocates GRAY8 frames, the input is answered here for
+       * its own format. Any layout maps, so no pool of ours is needed. */
+      gst_query_parse_allocation (query, &caps, NULL);
+      if (!caps || !gst_video_info_from_caps (&info, caps))
+        return FALSE;
+      gst_query_add_allocation_pool (query, NULL, info.size, 0, 0);
+      gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+      return TRUE;
+    }
+    default:
+      /* the rest doesn't depend on the format, the src pad can answer */
+      return gst_pad_query_default (pad, parent, query);
+  }
+}
+
+static gint
+gst_neobatchconv_layout_from_format (GstVideoFormat format)
+{
+  switch (format) {
+    case GST_VIDEO_FORMAT_RGB:
+      return NEO_LAYOUT_RGB;
+    case GST_VIDEO_FORMAT_BGR:
+      return NEO_LAYOUT_BGR;
+    case GST_VIDEO_FORMAT_RGBx:
+    case GST_VIDEO_FORMAT_RGBA:
+      return NEO_LAYOUT_RGBX;
+    case GST_VIDEO_FORMAT_BGRx:
+    case GST_VIDEO_FORMAT_BGRA:
+      return NEO_LAYOUT_BGRX;
+    case GST_VIDEO_FORMAT_xRGB:
+    case GST_VIDEO_FORMAT_ARGB:
+      return NEO_LAYOUT_XRGB;
+    case GST_VIDEO_FORMAT_xBGR:
+    case GST_VIDEO_FORMAT_ABGR:
+      return NEO_LAYOUT_XBGR;
+    default:
+      return -1;
+  }
+}
+
+static void
+gst_neobatchconv_copy_luma_row (guint8 * dest, const guint8 * src,
+    gint width, const NeoLuma * luma)
+{
+  memcpy (dest, src, width);
+}
+
+/* Negotiates the GRAY8 output of @stream for input @caps and sets up its
+ * output pool */
+static gboolean
+gst_neobatchconv_set_caps (GstNeobatchconvStream * stream, GstCaps * caps)
+{
+  GstNeobatchconv *neobatchconv = stream->neobatchconv;
+  GstVideoInfo in_info, out_info;
+  GstBufferPool *pool;
+  GstStructure *config;
+  GstCaps *outcaps;
+  gint layout;
+  gboolean ret;
+
+  if (!gst_video_info_from_caps (&in_info, caps))
+    return FALSE;
+
+  gst_video_info_set_interlaced_format (&out_info, GST_VIDEO_FORMAT_GRAY8,
+      GST_VIDEO_INFO_INTERLACE_MODE (&in_info),
+      GST_VIDEO_INFO_WIDTH (&in_info), GST_VIDEO_INFO_HEIGHT (&in_info));
+  GST_VIDEO_INFO_FPS_N (&out_info) = GST_VIDEO_INFO_FPS_N (&in_info);
+  GST_VIDEO_INFO_FPS_D (&out_info) = GST_VIDEO_INFO_FPS_D (&in_info);
+  GST_VIDEO_INFO_PAR_N (&out_info) = GST_VIDEO_INFO_PAR_N (&in_info);
+  GST_VIDEO_INFO_PAR_D (&out_info) = GST_VIDEO_INFO_PAR_D (&in_info);
+
+  outcaps = gst_video_info_to_caps (&out_info);
+  ret = gst_pad_set_caps (stream->srcpad, outcaps);
+  if (!ret) {
+    GST_WARNING_OBJECT (stream->srcpad, "downstream refused %" GST_PTR_FORMAT,
+        outcaps);
+    gst_caps_unref (outcaps);
+    return FALSE;
+  }
+
+  pool = gst_video_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, outcaps, out_info.size, 2, 0);
+  gst_buffer_pool_config_add_option (config,
+      GST_BUFFER_POOL_OPTION_VIDEO_META);
+  gst_caps_unref (outcaps);
+  if (!gst_buffer_pool_set_config (pool, config)
+      || !gst_buffer_pool_set_active (pool, TRUE)) {
+    GST_ERROR_OBJECT (stream->sinkpad, "could not set up the output pool");
+    gst_object_unref (pool);
+    return FALSE;
+  }
+
+  if (stream->pool) {
+    gst_buffer_pool_set_active (stream->pool, FALSE);
+    gst_object_unref (stream->pool);
+  }
+  stream->pool = pool;
+  stream->in_info = in_info;
+  stream->out_info = out_info;
+
+  layout = gst_neobatchconv_layout_from_format (GST_VIDEO_INFO_FORMAT
+      (&in_info));
+  stream->to_gray8 = layout < 0 ? gst_neobatchconv_copy_luma_row :
+      neobatchconv->kernels->to_gray8[layout];
+
+  GST_DEBUG_OBJECT (stream->sinkpad, "converting %s %dx%d",
+      GST_VIDEO_INFO_NAME (&in_info), GST_VIDEO_INFO_WIDTH (&in_info),
+      GST_VIDEO_INFO_HEIGHT (&in_info));
+
+  return TRUE;
+}
+
+static gboolean
+gst_neobatchconv_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstNeobatchconvStream *stream = gst_pad_get_element_private (pad);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_CAPS) {
+    GstCaps *caps;
+    gboolean ret;
+
+    gst_event_parse_caps (event, &caps);
+    ret = gst_neobatchconv_set_caps (stream, caps);
+    gst_event_unref (event);
+    return ret;
+  }
+
+  /* everything else goes to the src pad of the stream as is, after the
+   * frames before it since the chain function waits for them */
+  return gst_pad_event_default (pad, parent, event);
+}
+
+/* batches */
+
+/* Converts the tasks of the current batch until none is left */
+static void
+gst_neobatchconv_run_tasks (GstNeobatchconv * neobatchconv)
+{
+  GArray *tasks = neobatchconv->tasks;
+  gint i, row, width;
+
+  while ((i = g_atomic_int_add (&neobatchconv->next_task, 1)) <
+      (gint) tasks->len) {
+    GstNeobatchconvTask *task = &g_array_index (tasks, GstNeobatchconvTask, i);
+    GstNeobatchconvStream *stream = task->stream;
+    GstVideoFrame *inframe = &stream->inframe;
+    GstVideoFrame *outframe = &stream->outframe;
+    gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (inframe, 0);
+    gint d_stride = GST_VIDEO_FRAME_PLANE_STRIDE (outframe, 0);
+    const guint8 *src = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (inframe, 0) +
+        task->row_start * stride;
+    guint8 *dest = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (outframe, 0) +
+        task->row_start * d_stride;
+
+    width = GST_VIDEO_FRAME_WIDTH (inframe);
+    for (row = task->row_start; row < task->row_end; row++) {
+      stream->to_gray8 (dest, src, width, &neobatchconv->luma);
+      src += stride;
+      dest += d_stride;
+    }
+  }
+}
+
+static void
+gst_neobatchconv_worker_func (gpointer data, gpointer user_data)
+{
+  GstNeobatchconv *neobatchconv = user_data;
+
+  gst_neobatchconv_run_tasks (neobatchconv);
+
+  g_mutex_lock (&neobatchconv->worker_lock);
+  if (--neobatchconv->workers_pending == 0)
+    g_cond_signal (&neobatchconv->worker_cond);
+  g_mutex_unlock (&neobatchconv->worker_lock);
+}
+
+/* Converts the frames of neobatchconv->batch, split into tasks of up to
+ * TASK_ROWS rows that the calling thread and the workers take in turn */
+static void
+gst_neobatchconv_run_batch (GstNeobatchconv * neobatchconv)
+{
+  GArray *tasks = neobatchconv->tasks;
+  guint i, n_workers;
+  gint row, height;
+
+  g_array_set_size (tasks, 0);
+  for (i = 0; i < neobatchconv->batch->len; i++) {
+    GstNeobatchconvStream *stream = g_ptr_array_index (neobatchconv->batch, i);
+    GstNeobatchconvTask task;
+
+    height = GST_VIDEO_FRAME_HEIGHT (&stream->inframe);
+    task.stream = stream;
+    for (row = 0; row < height; row += TASK_ROWS) {
+      task.row_start = row;
+      task.row_end = MIN (row + TASK_ROWS, height);
+      g_array_append_val (tasks, task);
+    }
+  }
+  g_atomic_int_set (&neobatchconv->next_task, 0);
+
+  /* no more workers than tasks left once this thread took one */
+  n_workers = MIN (neobatchconv->n_workers, tasks->len - 1);
+  if (n_workers > 0) {
+    g_mutex_lock (&neobatchconv->worker_lock);
+    neobatchconv->workers_pending = n_workers;
+    g_mutex_unlock (&neobatchconv->worker_lock);
+    for (i = 0; i < n_workers; i++)
+      neo_task_queue_push (neobatchconv->workers, GUINT_TO_POINTER (i + 1));
+  }
+
+  gst_neobatchconv_run_tasks (neobatchconv);
+
+  if (n_workers > 0) {
+    g_mutex_lock (&neobatchconv->worker_lock);
+    while (neobatchconv->workers_pending > 0)
+      g_cond_wait (&neobatchconv->worker_cond, &neobatchconv->worker_lock);
+    g_mutex_unlock (&neobatchconv->worker_lock);
+  }
+
+  GST_LOG_OBJECT (neobatchconv, "converted %u frames in %u tasks",
+      neobatchconv->batch->len, tasks->len);
+}
+
+/* Converts the mapped frame of @stream with the next batch. The first
+ * stream thread to find no batch running runs one for every frame pending
+ * by then, its own included, and keeps running batches until its frame
+ * is done. */
+static void
+gst_neobatchconv_convert (GstNeobatchconv * neobatchconv,
+    GstNeobatchconvStream * stream)
+{
+  GPtrArray *batch;
+  guint i;
+
+  g_mutex_lock (&neobatchconv->batch_lock);
+  stream->done = FALSE;
+  g_ptr_array_add (neobatchconv->pending, stream);
+
+  while (!stream->done) {
+    if (neobatchconv->batch_running) {
+      g_cond_wait (&neobatchconv->batch_cond, &neobatchconv->batch_lock);
+      continue;
+    }
+
+    /* the pending frames become the batch, new ones pend meanwhile */
+    neobatchconv->batch_running = TRUE;
+    batch = neobatchconv->batch;
+    neobatchconv->batch = neobatchconv->pending;
+    neobatchconv->pending = batch;
+    g_mutex_unlock (&neobatchconv->batch_lock);
+
+    gst_neobatchconv_run_batch (neobatchconv);
+
+    g_mutex_lock (&neobatchconv->batch_lock);
+    batch = neobatchconv->batch;
+    for (i = 0; i < batch->len; i++)
+      ((GstNeobatchconvStream *) g_ptr_array_index (batch, i))->done = TRUE;
+    neobatchconv->frames += batch->len;
+    neobatchconv->batches++;
+    g_ptr_array_set_size (batch, 0);
+    neobatchconv->batch_running = FALSE;
+    g_cond_broadcast (&neobatchconv->batch_cond);
+  }
+
+  g_mutex_unlock (&neobatchconv->batch_lock);
+}
+
+static GstFlowReturn
+gst_neobatchconv_sink_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * inbuf)
+{
+  GstNeobatchconv *neobatchconv = GST_NEOBATCHCONV (parent);
+  GstNeobatchconvStream *stream = gst_pad_get_element_private (pad);
+  GstBuffer *outbuf = NULL;
+  GstFlowReturn ret;
+
+  if (!stream->to_gray8) {
+    GST_ELEMENT_ERROR (neobatchconv, CORE, NEGOTIATION, (NULL),
+        ("no caps on %s:%s before the first buffer",
+            GST_DEBUG_PAD_NAME (pad)));
+    gst_buffer_unref (inbuf);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+
+  ret = gst_buffer_pool_acquire_buffer (stream->pool, &outbuf, NULL);
+  if (ret != GST_FLOW_OK) {
+    gst_buffer_unref (inbuf);
+    return ret;
+  }
+  gst_buffer_copy_into (outbuf, inbuf, GST_BUFFER_COPY_FLAGS |
+      GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+
+  if (!gst_video_frame_map (&stream->inframe, &stream->in_info, inbuf,
+          GST_MAP_READ))
+    goto invalid_buffer;
+  if (!gst_video_frame_map (&stream->outframe, &stream->out_info, outbuf,
+          GST_MAP_WRITE)) {
+    gst_video_frame_unmap (&stream->inframe);
+    goto invalid_buffer;
+  }
+
+  gst_neobatchconv_convert (neobatchconv, stream);
+
+  gst_video_frame_unmap (&stream->outframe);
+  gst_video_frame_unmap (&stream->inframe);
+  gst_buffer_unref (inbuf);
+
+  return gst_pad_push (stream->srcpad, outbuf);
+
+invalid_buffer:
+  GST_ELEMENT_WARNING (neobatchconv, CORE, NOT_IMPLEMENTED, (NULL),
+      ("invalid video buffer received"));
+  gst_buffer_unref (outbuf);
+  gst_buffer_unref (inbuf);
+  return GST_FLOW_OK;
+}
+
+/* states */
+
+static gboolean
+gst_neobatchconv_start (GstNeobatchconv * neobatchconv)
+{
+  guint n_threads;
+  GError *err = NULL;
+
+  GST_OBJECT_LOCK (neobatchconv);
+  n_threads = neobatchconv->n_threads;
+  GST_OBJECT_UNLOCK (neobatchconv);
+
+  if (n_threads == 0)
+    n_threads = g_get_num_processors ();
+
+  /* the stream thread running a batch converts too */
+  neobatchconv->n_workers = n_threads - 1;
+  if (neobatchconv->n_workers > 0) {
+    neobatchconv->workers = neo_task_queue_new (gst_neobatchconv_worker_func,
+        neobatchconv, neobatchconv->n_workers, &err);
+    if (!neobatchconv->workers) {
+      GST_ELEMENT_ERROR (neobatchconv, RESOURCE, FAILED,
+          ("Could not create batch worker threads"), ("%s", err->message));
+      g_clear_error (&err);
+      neobatchconv->n_workers = 0;
+      return FALSE;
+    }
+  }
+  GST_INFO_OBJECT (neobatchconv, "converting batches with %u threads",
+      n_threads);
+
+  return TRUE;
+}
+
+static void
+gst_neobatchconv_stop (GstNeobatchconv * neobatchconv)
+{
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+
+  if (neobatchconv->workers) {
+    neo_task_queue_free (neobatchconv->workers);
+    neobatchconv->workers = NULL;
+  }
+  neobatchconv->n_workers = 0;
+
+  /* the pads were deactivated, their caps come again on restart */
+  it = gst_element_iterate_sink_pads (GST_ELEMENT (neobatchconv));
+  while (gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+    GstNeobatchconvStream *stream =
+        gst_pad_get_element_private (g_value_get_object (&item));
+
+    stream->to_gray8 = NULL;
+    if (stream->pool) {
+      gst_buffer_pool_set_active (stream->pool, FALSE);
+      gst_clear_object (&stream->pool);
+    }
+    g_value_reset (&item);
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+}
+
+static GstStateChangeReturn
+gst_neobatchconv_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstNeobatchconv *neobatchconv = GST_NEOBATCHCONV (element);
+  GstStateChangeReturn ret;
+
+  if (transition == GST_STATE_CHANGE_READY_TO_PAUSED
+      && !gst_neobatchconv_start (neobatchconv))
+    return GST_STATE_CHANGE_FAILURE;
+
+  ret = GST_ELEMENT_CLASS (gst_neobatchconv_parent_class)->change_state
+      (element, transition);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY)
+    gst_neobatchconv_stop (neobatchconv);
+
+  return ret;
+}
@@ -0,0 +1,118 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_NEOBATCHCONV_H_
+#define _GST_NEOBATCHCONV_H_
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include "neovideoconv-kernels.h"
+#include "neotaskpool.h"
+
+G_BEGIN_DECLS
+#define GST_TYPE_NEOBATCHCONV   (gst_neobatchconv_get_type())
+#define GST_NEOBATCHCONV(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_NEOBATCHCONV,GstNeobatchconv))
+#define GST_NEOBATCHCONV_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_NEOBATCHCONV,GstNeobatchconvClass))
+#define GST_IS_NEOBATCHCONV(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_NEOBATCHCONV))
+#define GST_IS_NEOBATCHCONV_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_NEOBATCHCONV))
+typedef struct _GstNeobatchconv GstNeobatchconv;
+typedef struct _GstNeobatchconvClass GstNeobatchconvClass;
+typedef struct _GstNeobatchconvStream GstNeobatchconvStream;
+typedef struct _GstNeobatchconvTask GstNeobatchconvTask;
+
+/* a sink_%u pad and the src_%u pad its frames leave by as GRAY8, the
+ * element private data of both */
+struct _GstNeobatchconvStream
+{
+  GstNeobatchconv *neobatchconv;
+  GstPad *sinkpad;
+  GstPad *srcpad;
+
+  /* negotiated on the sink pad, streaming thread of the stream only.
+   * to_gray8 is NULL until then. */
+  GstVideoInfo in_info;
+  GstVideoInfo out_info;
+  NeoToGray8Func to_gray8;
+  GstBufferPool *pool;
+
+  /* the frame waiting for or in a batch, mapped by the stream thread */
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  /* the batch holding the frame is over, protected by batch_lock */
+  gboolean done;
+};
+
+/* rows of the frame of one stream, converted by one thread of a batch */
+struct _GstNeobatchconvTask
+{
+  GstNeobatchconvStream *stream;
+  gint row_start;
+  gint row_end;
+};
+
+struct _GstNeobatchconv
+{
+  GstElement base_neobatchconv;
+
+  const NeoKernels *kernels;
+  NeoLuma luma;
+
+  /* properties, protected by the object lock */
+  guint n_threads;
+
+  /* request pad numbering, protected by the object lock */
+  guint next_pad;
+
+  /* frames of any stream waiting for the next batch, and whether a stream
+   * thread is converting one. protected by batch_lock */
+  GMutex batch_lock;
+  GCond batch_cond;
+  GPtrArray *pending;
+  gboolean batch_running;
+
+  /* the batch being converted, owned by the stream thread running it: its
+   * frames split into tasks, taken in turn by that thread and the workers
+   * through next_task */
+  GPtrArray *batch;
+  GArray *tasks;
+  gint next_task;
+
+  /* queue of the batch tasks on the shared workers, between READY and
+   * PAUSED */
+  NeoTaskQueue *workers;
+  guint n_workers;
+  GMutex worker_lock;
+  GCond worker_cond;
+  guint workers_pending;
+
+  /* frames converted and batches run, for the stats */
+  guint64 frames;
+  guint64 batches;
+};
+
+struct _GstNeobatchconvClass
+{
+  GstElementClass base_neobatchconv_class;
+};
+
+GType gst_neobatchconv_get_type (void);
+
+G_END_DECLS
+#endif
@@ -0,0 +1,452 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+/**
+ * SECTION:element-gstneocolormatrix
+ *
+ * The neocolormatrix element maps the R, G and B of every pixel through a
+ * 3x4 colour matrix, in place. Presets cover sepia, inversion, swapping
+ * red and blue and a tint, and any other matrix can be given with the
+ * matrix property. The matrix is applied in fixed point by the same
+ * SIMD kernels whatever it is, and a new one applies from the next frame
+ * on without renegotiation. With the identity preset buffers pass through
+ * untouched.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 -v videotestsrc ! video/x-raw,format=BGRx ! neocolormatrix preset=sepia ! autovideosink
+ * ]|
+ * Gives the video a sepia tone.
+ * |[
+ * gst-launch-1.0 -v videotestsrc ! video/x-raw,format=RGBA ! neocolormatrix preset=custom matrix="<0.5, 0.5, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 16.0>" ! autovideosink
+ * ]|
+ * Applies a user matrix: rows for the output R, G and B, each with the
+ * weights of the input R, G and B and an offset in 0..255 units.
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+#include "gstneocolormatrix.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_neocolormatrix_debug_category);
+#define GST_CAT_DEFAULT gst_neocolormatrix_debug_category
+
+/* prototypes */
+
+static void gst_neocolormatrix_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_neocolormatrix_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+
+static gboolean gst_neocolormatrix_set_info (GstVideoFilter * filter,
+    GstCaps * incaps, GstVideoInfo * in_info, GstCaps * outcaps,
+    GstVideoInfo * out_info);
+static GstFlowReturn gst_neocolormatrix_transform_frame_ip (GstVideoFilter *
+    filter, GstVideoFrame * frame);
+
+enum
+{
+  PROP_0,
+  PROP_PRESET,
+  PROP_MATRIX,
+  PROP_TINT_COLOR
+};
+
+#define DEFAULT_PRESET GST_NEOCOLORMATRIX_PRESET_IDENTITY
+#define DEFAULT_TINT_COLOR 0x80c0ff
+
+/* limits of the fixed point matrix, in 0..255 units for the offsets */
+#define MAX_COEFF 8.0
+#define MAX_OFFSET 255.0
+
+/* pad templates */
+
+#define VIDEO_CAPS \
+    GST_VIDEO_CAPS_MAKE("{ RGB, BGR, RGBx, BGRx, xRGB, xBGR, RGBA, BGRA, " \
+        "ARGB, ABGR }")
+
+/* rows R, G, B of the output, columns R, G, B and offset of the input */
+static const gdouble preset_matrices[][3][4] = {
+  [GST_NEOCOLORMATRIX_PRESET_IDENTITY] = {
+        {1.0, 0.0, 0.0, 0.0},
+        {0.0, 1.0, 0.0, 0.0},
+        {0.0, 0.0, 1.0, 0.0},
+      },
+  [GST_NEOCOLORMATRIX_PRESET_SEPIA] = {
+        {0.393, 0.769, 0.189, 0.0},
+        {0.349, 0.686, 0.168, 0.0},
+        {0.272, 0.534, 0.131, 0.0},
+      },
+  [GST_NEOCOLORMATRIX_PRESET_INVERT] = {
+        {-1.0, 0.0, 0.0, 255.0},
+        {0.0, -1.0, 0.0, 255.0},
+        {0.0, 0.0, -1.0, 255.0},
+      },
+  [GST_NEOCOLORMATRIX_PRESET_SWAP_RB] = {
+        {0.0, 0.0, 1.0, 0.0},
+        {0.0, 1.0, 0.0, 0.0},
+        {1.0, 0.0, 0.0, 0.0},
+      },
+};
+
+/* the tint scales the BT.601 luma by the tint colour */
+static const gdouble tint_luma[3] = { 0.299, 0.587, 0.114 };
+
+#define GST_TYPE_NEOCOLORMATRIX_PRESET (gst_neocolormatrix_preset_get_type ())
+static GType
+gst_neocolormatrix_preset_get_type (void)
+{
+  static gsize preset_type = 0;
+  static const GEnumValue presets[] = {
+    {GST_NEOCOLORMATRIX_PRESET_IDENTITY, "Leave the colours as they are",
+        "identity"},
+    {GST_NEOCOLORMATRIX_PRESET_SEPIA, "Sepia tone", "sepia"},
+    {GST_NEOCOLORMATRIX_PRESET_INVERT, "Negative", "invert"},
+    {GST_NEOCOLORMATRIX_PRESET_SWAP_RB, "Swap red and blue", "swap-rb"},
+    {GST_NEOCOLORMATRIX_PRESET_TINT, "Luma in shades of tint-color", "tint"},
+    {GST_NEOCOLORMATRIX_PRESET_CUSTOM, "The matrix property", "custom"},
+    {0, NULL, NULL},
+  };
+
+  if (g_once_init_enter (&preset_type)) {
+    GType type = g_enum_register_static ("GstNeocolormatrixPreset", presets);
+
+    g_once_init_leave (&preset_type, type);
+  }
+  return preset_type;
+}
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstNeocolormatrix, gst_neocolormatrix,
+    GST_TYPE_VIDEO_FILTER,
+    GST_DEBUG_CATEGORY_INIT (gst_neocolormatrix_debug_category,
+        "neocolormatrix", 0, "debug category for neocolormatrix element"));
+
+static void
+gst_neocolormatrix_class_init (GstNeocolormatrixClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBaseTransformClass *base_transform_class =
+      GST_BASE_TRANSFORM_CLASS (klass);
+  GstVideoFilterClass *video_filter_class = GST_VIDEO_FILTER_CLASS (klass);
+
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
+      gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+          gst_caps_from_string (VIDEO_CAPS)));
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
+      gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+          gst_caps_from_string (VIDEO_CAPS)));
+
+  gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
+      "Colour matrix effects", "Filter/Effect/Video",
+      "Applies a 3x4 colour matrix to RGB video: sepia, invert, channel "
+      "swap, tint or a user matrix", "taruntejk@live.com");
+
+  gobject_class->set_property = gst_neocolormatrix_set_property;
+  gobject_class->get_property = gst_neocolormatrix_get_property;
+  /* the identity preset passes buffers through without touching them */
+  base_transform_class->transform_ip_on_passthrough = FALSE;
+  video_filter_class->set_info = GST_DEBUG_FUNCPTR (gst_neocolormatrix_set_info);
+  video_filter_class->transform_frame_ip =
+      GST_DEBUG_FUNCPTR (gst_neocolormatrix_transform_frame_ip);
+
+  g_object_class_install_property (gobject_class,
+      PROP_PRESET,
+      g_param_spec_enum ("preset", "Preset",
+          "The colour matrix to apply, custom for the matrix property",
+          GST_TYPE_NEOCOLORMATRIX_PRESET, DEFAULT_PRESET,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_CONTROLLABLE | GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class,
+      PROP_MATRIX,
+      gst_param_spec_array ("matrix", "Matrix",
+          "12 values, one row per output R, G and B, each with the weights "
+          "of the input R, G and B and an offset in 0..255 units. Weights "
+          "are clamped to -8..8",
+          g_param_spec_double ("value", "Value",
+              "A weight or an offset", -MAX_OFFSET, MAX_OFFSET, 0.0,
+              G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS),
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class,
+      PROP_TINT_COLOR,
+      g_param_spec_uint ("tint-color", "Tint colour",
+          "Colour of the tint preset as 0xRRGGBB, white is plain grey",
+          0, 0xffffff, DEFAULT_TINT_COLOR,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_CONTROLLABLE | GST_PARAM_MUTABLE_PLAYING));
+}
+
+static void
+gst_neocolormatrix_init (GstNeocolormatrix * neocolormatrix)
+{
+  neocolormatrix->kernels = neo_kernels_get_default ();
+  neocolormatrix->preset = DEFAULT_PRESET;
+  neocolormatrix->tint_color = DEFAULT_TINT_COLOR;
+  memcpy (neocolormatrix->matrix,
+      preset_matrices[GST_NEOCOLORMATRIX_PRESET_IDENTITY],
+      sizeof (neocolormatrix->matrix));
+  neocolormatrix->changed = TRUE;
+
+  gst_base_transform_set_in_place (GST_BASE_TRANSFORM (neocolormatrix), TRUE);
+  gst_base_transform_set_passthrough (GST_BASE_TRANSFORM (neocolormatrix),
+      TRUE);
+  GST_DEBUG_OBJECT (neocolormatrix, "using %s kernels",
+      neocolormatrix->kernels->name);
+}
+
+/* The 3x4 matrix of the current properties, object lock held */
+static void
+gst_neocolormatrix_get_matrix (GstNeocolormatrix * neocolormatrix,
+    gdouble matrix[3][4])
+{
+  guint tint = neocolormatrix->tint_color;
+  gint c, j;
+
+  switch (neocolormatrix->preset) {
+    case GST_NEOCOLORMATRIX_PRESET_TINT:
+      for (c = 0; c < 3; c++) {
+        gdouble scale = ((tint >> (16 - 8 * c)) & 0xff) / 255.0;
+
+        for (j = 0; j < 3; j++)
+          matrix[c][j] = tint_luma[j] * scale;
+        matrix[c][3] = 0.0;
+      }
+      break;
+    case GST_NEOCOLORMATRIX_PRESET_CUSTOM:
+      memcpy (matrix, neocolormatrix->matrix, sizeof (neocolormatrix->matrix));
+      break;
+    default:
+      memcpy (matrix, preset_matrices[neocolormatrix->preset],
+          sizeof (preset_matrices[0]));
+      break;
+  }
+}
+
+/* @value in 1/256 units, rounded half away from zero */
+static gint
+gst_neocolormatrix_to_fixed (gdouble value, gdouble limit)
+{
+  value = CLAMP (value, -limit, limit) * (1 << NEO_MATRIX_SHIFT);
+
+  return (gint) (value < 0 ? value - 0.5 : value + 0.5);
+}
+
+/* Lays @matrix out over the bytes of the negotiated pixels in fixed point.
+ * The byte that is neither R, G nor B keeps its value. */
+static void
+gst_neocolormatrix_build_pixel_matrix (GstNeocolormatrix * neocolormatrix,
+    const gdouble matrix[3][4], NeoColorMatrix * pixel_matrix)
+{
+  const gint *offset = neocolormatrix->comp_offset;
+  gint c, j, k;
+
+  memset (pixel_matrix, 0, sizeof (NeoColorMatrix));
+  for (k = 0; k < 4; k++) {
+    pixel_matrix->coeffs[k][k] = 1 << NEO_MATRIX_SHIFT;
+    pixel_matrix->offsets[k] = 1 << (NEO_MATRIX_SHIFT - 1);
+  }
+
+  for (c = 0; c < 3; c++) {
+    gint16 *coeffs = pixel_matrix->coeffs[offset[c]];
+
+    coeffs[offset[c]] = 0;
+    for (j = 0; j < 3; j++)
+      coeffs[offset[j]] = CLAMP (gst_neocolormatrix_to_fixed (matrix[c][j],
+              MAX_COEFF), NEO_MATRIX_COEFF_MIN, NEO_MATRIX_COEFF_MAX);
+    pixel_matrix->offsets[offset[c]] =
+        gst_neocolormatrix_to_fixed (matrix[c][3], MAX_OFFSET) +
+        (1 << (NEO_MATRIX_SHIFT - 1));
+  }
+}
+
+/* Passes buffers through while the matrix is the identity. Called without
+ * the object lock, which the base class takes. */
+static void
+gst_neocolormatrix_update_passthrough (GstNeocolormatrix * neocolormatrix)
+{
+  gdouble matrix[3][4];
+  gboolean identity;
+
+  GST_OBJECT_LOCK (neocolormatrix);
+  gst_neocolormatrix_get_matrix (neocolormatrix, matrix);
+  neocolormatrix->changed = TRUE;
+  GST_OBJECT_UNLOCK (neocolormatrix);
+
+  identity = memcmp (matrix,
+      preset_matrices[GST_NEOCOLORMATRIX_PRESET_IDENTITY],
+      sizeof (matrix)) == 0;
+  gst_base_transform_set_passthrough (GST_BASE_TRANSFORM (neocolormatrix),
+      identity);
+}
+
+void
+gst_neocolormatrix_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstNeocolormatrix *neocolormatrix = GST_NEOCOLORMATRIX (object);
+
+  GST_DEBUG_OBJECT (neocolormatrix, "set_property");
+
+  switch (property_id) {
+    case PROP_PRESET:
+      GST_OBJECT_LOCK (neocolormatrix);
+      neocolormatrix->preset = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (neocolormatrix);
+      break;
+    case PROP_MATRIX:{
+      guint i;
+
+      if (gst_value_array_get_size (value) != 12) {
+        GST_WARNING_OBJECT (neocolormatrix, "matrix needs 12 values, not %u",
+            gst_value_array_get_size (value));
+        return;
+      }
+      GST_OBJECT_LOCK (neocolormatrix);
+      for (i = 0; i < 12; i++)
+        neocolormatrix->matrix[i / 4][i % 4] =
+            g_value_get_double (gst_value_array_get_value (value, i));
+      GST_OBJECT_UNLOCK (neocolormatrix);
+      break;
+    }
+    case PROP_TINT_COLOR:
+      GST_OBJECT_LOCK (neocolormatrix);
+      neocolormatrix->tint_color = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (neocolormatrix);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      return;
+  }
+
+  gst_neocolormatrix_update_passthrough (neocolormatrix);
+}
+
+void
+gst_neocolormatrix_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstNeocolormatrix *neocolormatrix = GST_NEOCOLORMATRIX (object);
+
+  GST_DEBUG_OBJECT (neocolormatrix, "get_property");
+
+  switch (property_id) {
+    case PROP_PRESET:
+      GST_OBJECT_LOCK (neocolormatrix);
+      g_value_set_enum (value, neocolormatrix->preset);
+      GST_OBJECT_UNLOCK (neocolormatrix);
+      break;
+    case PROP_MATRIX:{
+      GValue item = G_VALUE_INIT;
+      guint i;
+
+      g_value_init (&item, G_TYPE_DOUBLE);
+      GST_OBJECT_LOCK (neocolormatrix);
+      for (i = 0; i < 12; i++) {
+        g_value_set_double (&item, neocolormatrix->matrix[i / 4][i % 4]);
+        gst_value_array_append_value (value, &item);
+      }
+      GST_OBJECT_UNLOCK (neocolormatrix);
+      g_value_unset (&item);
+      break;
+    }
+    case PROP_TINT_COLOR:
+      GST_OBJECT_LOCK (neocolormatrix);
+      g_value_set_uint (value, neocolormatrix->tint_color);
+      GST_OBJECT_UNLOCK (neocolormatrix);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static gboolean
+gst_neocolormatrix_set_info (GstVideoFilter * filter, GstCaps * incaps,
+    GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
+{
+  GstNeocolormatrix *neocolormatrix = GST_NEOCOLORMATRIX (filter);
+  gint pstride = GST_VIDEO_INFO_COMP_PSTRIDE (in_info, 0);
+  gint c;
+
+  if (!GST_VIDEO_INFO_IS_RGB (in_info) || (pstride != 3 && pstride != 4)) {
+    GST_ERROR_OBJECT (neocolormatrix, "unsupported format %s",
+        GST_VIDEO_INFO_NAME (in_info));
+    return FALSE;
+  }
+
+  GST_OBJECT_LOCK (neocolormatrix);
+  neocolormatrix->pstride = pstride;
+  for (c = 0; c < 3; c++)
+    neocolormatrix->comp_offset[c] = GST_VIDEO_INFO_COMP_POFFSET (in_info, c);
+  neocolormatrix->apply = pstride == 4 ?
+      neocolormatrix->kernels->color_matrix32 :
+      neocolormatrix->kernels->color_matrix24;
+  neocolormatrix->changed = TRUE;
+  GST_OBJECT_UNLOCK (neocolormatrix);
+
+  GST_DEBUG_OBJECT (neocolormatrix, "%s with %s kernels",
+      GST_VIDEO_INFO_NAME (in_info), neocolormatrix->kernels->name);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_neocolormatrix_transform_frame_ip (GstVideoFilter * filter,
+    GstVideoFrame * frame)
+{
+  GstNeocolormatrix *neocolormatrix = GST_NEOCOLORMATRIX (filter);
+  gint width = GST_VIDEO_FRAME_WIDTH (frame);
+  gint height = GST_VIDEO_FRAME_HEIGHT (frame);
+  gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
+  guint8 *data = GST_VIDEO_FRAME_PLANE_DATA (frame, 0);
+  NeoColorMatrix pixel_matrix;
+  gint row;
+
+  /* property changes land here, between two frames */
+  GST_OBJECT_LOCK (neocolormatrix);
+  if (neocolormatrix->changed) {
+    gdouble matrix[3][4];
+
+    gst_neocolormatrix_get_matrix (neocolormatrix, matrix);
+    gst_neocolormatrix_build_pixel_matrix (neocolormatrix, matrix,
+        &neocolormatrix->pixel_matrix);
+    neocolormatrix->changed = FALSE;
+  }
+  pixel_matrix = neocolormatrix->pixel_matrix;
+  GST_OBJECT_UNLOCK (neocolormatrix);
+
+  GST_LOG_OBJECT (neocolormatrix, "transform_frame_ip %p", frame);
+
+  for (row = 0; row < height; row++)
+    neocolormatrix->apply (data + row * stride, width, &pixel_matrix);
+
+  return GST_FLOW_OK;
+}
@@ -0,0 +1,78 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_NEOCOLORMATRIX_H_
+#define _GST_NEOCOLORMATRIX_H_
+
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+
+#include "neovideoconv-kernels.h"
+
+G_BEGIN_DECLS
+#define GST_TYPE_NEOCOLORMATRIX   (gst_neocolormatrix_get_type())
+#define GST_NEOCOLORMATRIX(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_NEOCOLORMATRIX,GstNeocolormatrix))
+#define GST_NEOCOLORMATRIX_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_NEOCOLORMATRIX,GstNeocolormatrixClass))
+#define GST_IS_NEOCOLORMATRIX(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_NEOCOLORMATRIX))
+#define GST_IS_NEOCOLORMATRIX_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_NEOCOLORMATRIX))
+typedef struct _GstNeocolormatrix GstNeocolormatrix;
+typedef struct _GstNeocolormatrixClass GstNeocolormatrixClass;
+
+typedef enum
+{
+  GST_NEOCOLORMATRIX_PRESET_IDENTITY,
+  GST_NEOCOLORMATRIX_PRESET_SEPIA,
+  GST_NEOCOLORMATRIX_PRESET_INVERT,
+  GST_NEOCOLORMATRIX_PRESET_SWAP_RB,
+  GST_NEOCOLORMATRIX_PRESET_TINT,
+  GST_NEOCOLORMATRIX_PRESET_CUSTOM,
+} GstNeocolormatrixPreset;
+
+struct _GstNeocolormatrix
+{
+  GstVideoFilter base_neocolormatrix;
+
+  const NeoKernels *kernels;
+  /* kernel for the pixel size of the caps */
+  NeoColorMatrixFunc apply;
+  /* byte offsets of R, G and B within a pixel */
+  gint comp_offset[3];
+  gint pstride;
+
+  /* properties, protected by the object lock. matrix is the user matrix,
+   * rows R, G and B of the output, columns R, G, B and offset. */
+  GstNeocolormatrixPreset preset;
+  gdouble matrix[3][4];
+  guint tint_color;
+
+  /* the matrix of the current properties laid out for the pixels of the
+   * caps, rebuilt on the next frame when changed is set. Object lock. */
+  gboolean changed;
+  NeoColorMatrix pixel_matrix;
+};
+
+struct _GstNeocolormatrixClass
+{
+  GstVideoFilterClass base_neocolormatrix_class;
+};
+
+GType gst_neocolormatrix_get_type (void);
+
+G_END_DECLS
+#endif
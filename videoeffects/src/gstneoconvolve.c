@@ -0,0 +1,631 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+/**
+ * SECTION:element-gstneoconvolve
+ *
+ * The neoconvolve element runs a spatial filter over GRAY8 or packed RGB
+ * video: a Gaussian blur, an unsharp mask sharpening or Sobel edge
+ * detection. Every component is filtered on its own.
+ *
+ * Blur and sharpen are separable, a horizontal pass over each source row
+ * followed by a vertical pass over the 2 * radius + 1 rows around each
+ * output row. The horizontal results are kept in a rolling buffer of just
+ * that many rows, so each source row goes through the horizontal pass
+ * once per slice and no frame sized temporary is needed. Sobel reads the
+ * three rows around each output row straight from the input; on GRAY8, as
+ * output by neovideoconv, that is a single pass over one byte per pixel.
+ * Both run on SIMD kernels and the rows of a frame can be split over
+ * several threads.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 -v videotestsrc ! neovideoconv ! video/x-raw,format=GRAY8 ! neoconvolve filter=sobel ! videoconvert ! autovideosink
+ * ]|
+ * Shows the edges of the luma.
+ * |[
+ * gst-launch-1.0 -v videotestsrc ! video/x-raw,format=BGRx ! neoconvolve filter=blur radius=6 n-threads=0 ! videoconvert ! autovideosink
+ * ]|
+ * Blurs colour video using all processors.
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+#include "gstneoconvolve.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_neoconvolve_debug_category);
+#define GST_CAT_DEFAULT gst_neoconvolve_debug_category
+
+/* prototypes */
+
+static void gst_neoconvolve_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_neoconvolve_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_neoconvolve_finalize (GObject * object);
+
+static gboolean gst_neoconvolve_start (GstBaseTransform * trans);
+static gboolean gst_neoconvolve_stop (GstBaseTransform * trans);
+static gboolean gst_neoconvolve_set_info (GstVideoFilter * filter,
+    GstCaps * incaps, GstVideoInfo * in_info, GstCaps * outcaps,
+    GstVideoInfo * out_info);
+static GstFlowReturn gst_neoconvolve_transform_frame (GstVideoFilter * filter,
+    GstVideoFrame * inframe, GstVideoFrame * outframe);
+static void gst_neoconvolve_slice_func (gpointer data, gpointer user_data);
+
+enum
+{
+  PROP_0,
+  PROP_N_THREADS,
+  PROP_FILTER,
+  PROP_RADIUS,
+  PROP_AMOUNT
+};
+
+#define DEFAULT_N_THREADS 1
+/* one slice each, allocated in start */
+#define MAX_N_THREADS 1024
+#define DEFAULT_FILTER GST_NEOCONVOLVE_FILTER_BLUR
+#define DEFAULT_RADIUS 2
+#define DEFAULT_AMOUNT 1.0
+#define MAX_AMOUNT 8.0
+
+/* fewer rows than this per thread are not worth the handoff */
+#define MIN_SLICE_ROWS 32
+
+/* pad templates */
+
+#define VIDEO_CAPS \
+    GST_VIDEO_CAPS_MAKE("{ GRAY8, RGB, BGR, RGBx, BGRx, xRGB, xBGR }")
+
+#define GST_TYPE_NEOCONVOLVE_FILTER (gst_neoconvolve_filter_get_type ())
+static GType
+gst_neoconvolve_filter_get_type (void)
+{
+  static gsize filter_type = 0;
+  static const GEnumValue filters[] = {
+    {GST_NEOCONVOLVE_FILTER_BLUR, "Gaussian blur", "blur"},
+    {GST_NEOCONVOLVE_FILTER_SHARPEN, "Unsharp mask", "sharpen"},
+    {GST_NEOCONVOLVE_FILTER_SOBEL, "Sobel edge magnitude", "sobel"},
+    {0, NULL, NULL},
+  };
+
+  if (g_once_init_enter (&filter_type)) {
+    GType type = g_enum_register_static ("GstNeoconvolveFilter", filters);
+
+    g_once_init_leave (&filter_type, type);
+  }
+  return filter_type;
+}
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstNeoconvolve, gst_neoconvolve,
+    GST_TYPE_VIDEO_FILTER,
+    GST_DEBUG_CATEGORY_INIT (gst_neoconvolve_debug_category, "neoconvolve", 0,
+        "debug category for neoconvolve element"));
+
+static void
+gst_neoconvolve_class_init (GstNeoconvolveClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBaseTransformClass *base_transform_class =
+      GST_BASE_TRANSFORM_CLASS (klass);
+  GstVideoFilterClass *video_filter_class = GST_VIDEO_FILTER_CLASS (klass);
+
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
+      gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+          gst_caps_from_string (VIDEO_CAPS)));
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
+      gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+          gst_caps_from_string (VIDEO_CAPS)));
+
+  gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
+      "Convolution filters", "Filter/Effect/Video",
+      "Blurs, sharpens or finds the edges of GRAY8 and RGB video with "
+      "separable SIMD filters", "taruntejk@live.com");
+
+  gobject_class->set_property = gst_neoconvolve_set_property;
+  gobject_class->get_property = gst_neoconvolve_get_property;
+  gobject_class->finalize = gst_neoconvolve_finalize;
+  base_transform_class->start = GST_DEBUG_FUNCPTR (gst_neoconvolve_start);
+  base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_neoconvolve_stop);
+  /* sharpening by nothing passes buffers through */
+  base_transform_class->transform_ip_on_passthrough = FALSE;
+  video_filter_class->set_info = GST_DEBUG_FUNCPTR (gst_neoconvolve_set_info);
+  video_filter_class->transform_frame =
+      GST_DEBUG_FUNCPTR (gst_neoconvolve_transform_frame);
+
+  g_object_class_install_property (gobject_class,
+      PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of threads filtering horizontal slices of each frame "
+          "(0 = number of processors)",
+          0, MAX_N_THREADS, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class,
+      PROP_FILTER,
+      g_param_spec_enum ("filter", "Filter", "The filter to apply",
+          GST_TYPE_NEOCONVOLVE_FILTER, DEFAULT_FILTER,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class,
+      PROP_RADIUS,
+      g_param_spec_uint ("radius", "Radius",
+          "Radius in pixels of the blur, and of the blur the sharpening "
+          "subtracts. The Gaussian has a standard deviation of half of it",
+          1, NEO_CONV_MAX_RADIUS, DEFAULT_RADIUS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_CONTROLLABLE | GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class,
+      PROP_AMOUNT,
+      g_param_spec_double ("amount", "Amount",
+          "How much of the detail lost to the blur sharpening adds back",
+          0.0, MAX_AMOUNT, DEFAULT_AMOUNT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_CONTROLLABLE | GST_PARAM_MUTABLE_PLAYING));
+}
+
+static void
+gst_neoconvolve_init (GstNeoconvolve * neoconvolve)
+{
+  neoconvolve->kernels = neo_kernels_get_default ();
+  neoconvolve->n_threads = DEFAULT_N_THREADS;
+  neoconvolve->filter = DEFAULT_FILTER;
+  neoconvolve->radius = DEFAULT_RADIUS;
+  neoconvolve->amount = DEFAULT_AMOUNT;
+  g_mutex_init (&neoconvolve->slice_lock);
+  g_cond_init (&neoconvolve->slice_cond);
+  GST_INFO_OBJECT (neoconvolve, "using %s kernels",
+      neoconvolve->kernels->name);
+}
+
+/* Sharpening by an amount of 0 leaves every pixel as it is. Called
+ * without the object lock, which the base class takes. */
+static void
+gst_neoconvolve_update_passthrough (GstNeoconvolve * neoconvolve)
+{
+  gboolean passthrough;
+
+  GST_OBJECT_LOCK (neoconvolve);
+  passthrough = neoconvolve->filter == GST_NEOCONVOLVE_FILTER_SHARPEN &&
+      neoconvolve->amount * 256 < 0.5;
+  GST_OBJECT_UNLOCK (neoconvolve);
+
+  gst_base_transform_set_passthrough (GST_BASE_TRANSFORM (neoconvolve),
+      passthrough);
+}
+
+void
+gst_neoconvolve_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstNeoconvolve *neoconvolve = GST_NEOCONVOLVE (object);
+
+  GST_DEBUG_OBJECT (neoconvolve, "set_property");
+
+  switch (property_id) {
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (neoconvolve);
+      neoconvolve->n_threads = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (neoconvolve);
+      break;
+    case PROP_FILTER:
+      GST_OBJECT_LOCK (neoconvolve);
+      neoconvolve->filter = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (neoconvolve);
+      gst_neoconvolve_update_passthrough (neoconvolve);
+      break;
+    case PROP_RADIUS:
+      GST_OBJECT_LOCK (neoconvolve);
+      neoconvolve->radius = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (neoconvolve);
+      break;
+    case PROP_AMOUNT:
+      GST_OBJECT_LOCK (neoconvolve);
+      neoconvolve->amount = g_value_get_double (value);
+      GST_OBJECT_UNLOCK (neoconvolve);
+      gst_neoconvolve_update_passthrough (neoconvolve);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_neoconvolve_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstNeoconvolve *neoconvolve = GST_NEOCONVOLVE (object);
+
+  GST_DEBUG_OBJECT (neoconvolve, "get_property");
+
+  switch (property_id) {
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (neoconvolve);
+      g_value_set_uint (value, neoconvolve->n_threads);
+      GST_OBJECT_UNLOCK (neoconvolve);
+      break;
+    case PROP_FILTER:
+      GST_OBJECT_LOCK (neoconvolve);
+      g_value_set_enum (value, neoconvolve->filter);
+      GST_OBJECT_UNLOCK (neoconvolve);
+      break;
+    case PROP_RADIUS:
+      GST_OBJECT_LOCK (neoconvolve);
+      g_value_set_uint (value, neoconvolve->radius);
+      GST_OBJECT_UNLOCK (neoconvolve);
+      break;
+    case PROP_AMOUNT:
+      GST_OBJECT_LOCK (neoconvolve);
+      g_value_set_double (value, neoconvolve->amount);
+      GST_OBJECT_UNLOCK (neoconvolve);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_neoconvolve_finalize (GObject * object)
+{
+  GstNeoconvolve *neoconvolve = GST_NEOCONVOLVE (object);
+
+  GST_DEBUG_OBJECT (neoconvolve, "finalize");
+
+  g_mutex_clear (&neoconvolve->slice_lock);
+  g_cond_clear (&neoconvolve->slice_cond);
+
+  G_OBJECT_CLASS (gst_neoconvolve_parent_class)->finalize (object);
+}
+
+static gboolean
+gst_neoconvolve_start (GstBaseTransform * trans)
+{
+  GstNeoconvolve *neoconvolve = GST_NEOCONVOLVE (trans);
+  guint n_threads;
+  GError *err = NULL;
+
+  GST_DEBUG_OBJECT (neoconvolve, "start");
+
+  GST_OBJECT_LOCK (neoconvolve);
+  n_threads = neoconvolve->n_threads;
+  GST_OBJECT_UNLOCK (neoconvolve);
+
+  if (n_threads == 0)
+    n_threads = g_get_num_processors ();
+
+  /* the streaming thread filters the first slice itself */
+  if (n_threads > 1) {
+    neoconvolve->workers = neo_task_queue_new (gst_neoconvolve_slice_func,
+        neoconvolve, n_threads - 1, &err);
+    if (!neoconvolve->workers) {
+      GST_ELEMENT_ERROR (neoconvolve, RESOURCE, FAILED,
+          ("Could not create slice worker threads"), ("%s", err->message));
+      g_clear_error (&err);
+      return FALSE;
+    }
+  }
+
+  neoconvolve->slices = g_new0 (GstNeoconvolveSlice, n_threads);
+  neoconvolve->n_slices = n_threads;
+  neoconvolve->taps_radius = 0;
+  GST_INFO_OBJECT (neoconvolve, "filtering with %u threads", n_threads);
+
+  return TRUE;
+}
+
+static gboolean
+gst_neoconvolve_stop (GstBaseTransform * trans)
+{
+  GstNeoconvolve *neoconvolve = GST_NEOCONVOLVE (trans);
+  guint i;
+
+  GST_DEBUG_OBJECT (neoconvolve, "stop");
+
+  if (neoconvolve->workers) {
+    /* waits for the tasks still queued, the threads are shared */
+    neo_task_queue_free (neoconvolve->workers);
+    neoconvolve->workers = NULL;
+  }
+  for (i = 0; i < neoconvolve->n_slices; i++) {
+    g_free (neoconvolve->slices[i].edge);
+    g_free (neoconvolve->slices[i].ring);
+  }
+  neoconvolve->n_slices = 0;
+  g_clear_pointer (&neoconvolve->slices, g_free);
+
+  return TRUE;
+}
+
+static gboolean
+gst_neoconvolve_set_info (GstVideoFilter * filter, GstCaps * incaps,
+    GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
+{
+  GstNeoconvolve *neoconvolve = GST_NEOCONVOLVE (filter);
+
+  /* each byte of a pixel is filtered on its own, the layout doesn't
+   * matter beyond the pixel size */
+  neoconvolve->pstride = GST_VIDEO_INFO_COMP_PSTRIDE (in_info, 0);
+
+  GST_DEBUG_OBJECT (neoconvolve, "%s, %d bytes per pixel",
+      GST_VIDEO_INFO_NAME (in_info), neoconvolve->pstride);
+
+  return TRUE;
+}
+
+/* Gaussian taps of standard deviation radius / 2 scaled by 256. Every tap
+ * but the centre one is rounded down and the centre one takes what is left
+ * of 256, so they sum to exactly 256 and none is negative. */
+static void
+gst_neoconvolve_gaussian_taps (gint16 * taps, gint radius)
+{
+  gdouble sigma = radius / 2.0;
+  gdouble weights[2 * NEO_CONV_MAX_RADIUS + 1];
+  gdouble sum = 0.0;
+  gint k, rest = 256;
+
+  for (k = -radius; k <= radius; k++) {
+    weights[k + radius] = exp (-k * k / (2.0 * sigma * sigma));
+    sum += weights[k + radius];
+  }
+  for (k = 0; k <= 2 * radius; k++) {
+    if (k == radius)
+      continue;
+    taps[k] = (gint16) (weights[k] * 256.0 / sum);
+    rest -= taps[k];
+  }
+  taps[radius] = rest;
+}
+
+/* Makes sure the buffers of @slice fit the current frame and radius */
+static void
+gst_neoconvolve_slice_alloc (GstNeoconvolveSlice * slice, gint width,
+    gint radius)
+{
+  gint pstride = slice->neoconvolve->pstride;
+  gsize edge_size = (gsize) (MAX (width, radius) + 2 * radius) * pstride;
+  gsize ring_size = (gsize) (2 * radius + 1) * width * pstride;
+
+  if (slice->edge_size < edge_size) {
+    g_free (slice->edge);
+    slice->edge = g_malloc (edge_size);
+    slice->edge_size = edge_size;
+  }
+  if (slice->ring_size < ring_size) {
+    g_free (slice->ring);
+    slice->ring = g_new (gint16, ring_size);
+    slice->ring_size = ring_size;
+  }
+}
+
+/* Horizontal pass of input row @y into @dest. The middle of the row is
+ * read in place, only the ends go through the edge buffer where the first
+ * and last pixels are repeated past the frame. */
+static void
+gst_neoconvolve_row_pass (GstNeoconvolveSlice * slice, gint y, gint16 * dest)
+{
+  GstNeoconvolve *neoconvolve = slice->neoconvolve;
+  GstVideoFrame *inframe = slice->inframe;
+  NeoConvRowFunc conv_row = neoconvolve->kernels->conv_row;
+  const gint16 *taps = neoconvolve->taps;
+  gint width = GST_VIDEO_FRAME_WIDTH (inframe);
+  gint pstride = neoconvolve->pstride;
+  gint radius = neoconvolve->frame_radius;
+  gint n = width * pstride;
+  gint edge = radius * pstride;
+  const guint8 *src = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (inframe, 0) +
+      y * GST_VIDEO_FRAME_PLANE_STRIDE (inframe, 0);
+  const guint8 *last = src + n - pstride;
+  guint8 *buf = slice->edge;
+  gint i;
+
+  /* too narrow for a middle, the whole row goes through the buffer */
+  if (width <= 2 * radius) {
+    for (i = 0; i < radius; i++) {
+      memcpy (buf + i * pstride, src, pstride);
+      memcpy (buf + edge + n + i * pstride, last, pstride);
+    }
+    memcpy (buf + edge, src, n);
+    conv_row (dest, buf + edge, n, pstride, taps, radius);
+    return;
+  }
+
+  /* the first radius pixels from the repeated first pixel and 2 * radius
+   * pixels of the row */
+  for (i = 0; i < radius; i++)
+    memcpy (buf + i * pstride, src, pstride);
+  memcpy (buf + edge, src, 2 * edge);
+  conv_row (dest, buf + edge, edge, pstride, taps, radius);
+
+  conv_row (dest + edge, src + edge, n - 2 * edge, pstride, taps, radius);
+
+  /* and the last radius pixels the same way round */
+  memcpy (buf, src + n - 2 * edge, 2 * edge);
+  for (i = 0; i < radius; i++)
+    memcpy (buf + 2 * edge + i * pstride, last, pstride);
+  conv_row (dest + n - edge, buf + edge, edge, pstride, taps, radius);
+}
+
+/* Blur or sharpen the slice rows. Each output row needs the horizontal
+ * pass of the source rows up to radius away, the ring keeps the last
+ * 2 * radius + 1 of them so each is computed once. The slice starts by
+ * computing the radius rows above its first one, that overlap with the
+ * previous slice is the price of independent slices. */
+static void
+gst_neoconvolve_blur_slice (GstNeoconvolveSlice * slice)
+{
+  GstNeoconvolve *neoconvolve = slice->neoconvolve;
+  GstVideoFrame *inframe = slice->inframe;
+  GstVideoFrame *outframe = slice->outframe;
+  const NeoKernels *kernels = neoconvolve->kernels;
+  gint width = GST_VIDEO_FRAME_WIDTH (inframe);
+  gint height = GST_VIDEO_FRAME_HEIGHT (inframe);
+  gint radius = neoconvolve->frame_radius;
+  gint n_taps = 2 * radius + 1;
+  gint n = width * neoconvolve->pstride;
+  gint row_stride = GST_VIDEO_FRAME_PLANE_STRIDE (inframe, 0);
+  gint d_row_stride = GST_VIDEO_FRAME_PLANE_STRIDE (outframe, 0);
+  const guint8 *src = GST_VIDEO_FRAME_PLANE_DATA (inframe, 0);
+  guint8 *dest = GST_VIDEO_FRAME_PLANE_DATA (outframe, 0);
+  const gint16 *rows[2 * NEO_CONV_MAX_RADIUS + 1];
+  gint next = MAX (slice->row_start - radius, 0);
+  gint y, k;
+
+  gst_neoconvolve_slice_alloc (slice, width, radius);
+
+  for (y = slice->row_start; y < slice->row_end; y++) {
+    guint8 *d = dest + y * d_row_stride;
+    gint last = MIN (y + radius, height - 1);
+
+    for (; next <= last; next++)
+      gst_neoconvolve_row_pass (slice, next,
+          slice->ring + (next % n_taps) * n);
+
+    /* rows past the top and bottom repeat the first and last one */
+    for (k = 0; k < n_taps; k++)
+      rows[k] = slice->ring + (CLAMP (y + k - radius, 0, height - 1) %
+          n_taps) * n;
+
+    kernels->conv_column (d, rows, n, neoconvolve->taps, radius);
+    if (neoconvolve->frame_filter == GST_NEOCONVOLVE_FILTER_SHARPEN)
+      kernels->unsharp (d, src + y * row_stride, n, neoconvolve->frame_amount);
+  }
+}
+
+/* Sobel needs no buffer, its 3x3 window is read from the input rows */
+static void
+gst_neoconvolve_sobel_slice (GstNeoconvolveSlice * slice)
+{
+  GstNeoconvolve *neoconvolve = slice->neoconvolve;
+  GstVideoFrame *inframe = slice->inframe;
+  GstVideoFrame *outframe = slice->outframe;
+  gint height = GST_VIDEO_FRAME_HEIGHT (inframe);
+  gint pstride = neoconvolve->pstride;
+  gint n = GST_VIDEO_FRAME_WIDTH (inframe) * pstride;
+  gint row_stride = GST_VIDEO_FRAME_PLANE_STRIDE (inframe, 0);
+  gint d_row_stride = GST_VIDEO_FRAME_PLANE_STRIDE (outframe, 0);
+  const guint8 *src = GST_VIDEO_FRAME_PLANE_DATA (inframe, 0);
+  guint8 *dest = GST_VIDEO_FRAME_PLANE_DATA (outframe, 0);
+  gint y;
+
+  for (y = slice->row_start; y < slice->row_end; y++) {
+    neoconvolve->kernels->sobel (dest + y * d_row_stride,
+        src + MAX (y - 1, 0) * row_stride, src + y * row_stride,
+        src + MIN (y + 1, height - 1) * row_stride, n, pstride);
+  }
+}
+
+static void
+gst_neoconvolve_filter_slice (GstNeoconvolveSlice * slice)
+{
+  if (slice->neoconvolve->frame_filter == GST_NEOCONVOLVE_FILTER_SOBEL)
+    gst_neoconvolve_sobel_slice (slice);
+  else
+    gst_neoconvolve_blur_slice (slice);
+}
+
+static void
+gst_neoconvolve_slice_func (gpointer data, gpointer user_data)
+{
+  GstNeoconvolveSlice *slice = data;
+  GstNeoconvolve *neoconvolve = user_data;
+
+  gst_neoconvolve_filter_slice (slice);
+
+  g_mutex_lock (&neoconvolve->slice_lock);
+  if (--neoconvolve->slices_pending == 0)
+    g_cond_signal (&neoconvolve->slice_cond);
+  g_mutex_unlock (&neoconvolve->slice_lock);
+}
+
+/* transform */
+static GstFlowReturn
+gst_neoconvolve_transform_frame (GstVideoFilter * filter,
+    GstVideoFrame * inframe, GstVideoFrame * outframe)
+{
+  GstNeoconvolve *neoconvolve = GST_NEOCONVOLVE (filter);
+  gint height = GST_VIDEO_FRAME_HEIGHT (inframe);
+  gint n_slices, i;
+
+  GST_LOG_OBJECT (neoconvolve, "transform_frame %p %p", inframe, outframe);
+
+  /* property changes apply from one frame to the next */
+  GST_OBJECT_LOCK (neoconvolve);
+  neoconvolve->frame_filter = neoconvolve->filter;
+  neoconvolve->frame_radius = neoconvolve->radius;
+  neoconvolve->frame_amount = (gint) (neoconvolve->amount * 256 + 0.5);
+  GST_OBJECT_UNLOCK (neoconvolve);
+
+  if (neoconvolve->frame_filter != GST_NEOCONVOLVE_FILTER_SOBEL &&
+      neoconvolve->taps_radius != neoconvolve->frame_radius) {
+    gst_neoconvolve_gaussian_taps (neoconvolve->taps,
+        neoconvolve->frame_radius);
+    neoconvolve->taps_radius = neoconvolve->frame_radius;
+  }
+
+  n_slices = MIN ((gint) neoconvolve->n_slices, height / MIN_SLICE_ROWS);
+  n_slices = CLAMP (n_slices, 1, height);
+
+  /* spread the rows evenly, slice sizes differ by at most one row */
+  for (i = 0; i < n_slices; i++) {
+    GstNeoconvolveSlice *slice = &neoconvolve->slices[i];
+
+    slice->neoconvolve = neoconvolve;
+    slice->inframe = inframe;
+    slice->outframe = outframe;
+    slice->row_start = (gint64) height * i / n_slices;
+    slice->row_end = (gint64) height * (i + 1) / n_slices;
+  }
+
+  if (n_slices > 1) {
+    g_mutex_lock (&neoconvolve->slice_lock);
+    neoconvolve->slices_pending = n_slices - 1;
+    g_mutex_unlock (&neoconvolve->slice_lock);
+
+    for (i = 1; i < n_slices; i++)
+      neo_task_queue_push (neoconvolve->workers, &neoconvolve->slices[i]);
+  }
+
+  gst_neoconvolve_filter_slice (&neoconvolve->slices[0]);
+
+  if (n_slices > 1) {
+    g_mutex_lock (&neoconvolve->slice_lock);
+    while (neoconvolve->slices_pending > 0)
+      g_cond_wait (&neoconvolve->slice_cond, &neoconvolve->slice_lock);
+    g_mutex_unlock (&neoconvolve->slice_lock);
+  }
+
+  return GST_FLOW_OK;
+}
@@ -0,0 +1,104 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_NEOCONVOLVE_H_
+#define _GST_NEOCONVOLVE_H_
+
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+
+#include "neovideoconv-kernels.h"
+#include "neotaskpool.h"
+
+G_BEGIN_DECLS
+#define GST_TYPE_NEOCONVOLVE   (gst_neoconvolve_get_type())
+#define GST_NEOCONVOLVE(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_NEOCONVOLVE,GstNeoconvolve))
+#define GST_NEOCONVOLVE_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_NEOCONVOLVE,GstNeoconvolveClass))
+#define GST_IS_NEOCONVOLVE(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_NEOCONVOLVE))
+#define GST_IS_NEOCONVOLVE_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_NEOCONVOLVE))
+typedef struct _GstNeoconvolve GstNeoconvolve;
+typedef struct _GstNeoconvolveClass GstNeoconvolveClass;
+typedef struct _GstNeoconvolveSlice GstNeoconvolveSlice;
+
+typedef enum
+{
+  GST_NEOCONVOLVE_FILTER_BLUR,
+  GST_NEOCONVOLVE_FILTER_SHARPEN,
+  GST_NEOCONVOLVE_FILTER_SOBEL,
+} GstNeoconvolveFilter;
+
+/* a band of output rows of the current frame, handled by one thread */
+struct _GstNeoconvolveSlice
+{
+  GstNeoconvolve *neoconvolve;
+  GstVideoFrame *inframe;
+  GstVideoFrame *outframe;
+  gint row_start;
+  gint row_end;
+  /* owned by the slice and grown as needed: the pixels around a row edge
+   * with the edge pixel repeated past it, and the horizontal pass of the
+   * last 2 * radius + 1 source rows, source row y in ring row y % (2 *
+   * radius + 1) */
+  guint8 *edge;
+  gsize edge_size;
+  gint16 *ring;
+  gsize ring_size;
+};
+
+struct _GstNeoconvolve
+{
+  GstVideoFilter base_neoconvolve;
+
+  const NeoKernels *kernels;
+  /* bytes per pixel, the distance between horizontal neighbours */
+  gint pstride;
+
+  /* properties, protected by the object lock */
+  guint n_threads;
+  GstNeoconvolveFilter filter;
+  guint radius;
+  gdouble amount;
+
+  /* the properties as of the current frame, streaming thread only. taps
+   * are the Gaussian of taps_radius, scaled by 256. */
+  GstNeoconvolveFilter frame_filter;
+  gint frame_radius;
+  gint frame_amount;
+  gint taps_radius;
+  gint16 taps[2 * NEO_CONV_MAX_RADIUS + 1];
+
+  /* queue of the slice tasks on the shared workers, between start and
+   * stop */
+  NeoTaskQueue *workers;
+  guint n_slices;
+  GstNeoconvolveSlice *slices;
+  GMutex slice_lock;
+  GCond slice_cond;
+  guint slices_pending;
+};
+
+struct _GstNeoconvolveClass
+{
+  GstVideoFilterClass base_neoconvolve_class;
+};
+
+GType gst_neoconvolve_get_type (void);
+
+G_END_DECLS
+#endif
@@ -0,0 +1,590 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+/**
+ * SECTION:element-gstneolut3d
+ *
+ * The neolut3d element grades packed RGB video in place with a 3D lookup
+ * table read from an Adobe / Resolve .cube file when the element starts.
+ *
+ * The table is stored as 16-bit fixed point nodes laid out in the byte
+ * order of the negotiated pixels, four values per node, so that one load
+ * fetches a whole node. Pixels are interpolated between the nodes of their
+ * cell with SIMD kernels, trilinearly from all eight corners or
+ * tetrahedrally from four, the latter being faster and usually closer to
+ * what grading tools do. Alpha and padding bytes are left untouched.
+ *
+ * With prebake the LUT is evaluated once for every 8-bit RGB input at
+ * load time into a 64 MiB table, after which a pixel is a single lookup.
+ * Only LUTs of up to 33 points per axis are prebaked, larger ones are
+ * interpolated as usual.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 -v videotestsrc ! video/x-raw,format=BGRx ! neolut3d location=grade.cube ! videoconvert ! autovideosink
+ * ]|
+ * Applies the grade in grade.cube.
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+#include "gstneolut3d.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_neolut3d_debug_category);
+#define GST_CAT_DEFAULT gst_neolut3d_debug_category
+
+/* prototypes */
+
+static void gst_neolut3d_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_neolut3d_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_neolut3d_finalize (GObject * object);
+
+static gboolean gst_neolut3d_start (GstBaseTransform * trans);
+static gboolean gst_neolut3d_stop (GstBaseTransform * trans);
+static gboolean gst_neolut3d_set_info (GstVideoFilter * filter,
+    GstCaps * incaps, GstVideoInfo * in_info, GstCaps * outcaps,
+    GstVideoInfo * out_info);
+static GstFlowReturn gst_neolut3d_transform_frame_ip (GstVideoFilter *
+    filter, GstVideoFrame * frame);
+
+enum
+{
+  PROP_0,
+  PROP_LOCATION,
+  PROP_INTERPOLATION,
+  PROP_PREBAKE
+};
+
+#define DEFAULT_INTERPOLATION GST_NEOLUT3D_INTERPOLATION_TETRAHEDRAL
+#define DEFAULT_PREBAKE FALSE
+
+/* sizes the .cube format allows */
+#define MIN_CUBE_SIZE 2
+#define MAX_CUBE_SIZE 256
+/* largest LUT prebaked */
+#define MAX_PREBAKE_SIZE 33
+
+/* pad templates */
+
+#define VIDEO_CAPS \
+    GST_VIDEO_CAPS_MAKE("{ RGB, BGR, RGBx, BGRx, xRGB, xBGR, RGBA, BGRA, " \
+        "ARGB, ABGR }")
+
+#define GST_TYPE_NEOLUT3D_INTERPOLATION \
+    (gst_neolut3d_interpolation_get_type ())
+static GType
+gst_neolut3d_interpolation_get_type (void)
+{
+  static gsize interpolation_type = 0;
+  static const GEnumValue interpolations[] = {
+    {GST_NEOLUT3D_INTERPOLATION_TRILINEAR,
+        "Weighs the 8 corners of the cell", "trilinear"},
+    {GST_NEOLUT3D_INTERPOLATION_TETRAHEDRAL,
+        "Weighs the 4 corners of the tetrahedron of the cell", "tetrahedral"},
+    {0, NULL, NULL},
+  };
+
+  if (g_once_init_enter (&interpolation_type)) {
+    GType type = g_enum_register_static ("GstNeolut3dInterpolation",
+        interpolations);
+
+    g_once_init_leave (&interpolation_type, type);
+  }
+  return interpolation_type;
+}
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstNeolut3d, gst_neolut3d, GST_TYPE_VIDEO_FILTER,
+    GST_DEBUG_CATEGORY_INIT (gst_neolut3d_debug_category, "neolut3d", 0,
+        "debug category for neolut3d element"));
+
+static void
+gst_neolut3d_class_init (GstNeolut3dClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBaseTransformClass *base_transform_class =
+      GST_BASE_TRANSFORM_CLASS (klass);
+  GstVideoFilterClass *video_filter_class = GST_VIDEO_FILTER_CLASS (klass);
+
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
+      gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+          gst_caps_from_string (VIDEO_CAPS)));
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
+      gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+          gst_caps_from_string (VIDEO_CAPS)));
+
+  gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
+      "3D LUT colour grading", "Filter/Effect/Video",
+      "Applies a .cube 3D LUT to RGB video", "taruntejk@live.com");
+
+  gobject_class->set_property = gst_neolut3d_set_property;
+  gobject_class->get_property = gst_neolut3d_get_property;
+  gobject_class->finalize = gst_neolut3d_finalize;
+  base_transform_class->start = GST_DEBUG_FUNCPTR (gst_neolut3d_start);
+  base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_neolut3d_stop);
+  video_filter_class->set_info = GST_DEBUG_FUNCPTR (gst_neolut3d_set_info);
+  video_filter_class->transform_frame_ip =
+      GST_DEBUG_FUNCPTR (gst_neolut3d_transform_frame_ip);
+
+  g_object_class_install_property (gobject_class,
+      PROP_LOCATION,
+      g_param_spec_string ("location", "Location",
+          "Path of the .cube file holding the 3D LUT", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class,
+      PROP_INTERPOLATION,
+      g_param_spec_enum ("interpolation", "Interpolation",
+          "How pixels between the nodes of the LUT are interpolated",
+          GST_TYPE_NEOLUT3D_INTERPOLATION, DEFAULT_INTERPOLATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class,
+      PROP_PREBAKE,
+      g_param_spec_boolean ("prebake", "Prebake",
+          "Evaluate LUTs of up to 33 points per axis for every 8-bit input "
+          "when loading them, into a 64 MiB table looked up per pixel",
+          DEFAULT_PREBAKE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+}
+
+static void
+gst_neolut3d_init (GstNeolut3d * neolut3d)
+{
+  neolut3d->kernels = neo_kernels_get_default ();
+  neolut3d->interpolation = DEFAULT_INTERPOLATION;
+  neolut3d->prebake = DEFAULT_PREBAKE;
+  gst_base_transform_set_in_place (GST_BASE_TRANSFORM (neolut3d), TRUE);
+  GST_INFO_OBJECT (neolut3d, "using %s kernels", neolut3d->kernels->name);
+}
+
+void
+gst_neolut3d_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstNeolut3d *neolut3d = GST_NEOLUT3D (object);
+
+  GST_DEBUG_OBJECT (neolut3d, "set_property");
+
+  switch (property_id) {
+    case PROP_LOCATION:
+      GST_OBJECT_LOCK (neolut3d);
+      g_free (neolut3d->location);
+      neolut3d->location = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (neolut3d);
+      break;
+    case PROP_INTERPOLATION:
+      GST_OBJECT_LOCK (neolut3d);
+      neolut3d->interpolation = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (neolut3d);
+      break;
+    case PROP_PREBAKE:
+      GST_OBJECT_LOCK (neolut3d);
+      neolut3d->prebake = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (neolut3d);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_neolut3d_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstNeolut3d *neolut3d = GST_NEOLUT3D (object);
+
+  GST_DEBUG_OBJECT (neolut3d, "get_property");
+
+  switch (property_id) {
+    case PROP_LOCATION:
+      GST_OBJECT_LOCK (neolut3d);
+      g_value_set_string (value, neolut3d->location);
+      GST_OBJECT_UNLOCK (neolut3d);
+      break;
+    case PROP_INTERPOLATION:
+      GST_OBJECT_LOCK (neolut3d);
+      g_value_set_enum (value, neolut3d->interpolation);
+      GST_OBJECT_UNLOCK (neolut3d);
+      break;
+    case PROP_PREBAKE:
+      GST_OBJECT_LOCK (neolut3d);
+      g_value_set_boolean (value, neolut3d->prebake);
+      GST_OBJECT_UNLOCK (neolut3d);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_neolut3d_finalize (GObject * object)
+{
+  GstNeolut3d *neolut3d = GST_NEOLUT3D (object);
+
+  GST_DEBUG_OBJECT (neolut3d, "finalize");
+
+  g_free (neolut3d->location);
+
+  G_OBJECT_CLASS (gst_neolut3d_parent_class)->finalize (object);
+}
+
+/* Parses the @n numbers of @str into @values */
+static gboolean
+gst_neolut3d_parse_numbers (const gchar * str, gdouble * values, gint n)
+{
+  gchar *end;
+  gint i;
+
+  for (i = 0; i < n; i++) {
+    values[i] = g_ascii_strtod (str, &end);
+    if (end == str)
+      return FALSE;
+    str = end;
+  }
+
+  while (g_ascii_isspace (*str))
+    str++;
+
+  return *str == '\0';
+}
+
+/* Reads a .cube 3D LUT from @contents into neolut3d->cube, size and
+ * domain. 1D LUTs, and the 1D part of files holding both, are not
+ * supported. */
+static gboolean
+gst_neolut3d_parse_cube (GstNeolut3d * neolut3d, gchar * contents,
+    GError ** error)
+{
+  gchar **lines = g_strsplit (contents, "\n", -1);
+  gint size = 0, n_nodes = 0, n = 0, i, c;
+  gdouble min[3] = { 0.0, 0.0, 0.0 }, max[3] = { 1.0, 1.0, 1.0 };
+  gint16 *cube = NULL;
+  gboolean ret = FALSE;
+
+  for (i = 0; lines[i]; i++) {
+    gchar *line = g_strstrip (lines[i]);
+    gdouble v[3];
+
+    if (*line == '\0' || *line == '#' || g_str_has_prefix (line, "TITLE"))
+      continue;
+
+    if (g_str_has_prefix (line, "LUT_3D_SIZE")) {
+      if (!gst_neolut3d_parse_numbers (line + 11, v, 1) || v[0] != (gint) v[0]
+          || v[0] < MIN_CUBE_SIZE || v[0] > MAX_CUBE_SIZE || cube) {
+        g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+            "line %d: invalid LUT_3D_SIZE", i + 1);
+        goto done;
+      }
+      size = v[0];
+      n_nodes = size * size * size;
+      cube = g_new (gint16, n_nodes * 3);
+    } else if (g_str_has_prefix (line, "LUT_1D_SIZE")) {
+      g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+          "line %d: 1D LUTs are not supported", i + 1);
+      goto done;
+    } else if (g_str_has_prefix (line, "DOMAIN_MIN")) {
+      if (!gst_neolut3d_parse_numbers (line + 10, min, 3)) {
+        g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+            "line %d: invalid DOMAIN_MIN", i + 1);
+        goto done;
+      }
+    } else if (g_str_has_prefix (line, "DOMAIN_MAX")) {
+      if (!gst_neolut3d_parse_numbers (line + 10, max, 3)) {
+        g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+            "line %d: invalid DOMAIN_MAX", i + 1);
+        goto done;
+      }
+    } else if (g_str_has_prefix (line, "LUT_3D_INPUT_RANGE")) {
+      /* Resolve's spelling of one domain for all three components */
+      if (!gst_neolut3d_parse_numbers (line + 18, v, 2)) {
+        g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+            "line %d: invalid LUT_3D_INPUT_RANGE", i + 1);
+        goto done;
+      }
+      min[0] = min[1] = min[2] = v[0];
+      max[0] = max[1] = max[2] = v[1];
+    } else if (g_ascii_isalpha (*line)) {
+      GST_DEBUG_OBJECT (neolut3d, "ignoring line %d: %s", i + 1, line);
+    } else {
+      if (!cube || n >= n_nodes || !gst_neolut3d_parse_numbers (line, v, 3)) {
+        g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+            "line %d: unexpected %s", i + 1, !cube ? "data before "
+            "LUT_3D_SIZE" : n >= n_nodes ? "extra data" : "data");
+        goto done;
+      }
+      for (c = 0; c < 3; c++)
+        cube[n * 3 + c] = CLAMP (v[c], 0.0, 1.0) * 255 * 128 + 0.5;
+      n++;
+    }
+  }
+
+  if (!cube || n != n_nodes) {
+    g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+        "expected %d nodes, found %d", n_nodes, n);
+    goto done;
+  }
+  for (c = 0; c < 3; c++) {
+    if (!(max[c] > min[c])) {
+      g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+          "empty domain");
+      goto done;
+    }
+  }
+
+  neolut3d->size = size;
+  neolut3d->cube = g_steal_pointer (&cube);
+  memcpy (neolut3d->domain_min, min, sizeof (min));
+  memcpy (neolut3d->domain_max, max, sizeof (max));
+  ret = TRUE;
+
+done:
+  g_free (cube);
+  g_strfreev (lines);
+
+  return ret;
+}
+
+/* Lays the cube out for pixels of @pstride bytes with R, G and B at
+ * @offsets into @lut, allocating its nodes into @nodes. The other byte of
+ * 4-byte pixels is kept. */
+static void
+gst_neolut3d_layout (GstNeolut3d * neolut3d, gint pstride,
+    const gint offsets[3], NeoLut3D * lut, gint16 ** nodes)
+{
+  gint size = neolut3d->size;
+  gint n_nodes = size * size * size;
+  gint c, i, v;
+
+  g_free (*nodes);
+  *nodes = g_new0 (gint16, n_nodes * 4);
+  for (i = 0; i < n_nodes; i++) {
+    for (c = 0; c < 3; c++)
+      (*nodes)[i * 4 + offsets[c]] = neolut3d->cube[i * 3 + c];
+  }
+
+  lut->pstride = pstride;
+  lut->nodes = *nodes;
+  memset (lut->keep, pstride == 4, sizeof (lut->keep));
+  for (c = 0; c < 3; c++) {
+    lut->offsets[c] = offsets[c];
+    lut->keep[offsets[c]] = FALSE;
+  }
+  lut->step[0] = 1;
+  lut->step[1] = size;
+  lut->step[2] = size * size;
+
+  /* the last cell of an axis also covers its far end, with a weight of
+   * 256 for its upper node */
+  for (c = 0; c < 3; c++) {
+    gdouble min = neolut3d->domain_min[c];
+    gdouble range = neolut3d->domain_max[c] - min;
+
+    for (v = 0; v < 256; v++) {
+      gdouble pos = CLAMP ((v / 255.0 - min) / range, 0.0, 1.0) * (size - 1);
+      gint node = MIN ((gint) pos, size - 2);
+
+      lut->index[c][v] = node * lut->step[c];
+      lut->frac[c][v] = (gint) ((pos - node) * 256 + 0.5);
+    }
+  }
+}
+
+/* Evaluates the LUT for every 8-bit input, a row of 256 reds at a time */
+static void
+gst_neolut3d_prebake (GstNeolut3d * neolut3d)
+{
+  static const gint offsets[3] = { 0, 1, 2 };
+  NeoLut3D *lut = g_new (NeoLut3D, 1);
+  gint16 *nodes = NULL;
+  guint8 *row;
+  gint r, g, b;
+
+  gst_neolut3d_layout (neolut3d, 4, offsets, lut, &nodes);
+  neolut3d->baked = g_malloc (256 * 256 * 256 * 4);
+
+  for (b = 0; b < 256; b++) {
+    for (g = 0; g < 256; g++) {
+      row = neolut3d->baked + ((b << 16) | (g << 8)) * 4;
+      for (r = 0; r < 256; r++) {
+        row[r * 4] = r;
+        row[r * 4 + 1] = g;
+        row[r * 4 + 2] = b;
+        row[r * 4 + 3] = 0;
+      }
+      neolut3d->apply (row, row, 256, lut);
+    }
+  }
+
+  g_free (nodes);
+  g_free (lut);
+}
+
+static gboolean
+gst_neolut3d_start (GstBaseTransform * trans)
+{
+  GstNeolut3d *neolut3d = GST_NEOLUT3D (trans);
+  GstNeolut3dInterpolation interpolation;
+  gchar *location, *contents = NULL;
+  gboolean prebake;
+  GError *err = NULL;
+
+  GST_DEBUG_OBJECT (neolut3d, "start");
+
+  GST_OBJECT_LOCK (neolut3d);
+  location = g_strdup (neolut3d->location);
+  interpolation = neolut3d->interpolation;
+  prebake = neolut3d->prebake;
+  GST_OBJECT_UNLOCK (neolut3d);
+
+  if (!location) {
+    GST_ELEMENT_ERROR (neolut3d, RESOURCE, NOT_FOUND,
+        ("No LUT file given"), ("the location property is not set"));
+    return FALSE;
+  }
+
+  if (!g_file_get_contents (location, &contents, NULL, &err)) {
+    GST_ELEMENT_ERROR (neolut3d, RESOURCE, OPEN_READ,
+        ("Could not read LUT file \"%s\"", location), ("%s", err->message));
+    goto error;
+  }
+  if (!gst_neolut3d_parse_cube (neolut3d, contents, &err)) {
+    GST_ELEMENT_ERROR (neolut3d, RESOURCE, READ,
+        ("Could not parse LUT file \"%s\"", location), ("%s", err->message));
+    goto error;
+  }
+
+  neolut3d->apply = interpolation == GST_NEOLUT3D_INTERPOLATION_TRILINEAR ?
+      neolut3d->kernels->lut3d_trilinear : neolut3d->kernels->lut3d_tetrahedral;
+  GST_INFO_OBJECT (neolut3d, "loaded %d^3 LUT from %s", neolut3d->size,
+      location);
+
+  if (prebake && neolut3d->size <= MAX_PREBAKE_SIZE) {
+    GstClockTime start = gst_util_get_timestamp ();
+
+    gst_neolut3d_prebake (neolut3d);
+    GST_INFO_OBJECT (neolut3d, "prebaked in %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (gst_util_get_timestamp () - start));
+  } else if (prebake) {
+    GST_WARNING_OBJECT (neolut3d, "not prebaking a %d^3 LUT, only up to "
+        "%d^3", neolut3d->size, MAX_PREBAKE_SIZE);
+  }
+
+  g_free (contents);
+  g_free (location);
+
+  return TRUE;
+
+error:
+  g_clear_error (&err);
+  g_free (contents);
+  g_free (location);
+
+  return FALSE;
+}
+
+static gboolean
+gst_neolut3d_stop (GstBaseTransform * trans)
+{
+  GstNeolut3d *neolut3d = GST_NEOLUT3D (trans);
+
+  GST_DEBUG_OBJECT (neolut3d, "stop");
+
+  g_clear_pointer (&neolut3d->cube, g_free);
+  g_clear_pointer (&neolut3d->nodes, g_free);
+  g_clear_pointer (&neolut3d->baked, g_free);
+  neolut3d->lut.nodes = NULL;
+
+  return TRUE;
+}
+
+static gboolean
+gst_neolut3d_set_info (GstVideoFilter * filter, GstCaps * incaps,
+    GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
+{
+  GstNeolut3d *neolut3d = GST_NEOLUT3D (filter);
+  gint offsets[3], c;
+
+  for (c = 0; c < 3; c++)
+    offsets[c] = GST_VIDEO_INFO_COMP_POFFSET (in_info, c);
+  gst_neolut3d_layout (neolut3d, GST_VIDEO_INFO_COMP_PSTRIDE (in_info, 0),
+      offsets, &neolut3d->lut, &neolut3d->nodes);
+
+  GST_DEBUG_OBJECT (neolut3d, "%s with %s kernels%s",
+      GST_VIDEO_INFO_NAME (in_info), neolut3d->kernels->name,
+      neolut3d->baked ? ", prebaked" : "");
+
+  return TRUE;
+}
+
+/* one lookup per pixel in the prebaked table */
+static void
+gst_neolut3d_lookup_row (GstNeolut3d * neolut3d, guint8 * data, gint width)
+{
+  const NeoLut3D *lut = &neolut3d->lut;
+  gint r = lut->offsets[0], g = lut->offsets[1], b = lut->offsets[2];
+  gint i;
+
+  for (i = 0; i < width; i++, data += lut->pstride) {
+    const guint8 *out = neolut3d->baked +
+        ((data[b] << 16) | (data[g] << 8) | data[r]) * 4;
+
+    data[r] = out[0];
+    data[g] = out[1];
+    data[b] = out[2];
+  }
+}
+
+static GstFlowReturn
+gst_neolut3d_transform_frame_ip (GstVideoFilter * filter,
+    GstVideoFrame * frame)
+{
+  GstNeolut3d *neolut3d = GST_NEOLUT3D (filter);
+  gint width = GST_VIDEO_FRAME_WIDTH (frame);
+  gint height = GST_VIDEO_FRAME_HEIGHT (frame);
+  gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
+  guint8 *data = GST_VIDEO_FRAME_PLANE_DATA (frame, 0);
+  gint row;
+
+  GST_LOG_OBJECT (neolut3d, "transform_frame_ip %p", frame);
+
+  for (row = 0; row < height; row++, data += stride) {
+    if (neolut3d->baked)
+      gst_neolut3d_lookup_row (neolut3d, data, width);
+    else
+      neolut3d->apply (data, data, width, &neolut3d->lut);
+  }
+
+  return GST_FLOW_OK;
+}
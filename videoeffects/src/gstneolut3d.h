@@ -0,0 +1,80 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_NEOLUT3D_H_
+#define _GST_NEOLUT3D_H_
+
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+
+#include "neovideoconv-kernels.h"
+
+G_BEGIN_DECLS
+#define GST_TYPE_NEOLUT3D   (gst_neolut3d_get_type())
+#define GST_NEOLUT3D(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_NEOLUT3D,GstNeolut3d))
+#define GST_NEOLUT3D_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_NEOLUT3D,GstNeolut3dClass))
+#define GST_IS_NEOLUT3D(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_NEOLUT3D))
+#define GST_IS_NEOLUT3D_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_NEOLUT3D))
+typedef struct _GstNeolut3d GstNeolut3d;
+typedef struct _GstNeolut3dClass GstNeolut3dClass;
+
+typedef enum
+{
+  GST_NEOLUT3D_INTERPOLATION_TRILINEAR,
+  GST_NEOLUT3D_INTERPOLATION_TETRAHEDRAL,
+} GstNeolut3dInterpolation;
+
+struct _GstNeolut3d
+{
+  GstVideoFilter base_neolut3d;
+
+  const NeoKernels *kernels;
+  NeoLut3DFunc apply;
+
+  /* properties, protected by the object lock */
+  gchar *location;
+  GstNeolut3dInterpolation interpolation;
+  gboolean prebake;
+
+  /* the LUT loaded in start: size nodes along each axis, red varying
+   * fastest, with R, G and B of each node scaled to 0..255 * 128, and the
+   * input range it covers */
+  gint size;
+  gint16 *cube;
+  gdouble domain_min[3];
+  gdouble domain_max[3];
+
+  /* the cube laid out for the pixels of the caps */
+  NeoLut3D lut;
+  gint16 *nodes;
+
+  /* when prebaked, the output of every 8-bit input as R, G, B and a zero
+   * byte, input R, G, B at ((b << 16) | (g << 8) | r) * 4. NULL if not. */
+  guint8 *baked;
+};
+
+struct _GstNeolut3dClass
+{
+  GstVideoFilterClass base_neolut3d_class;
+};
+
+GType gst_neolut3d_get_type (void);
+
+G_END_DECLS
+#endif
@@ -0,0 +1,120 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_MEMFD_CREATE
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <gst/gst.h>
+#include <gst/allocators/gstfdmemory.h>
+#include "gstneomemfdallocator.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_neo_memfd_allocator_debug_category);
+#define GST_CAT_DEFAULT gst_neo_memfd_allocator_debug_category
+
+G_DEFINE_TYPE_WITH_CODE (GstNeoMemfdAllocator, gst_neo_memfd_allocator,
+    GST_TYPE_FD_ALLOCATOR,
+    GST_DEBUG_CATEGORY_INIT (gst_neo_memfd_allocator_debug_category,
+        "neomemfdallocator", 0, "debug category for the memfd allocator"));
+
+static GstMemory *
+gst_neo_memfd_allocator_alloc (GstAllocator * allocator, gsize size,
+    GstAllocationParams * params)
+{
+#ifdef HAVE_MEMFD_CREATE
+  GstMemory *mem;
+  gsize maxsize;
+  gint fd;
+
+  maxsize = size + params->prefix + params->padding;
+
+  fd = memfd_create ("neovideoconv", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0) {
+    GST_ERROR_OBJECT (allocator, "memfd_create failed: %s",
+        g_strerror (errno));
+    return NULL;
+  }
+  if (ftruncate (fd, maxsize) < 0) {
+    GST_ERROR_OBJECT (allocator, "could not size memfd to %" G_GSIZE_FORMAT
+        " bytes: %s", maxsize, g_strerror (errno));
+    close (fd);
+    return NULL;
+  }
+#ifdef F_ADD_SEALS
+  /* whoever receives the fd can map all of it and can't make it shrink
+   * under our mapping */
+  if (fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) < 0)
+    GST_WARNING_OBJECT (allocator, "could not seal memfd: %s",
+        g_strerror (errno));
+#endif
+
+  /* the mapping is page aligned, which covers any params->align, and kept
+   * for the life of the memory so that a recycled buffer maps for free */
+  mem = gst_fd_allocator_alloc (allocator, fd, maxsize,
+      GST_FD_MEMORY_FLAG_KEEP_MAPPED);
+  if (!mem) {
+    close (fd);
+    return NULL;
+  }
+  gst_memory_resize (mem, params->prefix, size);
+
+  return mem;
+#else
+  return NULL;
+#endif
+}
+
+static void
+gst_neo_memfd_allocator_class_init (GstNeoMemfdAllocatorClass * klass)
+{
+  GstAllocatorClass *allocator_class = GST_ALLOCATOR_CLASS (klass);
+
+  allocator_class->alloc = gst_neo_memfd_allocator_alloc;
+}
+
+static void
+gst_neo_memfd_allocator_init (GstNeoMemfdAllocator * self)
+{
+  /* unlike the plain fd allocator this one can allocate on its own, so any
+   * buffer pool may use it */
+  GST_OBJECT_FLAG_UNSET (self, GST_ALLOCATOR_FLAG_CUSTOM_ALLOC);
+}
+
+/* Returns a new memfd allocator, or NULL where memfd_create() is not
+ * available */
+GstAllocator *
+gst_neo_memfd_allocator_new (void)
+{
+#ifdef HAVE_MEMFD_CREATE
+  return gst_object_ref_sink (g_object_new (GST_TYPE_NEO_MEMFD_ALLOCATOR,
+          NULL));
+#else
+  return NULL;
+#endif
+}
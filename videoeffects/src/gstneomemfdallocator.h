@@ -0,0 +1,53 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_NEOMEMFDALLOCATOR_H_
+#define _GST_NEOMEMFDALLOCATOR_H_
+
+#include <gst/gst.h>
+#include <gst/allocators/gstfdmemory.h>
+
+G_BEGIN_DECLS
+#define GST_TYPE_NEO_MEMFD_ALLOCATOR   (gst_neo_memfd_allocator_get_type())
+#define GST_NEO_MEMFD_ALLOCATOR(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_NEO_MEMFD_ALLOCATOR,GstNeoMemfdAllocator))
+#define GST_NEO_MEMFD_ALLOCATOR_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_NEO_MEMFD_ALLOCATOR,GstNeoMemfdAllocatorClass))
+#define GST_IS_NEO_MEMFD_ALLOCATOR(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_NEO_MEMFD_ALLOCATOR))
+#define GST_IS_NEO_MEMFD_ALLOCATOR_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_NEO_MEMFD_ALLOCATOR))
+typedef struct _GstNeoMemfdAllocator GstNeoMemfdAllocator;
+typedef struct _GstNeoMemfdAllocatorClass GstNeoMemfdAllocatorClass;
+
+/* hands out GstFdMemory, each backed by its own sealed memfd, so that
+ * gst_fd_memory_get_fd() works on the output of an element without any
+ * GPU or DMA heap */
+struct _GstNeoMemfdAllocator
+{
+  GstFdAllocator base_neo_memfd_allocator;
+};
+
+struct _GstNeoMemfdAllocatorClass
+{
+  GstFdAllocatorClass base_neo_memfd_allocator_class;
+};
+
+GType gst_neo_memfd_allocator_get_type (void);
+
+GstAllocator *gst_neo_memfd_allocator_new (void);
+
+G_END_DECLS
+#endif
@@ -0,0 +1,546 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+/**
+ * SECTION:element-gstneomotion
+ *
+ * The neomotion element detects motion in GRAY8 video, such as the output
+ * of neovideoconv, to tell which frames are worth the expensive analysis
+ * further down the pipeline.
+ *
+ * Each frame is shrunk by 4 in both directions with SIMD kernels and
+ * compared with a running average of the previous shrunk frames, the
+ * background. The sum of absolute differences of every block of 32x32
+ * pixels is taken with SIMD SAD instructions, and a block whose mean
+ * difference exceeds block-threshold is moving. learning-rate sets how
+ * fast the background takes in changes of the scene. The pixels are only
+ * read, so buffers shared with other branches are not copied.
+ *
+ * Every frame gets a GstNeomotionMeta custom meta with its motion score,
+ * the share of moving blocks, and a GstVideoRegionOfInterestMeta of type
+ * "motion" around each group of adjacent moving blocks. With drop, frames
+ * scoring no more than threshold are dropped, so that downstream only sees
+ * frames with motion. The first frame only seeds the background and scores
+ * 0.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 -v v4l2src ! videoconvert ! neovideoconv ! video/x-raw,format=GRAY8 ! neomotion drop=true threshold=0.01 ! queue ! ...
+ * ]|
+ * Passes on only the frames where more than 1% of the picture moves.
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+#include "gstneomotion.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_neomotion_debug_category);
+#define GST_CAT_DEFAULT gst_neomotion_debug_category
+
+/* prototypes */
+
+static void gst_neomotion_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_neomotion_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_neomotion_finalize (GObject * object);
+
+static gboolean gst_neomotion_stop (GstBaseTransform * trans);
+static GstFlowReturn gst_neomotion_transform_ip (GstBaseTransform * trans,
+    GstBuffer * buf);
+static gboolean gst_neomotion_set_info (GstVideoFilter * filter,
+    GstCaps * incaps, GstVideoInfo * in_info, GstCaps * outcaps,
+    GstVideoInfo * out_info);
+
+enum
+{
+  PROP_0,
+  PROP_THRESHOLD,
+  PROP_DROP,
+  PROP_BLOCK_THRESHOLD,
+  PROP_LEARNING_RATE
+};
+
+#define DEFAULT_THRESHOLD 0.0
+#define DEFAULT_DROP FALSE
+#define DEFAULT_BLOCK_THRESHOLD 12
+#define DEFAULT_LEARNING_RATE 0.05
+
+/* frames are shrunk by SHRINK, blocks are BLOCK shrunk pixels wide and
+ * high, BLOCK matching the 8-byte groups of the SAD kernels */
+#define SHRINK 4
+#define BLOCK 8
+
+/* pad templates */
+
+#define VIDEO_CAPS GST_VIDEO_CAPS_MAKE("GRAY8")
+
+static const gchar *motion_meta_tags[] = { NULL };
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstNeomotion, gst_neomotion, GST_TYPE_VIDEO_FILTER,
+    GST_DEBUG_CATEGORY_INIT (gst_neomotion_debug_category, "neomotion", 0,
+        "debug category for neomotion element"));
+
+static void
+gst_neomotion_class_init (GstNeomotionClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBaseTransformClass *base_transform_class =
+      GST_BASE_TRANSFORM_CLASS (klass);
+  GstVideoFilterClass *video_filter_class = GST_VIDEO_FILTER_CLASS (klass);
+
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
+      gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+          gst_caps_from_string (VIDEO_CAPS)));
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
+      gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+          gst_caps_from_string (VIDEO_CAPS)));
+
+  gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
+      "Motion detection", "Filter/Analyzer/Video",
+      "Scores the motion of GRAY8 video against a running background, "
+      "marks where it is and optionally drops still frames",
+      "taruntejk@live.com");
+
+  gobject_class->set_property = gst_neomotion_set_property;
+  gobject_class->get_property = gst_neomotion_get_property;
+  gobject_class->finalize = gst_neomotion_finalize;
+  base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_neomotion_stop);
+  /* replaces the one of GstVideoFilter, which maps the frame for writing */
+  base_transform_class->transform_ip =
+      GST_DEBUG_FUNCPTR (gst_neomotion_transform_ip);
+  video_filter_class->set_info = GST_DEBUG_FUNCPTR (gst_neomotion_set_info);
+
+  g_object_class_install_property (gobject_class,
+      PROP_THRESHOLD,
+      g_param_spec_double ("threshold", "Threshold",
+          "Score, the share of moving blocks, a frame has to exceed not to "
+          "be dropped when drop is set",
+          0.0, 1.0, DEFAULT_THRESHOLD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_CONTROLLABLE | GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class,
+      PROP_DROP,
+      g_param_spec_boolean ("drop", "Drop",
+          "Drop the frames scoring no more than threshold",
+          DEFAULT_DROP, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class,
+      PROP_BLOCK_THRESHOLD,
+      g_param_spec_uint ("block-threshold", "Block threshold",
+          "Mean absolute difference from the background, in grey levels, "
+          "above which a block of 32x32 pixels is moving",
+          0, 255, DEFAULT_BLOCK_THRESHOLD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_CONTROLLABLE | GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class,
+      PROP_LEARNING_RATE,
+      g_param_spec_double ("learning-rate", "Learning rate",
+          "Weight of each frame in the background, from 0 (the first frame "
+          "stays the background) to 1 (the previous frame is)",
+          0.0, 1.0, DEFAULT_LEARNING_RATE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_CONTROLLABLE | GST_PARAM_MUTABLE_PLAYING));
+
+  /* no tags: the motion stays valid through any later transformation
+   * that keeps the frame */
+  gst_meta_register_custom (GST_NEOMOTION_META_NAME, motion_meta_tags, NULL,
+      NULL, NULL);
+}
+
+static void
+gst_neomotion_init (GstNeomotion * neomotion)
+{
+  neomotion->kernels = neo_kernels_get_default ();
+  neomotion->threshold = DEFAULT_THRESHOLD;
+  neomotion->drop = DEFAULT_DROP;
+  neomotion->block_threshold = DEFAULT_BLOCK_THRESHOLD;
+  neomotion->learning_rate = DEFAULT_LEARNING_RATE;
+  gst_base_transform_set_in_place (GST_BASE_TRANSFORM (neomotion), TRUE);
+  GST_INFO_OBJECT (neomotion, "using %s kernels", neomotion->kernels->name);
+}
+
+void
+gst_neomotion_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstNeomotion *neomotion = GST_NEOMOTION (object);
+
+  GST_DEBUG_OBJECT (neomotion, "set_property");
+
+  switch (property_id) {
+    case PROP_THRESHOLD:
+      GST_OBJECT_LOCK (neomotion);
+      neomotion->threshold = g_value_get_double (value);
+      GST_OBJECT_UNLOCK (neomotion);
+      break;
+    case PROP_DROP:
+      GST_OBJECT_LOCK (neomotion);
+      neomotion->drop = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (neomotion);
+      break;
+    case PROP_BLOCK_THRESHOLD:
+      GST_OBJECT_LOCK (neomotion);
+      neomotion->block_threshold = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (neomotion);
+      break;
+    case PROP_LEARNING_RATE:
+      GST_OBJECT_LOCK (neomotion);
+      neomotion->learning_rate = g_value_get_double (value);
+      GST_OBJECT_UNLOCK (neomotion);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_neomotion_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstNeomotion *neomotion = GST_NEOMOTION (object);
+
+  GST_DEBUG_OBJECT (neomotion, "get_property");
+
+  switch (property_id) {
+    case PROP_THRESHOLD:
+      GST_OBJECT_LOCK (neomotion);
+      g_value_set_double (value, neomotion->threshold);
+      GST_OBJECT_UNLOCK (neomotion);
+      break;
+    case PROP_DROP:
+      GST_OBJECT_LOCK (neomotion);
+      g_value_set_boolean (value, neomotion->drop);
+      GST_OBJECT_UNLOCK (neomotion);
+      break;
+    case PROP_BLOCK_THRESHOLD:
+      GST_OBJECT_LOCK (neomotion);
+      g_value_set_uint (value, neomotion->block_threshold);
+      GST_OBJECT_UNLOCK (neomotion);
+      break;
+    case PROP_LEARNING_RATE:
+      GST_OBJECT_LOCK (neomotion);
+      g_value_set_double (value, neomotion->learning_rate);
+      GST_OBJECT_UNLOCK (neomotion);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_neomotion_free_model (GstNeomotion * neomotion)
+{
+  g_clear_pointer (&neomotion->shrunk, g_free);
+  g_clear_pointer (&neomotion->background, g_free);
+  g_clear_pointer (&neomotion->background8, g_free);
+  g_clear_pointer (&neomotion->sads, g_free);
+  g_clear_pointer (&neomotion->labels, g_free);
+  g_clear_pointer (&neomotion->stack, g_free);
+  neomotion->have_background = FALSE;
+}
+
+void
+gst_neomotion_finalize (GObject * object)
+{
+  GstNeomotion *neomotion = GST_NEOMOTION (object);
+
+  GST_DEBUG_OBJECT (neomotion, "finalize");
+
+  gst_neomotion_free_model (neomotion);
+
+  G_OBJECT_CLASS (gst_neomotion_parent_class)->finalize (object);
+}
+
+static gboolean
+gst_neomotion_stop (GstBaseTransform * trans)
+{
+  GstNeomotion *neomotion = GST_NEOMOTION (trans);
+
+  GST_DEBUG_OBJECT (neomotion, "stop");
+
+  gst_neomotion_free_model (neomotion);
+
+  return TRUE;
+}
+
+static gboolean
+gst_neomotion_set_info (GstVideoFilter * filter, GstCaps * incaps,
+    GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
+{
+  GstNeomotion *neomotion = GST_NEOMOTION (filter);
+  gsize n_blocks;
+
+  GST_DEBUG_OBJECT (neomotion, "set_info");
+
+  /* the rightmost and bottom 3 pixels at most are left out */
+  neomotion->width = GST_VIDEO_INFO_WIDTH (in_info) / SHRINK;
+  neomotion->height = GST_VIDEO_INFO_HEIGHT (in_info) / SHRINK;
+  if (neomotion->width == 0 || neomotion->height == 0) {
+    GST_ERROR_OBJECT (neomotion, "frames of %dx%d are too small",
+        GST_VIDEO_INFO_WIDTH (in_info), GST_VIDEO_INFO_HEIGHT (in_info));
+    return FALSE;
+  }
+
+  /* a new size starts over with a new background */
+  gst_neomotion_free_model (neomotion);
+
+  neomotion->blocks_x = (neomotion->width + BLOCK - 1) / BLOCK;
+  neomotion->blocks_y = (neomotion->height + BLOCK - 1) / BLOCK;
+  neomotion->stride = neomotion->blocks_x * BLOCK;
+  n_blocks = (gsize) neomotion->blocks_x * neomotion->blocks_y;
+
+  /* the padding columns stay 0 in both the frame and the background, so
+   * they add nothing to the SADs */
+  neomotion->shrunk = g_malloc0 ((gsize) neomotion->stride *
+      neomotion->height);
+  neomotion->background8 = g_malloc0 ((gsize) neomotion->stride *
+      neomotion->height);
+  neomotion->background = g_new0 (guint16, (gsize) neomotion->stride *
+      neomotion->height);
+  neomotion->sads = g_new (guint32, n_blocks);
+  neomotion->labels = g_new (gint, n_blocks);
+  neomotion->stack = g_new (gint, n_blocks);
+
+  GST_DEBUG_OBJECT (neomotion, "%dx%d blocks of %d pixels",
+      neomotion->blocks_x, neomotion->blocks_y, BLOCK * SHRINK);
+
+  return TRUE;
+}
+
+/* Shrinks the frame in @buf into neomotion->shrunk */
+static gboolean
+gst_neomotion_shrink (GstNeomotion * neomotion, GstBuffer * buf)
+{
+  GstVideoFrame frame;
+  const guint8 *src, *rows[SHRINK];
+  gint stride, y, k;
+
+  if (!gst_video_frame_map (&frame, &GST_VIDEO_FILTER (neomotion)->in_info,
+          buf, GST_MAP_READ))
+    return FALSE;
+
+  src = GST_VIDEO_FRAME_PLANE_DATA (&frame, 0);
+  stride = GST_VIDEO_FRAME_PLANE_STRIDE (&frame, 0);
+  for (y = 0; y < neomotion->height; y++) {
+    for (k = 0; k < SHRINK; k++)
+      rows[k] = src + (gsize) (y * SHRINK + k) * stride;
+    neomotion->kernels->shrink4 (neomotion->shrunk + (gsize) y *
+        neomotion->stride, rows, neomotion->width);
+  }
+
+  gst_video_frame_unmap (&frame);
+
+  return TRUE;
+}
+
+/* Moves the background towards the shrunk frame by @rate out of 256 */
+static void
+gst_neomotion_learn (GstNeomotion * neomotion, gint rate)
+{
+  gint x, y;
+
+  for (y = 0; y < neomotion->height; y++) {
+    gsize row = (gsize) y * neomotion->stride;
+    const guint8 *cur = neomotion->shrunk + row;
+    guint16 *bg = neomotion->background + row;
+    guint8 *bg8 = neomotion->background8 + row;
+
+    for (x = 0; x < neomotion->width; x++) {
+      gint b = bg[x];
+
+      b += (((gint) cur[x] << 8) - b) * rate / 256;
+      bg[x] = b;
+      bg8[x] = (b + 128) >> 8;
+    }
+  }
+}
+
+/* Sets the label of every block whose mean difference from the background
+ * is above @block_threshold to -1 and of the others to 0. Returns the
+ * number of moving blocks. */
+static guint
+gst_neomotion_find_moving (GstNeomotion * neomotion, guint block_threshold)
+{
+  guint32 *sads = neomotion->sads;
+  gint bx, by, y;
+  guint moving = 0;
+
+  memset (sads, 0, sizeof (guint32) * neomotion->blocks_x *
+      neomotion->blocks_y);
+  for (y = 0; y < neomotion->height; y++) {
+    gsize row = (gsize) y * neomotion->stride;
+
+    neomotion->kernels->block_sad (sads + (y / BLOCK) * neomotion->blocks_x,
+        neomotion->shrunk + row, neomotion->background8 + row,
+        neomotion->blocks_x);
+  }
+
+  for (by = 0; by < neomotion->blocks_y; by++) {
+    gint rows = MIN (BLOCK, neomotion->height - by * BLOCK);
+
+    for (bx = 0; bx < neomotion->blocks_x; bx++) {
+      gint b = by * neomotion->blocks_x + bx;
+      gint cols = MIN (BLOCK, neomotion->width - bx * BLOCK);
+
+      if (sads[b] > (guint32) block_threshold * rows * cols) {
+        neomotion->labels[b] = -1;
+        moving++;
+      } else {
+        neomotion->labels[b] = 0;
+      }
+    }
+  }
+
+  return moving;
+}
+
+/* Attaches a region of interest meta around each group of moving blocks,
+ * adjacent ones horizontally or vertically being one group */
+static void
+gst_neomotion_add_boxes (GstNeomotion * neomotion, GstBuffer * buf)
+{
+  GstVideoInfo *info = &GST_VIDEO_FILTER (neomotion)->in_info;
+  gint blocks_x = neomotion->blocks_x, blocks_y = neomotion->blocks_y;
+  gint *labels = neomotion->labels, *stack = neomotion->stack;
+  gint b, label = 0, block_size = BLOCK * SHRINK;
+
+  for (b = 0; b < blocks_x * blocks_y; b++) {
+    gint x0, y0, x1, y1, x, y, n = 0;
+
+    if (labels[b] != -1)
+      continue;
+
+    label++;
+    labels[b] = label;
+    stack[n++] = b;
+    x0 = x1 = b % blocks_x;
+    y0 = y1 = b / blocks_x;
+
+    while (n > 0) {
+      gint cur = stack[--n], cx = cur % blocks_x, cy = cur / blocks_x;
+      gint next[4] = { -1, -1, -1, -1 }, k;
+
+      x0 = MIN (x0, cx);
+      x1 = MAX (x1, cx);
+      y0 = MIN (y0, cy);
+      y1 = MAX (y1, cy);
+
+      if (cx > 0)
+        next[0] = cur - 1;
+      if (cx < blocks_x - 1)
+        next[1] = cur + 1;
+      if (cy > 0)
+        next[2] = cur - blocks_x;
+      if (cy < blocks_y - 1)
+        next[3] = cur + blocks_x;
+      for (k = 0; k < 4; k++) {
+        if (next[k] >= 0 && labels[next[k]] == -1) {
+          labels[next[k]] = label;
+          stack[n++] = next[k];
+        }
+      }
+    }
+
+    x = x0 * block_size;
+    y = y0 * block_size;
+    gst_buffer_add_video_region_of_interest_meta (buf, "motion", x, y,
+        MIN ((x1 + 1) * block_size, GST_VIDEO_INFO_WIDTH (info)) - x,
+        MIN ((y1 + 1) * block_size, GST_VIDEO_INFO_HEIGHT (info)) - y);
+  }
+}
+
+static void
+gst_neomotion_add_meta (GstBuffer * buf, gdouble score, guint moving,
+    guint blocks)
+{
+  GstCustomMeta *meta;
+
+  meta = gst_buffer_get_custom_meta (buf, GST_NEOMOTION_META_NAME);
+  if (meta)
+    gst_buffer_remove_meta (buf, (GstMeta *) meta);
+  meta = gst_buffer_add_custom_meta (buf, GST_NEOMOTION_META_NAME);
+
+  gst_structure_set (gst_custom_meta_get_structure (meta),
+      "score", G_TYPE_DOUBLE, score, "moving-blocks", G_TYPE_UINT, moving,
+      "blocks", G_TYPE_UINT, blocks, NULL);
+}
+
+/* transform */
+static GstFlowReturn
+gst_neomotion_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+  GstNeomotion *neomotion = GST_NEOMOTION (trans);
+  guint blocks = neomotion->blocks_x * neomotion->blocks_y;
+  guint block_threshold, moving = 0;
+  gdouble threshold, learning_rate, score;
+  gboolean drop;
+
+  GST_LOG_OBJECT (neomotion, "transform_ip %p", buf);
+
+  /* property changes apply from one frame to the next */
+  GST_OBJECT_LOCK (neomotion);
+  threshold = neomotion->threshold;
+  drop = neomotion->drop;
+  block_threshold = neomotion->block_threshold;
+  learning_rate = neomotion->learning_rate;
+  GST_OBJECT_UNLOCK (neomotion);
+
+  if (!gst_neomotion_shrink (neomotion, buf)) {
+    GST_ELEMENT_WARNING (neomotion, CORE, NOT_IMPLEMENTED, (NULL),
+        ("invalid video buffer received"));
+    return GST_FLOW_OK;
+  }
+
+  if (neomotion->have_background) {
+    moving = gst_neomotion_find_moving (neomotion, block_threshold);
+    gst_neomotion_learn (neomotion, (gint) (learning_rate * 256 + 0.5));
+  } else {
+    gst_neomotion_learn (neomotion, 256);
+    neomotion->have_background = TRUE;
+  }
+  score = (gdouble) moving / blocks;
+
+  GST_LOG_OBJECT (neomotion, "score %f, %u of %u blocks moving", score,
+      moving, blocks);
+
+  if (drop && score <= threshold)
+    return GST_BASE_TRANSFORM_FLOW_DROPPED;
+
+  gst_neomotion_add_meta (buf, score, moving, blocks);
+  if (moving > 0)
+    gst_neomotion_add_boxes (neomotion, buf);
+
+  return GST_FLOW_OK;
+}
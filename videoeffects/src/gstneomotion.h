@@ -0,0 +1,86 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_NEOMOTION_H_
+#define _GST_NEOMOTION_H_
+
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+
+#include "neovideoconv-kernels.h"
+
+G_BEGIN_DECLS
+#define GST_TYPE_NEOMOTION   (gst_neomotion_get_type())
+#define GST_NEOMOTION(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_NEOMOTION,GstNeomotion))
+#define GST_NEOMOTION_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_NEOMOTION,GstNeomotionClass))
+#define GST_IS_NEOMOTION(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_NEOMOTION))
+#define GST_IS_NEOMOTION_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_NEOMOTION))
+typedef struct _GstNeomotion GstNeomotion;
+typedef struct _GstNeomotionClass GstNeomotionClass;
+
+/* Name of the custom meta attached to every frame passed on: score
+ * (gdouble), the share of blocks in motion, moving-blocks and blocks
+ * (guint). The boxes around groups of moving blocks are attached as
+ * GstVideoRegionOfInterestMeta of type "motion". */
+#define GST_NEOMOTION_META_NAME "GstNeomotionMeta"
+
+struct _GstNeomotion
+{
+  GstVideoFilter base_neomotion;
+
+  const NeoKernels *kernels;
+
+  /* properties, protected by the object lock */
+  gdouble threshold;
+  gboolean drop;
+  guint block_threshold;
+  gdouble learning_rate;
+
+  /* the frame shrunk by 4 in both directions, width x height bytes whose
+   * rows are stride bytes apart, padded with zeroes to whole blocks */
+  gint width;
+  gint height;
+  gint stride;
+  guint8 *shrunk;
+
+  /* running average of the shrunk frames with 8 fractional bits, and the
+   * same rounded to bytes, laid out as shrunk. Seeded by the first frame
+   * after set_info. */
+  guint16 *background;
+  guint8 *background8;
+  gboolean have_background;
+
+  /* blocks of 8x8 shrunk pixels: their SAD against the background, and
+   * whether they moved, then the box they belong to, 0 if none */
+  gint blocks_x;
+  gint blocks_y;
+  guint32 *sads;
+  gint *labels;
+  gint *stack;
+};
+
+struct _GstNeomotionClass
+{
+  GstVideoFilterClass base_neomotion_class;
+};
+
+GType gst_neomotion_get_type (void);
+
+G_END_DECLS
+#endif
@@ -27,6 +27,77 @@
  * gst-launch-1.0 -v videotestsrc  !  neovideoconv  !  video/x-raw,width=1920,height=1440,framerate=30/1 ! videoconvert ! autovideosink 
  * ]|
  * Converts the colorscale video to grayscale with GRAY8 format.
+ * |[
+ * gst-launch-1.0 -v videotestsrc ! video/x-raw,format=BGRx ! neovideoconv ! video/x-raw,format=BGRx ! autovideosink
+ * ]|
+ * Keeps the BGRx format and desaturates each frame in place.
+ *
+ * QoS is enabled by default: frames that are already late for downstream
+ * are dropped before conversion, and when downstream reports a proportion
+ * above 1 only 1/proportion of the frames are converted. The drops are
+ * counted in the stats property.
+ * |[
+ * gst-launch-1.0 -v ... ! video/x-raw,format=BGRx ! neovideoconv roi=true ! video/x-raw,format=BGRx ! ...
+ * ]|
+ * Desaturates only the rectangles of the GstVideoRegionOfInterestMeta on
+ * each buffer, typically attached by a detector upstream. Planar YUV whose
+ * Y plane can be shared as GRAY8 is still passed on whole, as that costs
+ * nothing.
+ * |[
+ * gst-launch-1.0 -v rtspsrc location=... ! decodebin ! videoconvert ! video/x-raw,format=BGRx ! neovideoconv incremental=true ! video/x-raw,format=GRAY8 ! ...
+ * ]|
+ * Converts only the 64x64 tiles that changed since the previous frame and
+ * copies the rest from the previous output, which suits mostly static
+ * scenes. The stats property reports the share of converted tiles.
+ * Changes are detected with a 64-bit fingerprint of each tile and nothing
+ * else, the input of the previous frame isn't kept around to compare. In
+ * the unlikely case of two different tiles with the same fingerprint the
+ * output of that tile stays stale until it changes again.
+ * |[
+ * gst-launch-1.0 -v videotestsrc ! video/x-raw,width=1920,height=1080 ! neovideoconv scale-method=box ! video/x-raw,format=GRAY8,width=480,height=270 ! fakesink
+ * ]|
+ * Downscales while converting to GRAY8, reading every input pixel once,
+ * instead of converting at full size and scaling afterwards.
+ * |[
+ * gst-launch-1.0 -v videotestsrc ! video/x-raw,format=BGRx ! neovideoconv ! video/x-raw,format=I420 ! x264enc ! mp4mux ! filesink location=gray.mp4
+ * ]|
+ * Writes the luma straight into the Y plane of I420 (or NV12) with neutral
+ * chroma, so an encoder can take grayscale without a videoconvert. I420 or
+ * NV12 input going to the same format just has its chroma planes reset.
+ * GRAY16_LE output keeps 8 fractional bits of the weighted sum.
+ *
+ * Frames larger than the last level cache, typically 4K and up, are read
+ * with prefetches and written with non-temporal stores so that they don't
+ * evict the data of other elements; stream-threshold moves that limit.
+ * |[
+ * gst-launch-1.0 -v v4l2src ! videoconvert ! neovideoconv analyze=true ! video/x-raw,format=GRAY8 ! ...
+ * ]|
+ * Attaches a GstNeovideoconvAnalysisMeta custom meta to every output
+ * buffer with the luma histogram, mean, variance, min and max, gathered
+ * while each row is still in the cache, e.g. for auto exposure downstream.
+ * The structure of the meta is read with gst_buffer_get_custom_meta() and
+ * gst_custom_meta_get_structure().
+ *
+ * Input buffers with padded strides, plane offsets or a larger coded size
+ * described by GstVideoMeta, and GstVideoCropMeta, are read in place: only
+ * the visible area is converted and the output carries no crop.
+ * |[
+ * gst-launch-1.0 -v uridecodebin uri=... ! videoconvert ! video/x-raw,format=BGRx,width=320,height=240 ! neovideoconv async-depth=4 n-threads=4 ! video/x-raw,format=GRAY8 ! ...
+ * ]|
+ * Hands whole frames to the n-threads workers instead of slicing each one,
+ * for small frames where slices cost more than they save. Up to
+ * async-depth frames are converted or wait to be pushed at a time, in
+ * their original order, which adds async-depth - 1 frame durations to the
+ * latency reported upstream. The incremental mode is not available then.
+ * |[
+ * gst-launch-1.0 -v v4l2src ! videoconvert ! video/x-raw,format=BGRx ! neovideoconv memfd=true ! video/x-raw,format=GRAY8 ! unixfdsink socket-path=/tmp/gray
+ * ]|
+ * Allocates the output from sealed memfds wrapped as GstFdMemory, so that
+ * consumers that pass fds along, such as unixfdsink or an application
+ * sending them over a Unix socket with SCM_RIGHTS, share the frames with
+ * other processes without copying them. This needs nothing but Linux, no
+ * GPU or DMA heap. Frames converted in place stay in the input buffers,
+ * and shmsink still copies into its own segment.
  * </refsect2>
  */
 
@@ -40,10 +111,16 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+
 #include <gst/gst.h>
 #include <gst/video/video.h>
 #include <gst/video/gstvideofilter.h>
 #include "gstneovideoconv.h"
+#include "gstneomemfdallocator.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_neovideoconv_debug_category);
 #define GST_CAT_DEFAULT gst_neovideoconv_debug_category
@@ -69,18 +146,149 @@ static GstFlowReturn gst_neovideoconv_transform_frame_ip (GstVideoFilter *
     filter, GstVideoFrame * frame);
 static GstCaps *gst_neovideoconv_transform_caps (GstBaseTransform * trans,
     GstPadDirection direction, GstCaps * caps, GstCaps * filter);
+static GstCaps *gst_neovideoconv_fixate_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * othercaps);
+static gboolean gst_neovideoconv_transform_meta (GstBaseTransform * trans,
+    GstBuffer * outbuf, GstMeta * meta, GstBuffer * inbuf);
+static gboolean gst_neovideoconv_propose_allocation (GstBaseTransform * trans,
+    GstQuery * decide_query, GstQuery * query);
+static gboolean gst_neovideoconv_decide_allocation (GstBaseTransform * trans,
+    GstQuery * query);
+static GstFlowReturn gst_neovideoconv_prepare_output_buffer (GstBaseTransform *
+    trans, GstBuffer * inbuf, GstBuffer ** outbuf);
+static GstFlowReturn gst_neovideoconv_transform (GstBaseTransform * trans,
+    GstBuffer * inbuf, GstBuffer * outbuf);
+static GstFlowReturn gst_neovideoconv_transform_ip (GstBaseTransform * trans,
+    GstBuffer * buf);
+static gboolean gst_neovideoconv_src_event (GstBaseTransform * trans,
+    GstEvent * event);
+static gboolean gst_neovideoconv_sink_event (GstBaseTransform * trans,
+    GstEvent * event);
+static GstFlowReturn gst_neovideoconv_submit_input_buffer (GstBaseTransform *
+    trans, gboolean is_discont, GstBuffer * input);
+static GstFlowReturn gst_neovideoconv_generate_output (GstBaseTransform *
+    trans, GstBuffer ** outbuf);
+static gboolean gst_neovideoconv_query (GstBaseTransform * trans,
+    GstPadDirection direction, GstQuery * query);
+static void gst_neovideoconv_slice_func (gpointer data, gpointer user_data);
+static void gst_neovideoconv_frame_func (gpointer data, gpointer user_data);
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_N_THREADS,
+  PROP_METHOD,
+  PROP_STATS,
+  PROP_STATS_INTERVAL,
+  PROP_ROI,
+  PROP_INCREMENTAL,
+  PROP_SCALE_METHOD,
+  PROP_STREAM_THRESHOLD,
+  PROP_ANALYZE,
+  PROP_ASYNC_DEPTH,
+  PROP_MEMFD
 };
 
+#define DEFAULT_N_THREADS 1
+/* one slice each, allocated in start */
+#define MAX_N_THREADS 1024
+#define DEFAULT_METHOD NEO_LUMA_BT601
+#define DEFAULT_STATS_INTERVAL 0
+#define DEFAULT_ROI FALSE
+#define DEFAULT_INCREMENTAL FALSE
+#define DEFAULT_SCALE_METHOD GST_NEOVIDEOCONV_SCALE_BOX
+#define DEFAULT_STREAM_THRESHOLD -1
+#define DEFAULT_ANALYZE FALSE
+#define DEFAULT_ASYNC_DEPTH 0
+/* frames held back at most, allocated in start */
+#define MAX_ASYNC_DEPTH 64
+#define DEFAULT_MEMFD FALSE
+
+/* assumed last level cache size when the system doesn't tell */
+#define FALLBACK_CACHE_SIZE (8 * 1024 * 1024)
+/* below this many rows per slice the hand-off costs more than it saves */
+#define MIN_SLICE_ROWS 32
+/* width and height of the tiles of the incremental mode */
+#define TILE_SIZE 64
+/* buffer start and, where GstVideoMeta allows it, row stride alignment */
+#define BUFFER_ALIGN 64
+
+/* marks buffers this element already got from its output pool once */
+static GQuark pool_seen_quark;
+static const gchar *analysis_meta_tags[] = { NULL };
+
 /* pad templates */
 
+/* packed layouts converted directly, each by its own kernel */
+#define PACKED_RGB_FORMATS \
+    "RGB, BGR, RGBx, BGRx, xRGB, xBGR, RGBA, BGRA, ARGB, ABGR"
+
+/* planar YUV, where GRAY8 is just the Y plane */
+#define PLANAR_YUV_FORMATS "I420, NV12, Y444"
+
+/* luma only, as GRAY8/GRAY16 or in the Y plane with neutral chroma */
+#define LUMA_FORMATS "GRAY8, GRAY16_LE, I420, NV12"
+
 #define VIDEO_SRC_CAPS \
-    GST_VIDEO_CAPS_MAKE("{ GRAY8, RGB }")
+    GST_VIDEO_CAPS_MAKE("{ " LUMA_FORMATS ", " PACKED_RGB_FORMATS " }")
 #define VIDEO_SINK_CAPS \
-    GST_VIDEO_CAPS_MAKE("RGB")
+    GST_VIDEO_CAPS_MAKE("{ " PACKED_RGB_FORMATS ", " PLANAR_YUV_FORMATS " }")
+
+static const GstVideoFormat packed_rgb_formats[] = {
+  GST_VIDEO_FORMAT_RGB, GST_VIDEO_FORMAT_BGR,
+  GST_VIDEO_FORMAT_RGBx, GST_VIDEO_FORMAT_BGRx,
+  GST_VIDEO_FORMAT_xRGB, GST_VIDEO_FORMAT_xBGR,
+  GST_VIDEO_FORMAT_RGBA, GST_VIDEO_FORMAT_BGRA,
+  GST_VIDEO_FORMAT_ARGB, GST_VIDEO_FORMAT_ABGR,
+};
+
+static const GstVideoFormat planar_yuv_formats[] = {
+  GST_VIDEO_FORMAT_I420, GST_VIDEO_FORMAT_NV12, GST_VIDEO_FORMAT_Y444,
+};
+
+#define GST_TYPE_NEOVIDEOCONV_METHOD (gst_neovideoconv_method_get_type ())
+static GType
+gst_neovideoconv_method_get_type (void)
+{
+  static gsize method_type = 0;
+  static const GEnumValue methods[] = {
+    {NEO_LUMA_BT601, "ITU-R BT.601 luma weights", "bt601"},
+    {NEO_LUMA_BT709, "ITU-R BT.709 luma weights", "bt709"},
+    {NEO_LUMA_BT2020, "ITU-R BT.2020 luma weights", "bt2020"},
+    {NEO_LUMA_AVERAGE, "Average of R, G and B", "average"},
+    {NEO_LUMA_LIGHTNESS, "Average of the smallest and largest component",
+        "lightness"},
+    {0, NULL, NULL},
+  };
+
+  if (g_once_init_enter (&method_type)) {
+    GType type = g_enum_register_static ("GstNeovideoconvMethod", methods);
+
+    g_once_init_leave (&method_type, type);
+  }
+  return method_type;
+}
+
+#define GST_TYPE_NEOVIDEOCONV_SCALE_METHOD \
+    (gst_neovideoconv_scale_method_get_type ())
+static GType
+gst_neovideoconv_scale_method_get_type (void)
+{
+  static gsize scale_method_type = 0;
+  static const GEnumValue scale_methods[] = {
+    {GST_NEOVIDEOCONV_SCALE_BOX, "Average of the covered input pixels", "box"},
+    {GST_NEOVIDEOCONV_SCALE_BILINEAR, "Bilinear interpolation", "bilinear"},
+    {0, NULL, NULL},
+  };
+
+  if (g_once_init_enter (&scale_method_type)) {
+    GType type = g_enum_register_static ("GstNeovideoconvScaleMethod",
+        scale_methods);
+
+    g_once_init_leave (&scale_method_type, type);
+  }
+  return scale_method_type;
+}
 
 /* class initialization */
 
@@ -119,18 +327,340 @@ gst_neovideoconv_class_init (GstNeovideoconvClass * klass)
   base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_neovideoconv_stop);
   base_transform_class->transform_caps =
       GST_DEBUG_FUNCPTR (gst_neovideoconv_transform_caps);
+  base_transform_class->fixate_caps =
+      GST_DEBUG_FUNCPTR (gst_neovideoconv_fixate_caps);
+  base_transform_class->transform_meta =
+      GST_DEBUG_FUNCPTR (gst_neovideoconv_transform_meta);
   base_transform_class->transform_ip_on_passthrough = FALSE;
+  base_transform_class->propose_allocation =
+      GST_DEBUG_FUNCPTR (gst_neovideoconv_propose_allocation);
+  base_transform_class->decide_allocation =
+      GST_DEBUG_FUNCPTR (gst_neovideoconv_decide_allocation);
+  base_transform_class->prepare_output_buffer =
+      GST_DEBUG_FUNCPTR (gst_neovideoconv_prepare_output_buffer);
+  base_transform_class->transform =
+      GST_DEBUG_FUNCPTR (gst_neovideoconv_transform);
+  base_transform_class->transform_ip =
+      GST_DEBUG_FUNCPTR (gst_neovideoconv_transform_ip);
+  base_transform_class->src_event =
+      GST_DEBUG_FUNCPTR (gst_neovideoconv_src_event);
+  base_transform_class->sink_event =
+      GST_DEBUG_FUNCPTR (gst_neovideoconv_sink_event);
+  base_transform_class->submit_input_buffer =
+      GST_DEBUG_FUNCPTR (gst_neovideoconv_submit_input_buffer);
+  base_transform_class->generate_output =
+      GST_DEBUG_FUNCPTR (gst_neovideoconv_generate_output);
+  base_transform_class->query = GST_DEBUG_FUNCPTR (gst_neovideoconv_query);
   video_filter_class->set_info = GST_DEBUG_FUNCPTR (gst_neovideoconv_set_info);
   video_filter_class->transform_frame =
       GST_DEBUG_FUNCPTR (gst_neovideoconv_transform_frame);
   video_filter_class->transform_frame_ip =
       GST_DEBUG_FUNCPTR (gst_neovideoconv_transform_frame_ip);
 
+  g_object_class_install_property (gobject_class,
+      PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of threads converting horizontal slices of each frame, or "
+          "whole frames with async-depth (0 = number of processors)",
+          0, MAX_N_THREADS, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class,
+      PROP_METHOD,
+      g_param_spec_enum ("method", "Method",
+          "How the luma of a pixel is computed",
+          GST_TYPE_NEOVIDEOCONV_METHOD, DEFAULT_METHOD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * GstNeovideoconv:stats:
+   *
+   * Statistics since the element was started, in an
+   * "application/x-neovideoconv-stats" structure:
+   *
+   * - "frames-processed" and "frames-dropped" (guint64)
+   * - "min-time", "avg-time", "max-time" and "p99-time" (guint64): time
+   *   spent converting a frame in ns. "p99-time" comes from a histogram
+   *   and is an upper bound within about 6%.
+   * - "bytes-in" and "bytes-out" (guint64)
+   * - "tiles-total" and "tiles-dirty" (guint64): tiles seen and converted
+   *   by the incremental mode, and "dirty-tile-ratio" (gdouble) of the two
+   * - "kernel" (string): the row functions in use
+   * - "n-threads" (guint): threads converting each frame
+   * - "pool-queue-depth" and "pool-max-queue-depth" (guint): tasks of all
+   *   elements waiting for the worker threads shared by the plugin, now
+   *   and at most, and "pool-utilization" (gdouble): the share of the time
+   *   of those threads spent running tasks
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Frame, byte and processing time statistics",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_STATS_INTERVAL,
+      g_param_spec_uint ("stats-interval", "Statistics interval",
+          "Interval in ms between element messages carrying the stats "
+          "(0 = disabled)",
+          0, G_MAXUINT, DEFAULT_STATS_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class,
+      PROP_ROI,
+      g_param_spec_boolean ("roi", "Regions of interest",
+          "Only convert the regions given by GstVideoRegionOfInterestMeta "
+          "on each buffer. In place the rest of the frame is left untouched, "
+          "luma output is black outside the regions",
+          DEFAULT_ROI, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class,
+      PROP_INCREMENTAL,
+      g_param_spec_boolean ("incremental", "Incremental",
+          "Only convert the tiles of packed RGB input that changed since the "
+          "previous frame, copying the others from the previous output. "
+          "Tiles are compared by a 64-bit fingerprint only, a collision "
+          "keeps a stale tile until it changes again",
+          DEFAULT_INCREMENTAL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class,
+      PROP_SCALE_METHOD,
+      g_param_spec_enum ("scale-method", "Scale method",
+          "How 8-bit luma output smaller than the input is filtered",
+          GST_TYPE_NEOVIDEOCONV_SCALE_METHOD, DEFAULT_SCALE_METHOD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class,
+      PROP_STREAM_THRESHOLD,
+      g_param_spec_int64 ("stream-threshold", "Stream threshold",
+          "Input plus output frame size in bytes from which packed RGB is "
+          "converted with prefetching and non-temporal stores that bypass "
+          "the cache (-1 = size of the last level cache)",
+          -1, G_MAXINT64, DEFAULT_STREAM_THRESHOLD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class,
+      PROP_ANALYZE,
+      g_param_spec_boolean ("analyze", "Analyze",
+          "Attach the luma histogram, mean, variance, min and max of each "
+          "frame as a " GST_NEOVIDEOCONV_ANALYSIS_META_NAME " custom meta, "
+          "collected while converting",
+          DEFAULT_ANALYZE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class,
+      PROP_ASYNC_DEPTH,
+      g_param_spec_uint ("async-depth", "Asynchronous depth",
+          "Number of frames handed to the n-threads worker threads and held "
+          "back to be pushed in order, adding async-depth - 1 frames of "
+          "latency (0 = convert each frame on the streaming thread)",
+          0, MAX_ASYNC_DEPTH, DEFAULT_ASYNC_DEPTH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class,
+      PROP_MEMFD,
+      g_param_spec_boolean ("memfd", "memfd",
+          "Allocate output buffers as fd memory backed by sealed memfds, "
+          "whose fds downstream can pass to other processes",
+          DEFAULT_MEMFD, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /* no tags: the analysis stays valid through any later transformation
+   * that keeps the pixels */
+  gst_meta_register_custom (GST_NEOVIDEOCONV_ANALYSIS_META_NAME,
+      analysis_meta_tags, NULL, NULL, NULL);
+
+  pool_seen_quark = g_quark_from_static_string ("neovideoconv-pool-seen");
 }
 
 static void
 gst_neovideoconv_init (GstNeovideoconv * neovideoconv)
 {
+  neovideoconv->kernels = neo_kernels_get_default ();
+  neovideoconv->n_threads = DEFAULT_N_THREADS;
+  neovideoconv->method = DEFAULT_METHOD;
+  neovideoconv->stats_interval = DEFAULT_STATS_INTERVAL;
+  neovideoconv->roi = DEFAULT_ROI;
+  neovideoconv->incremental = DEFAULT_INCREMENTAL;
+  neovideoconv->scale_method = DEFAULT_SCALE_METHOD;
+  neovideoconv->stream_threshold = DEFAULT_STREAM_THRESHOLD;
+  neovideoconv->analyze = DEFAULT_ANALYZE;
+  neovideoconv->async_depth = DEFAULT_ASYNC_DEPTH;
+  neovideoconv->memfd = DEFAULT_MEMFD;
+  neovideoconv->regions = g_array_new (FALSE, FALSE,
+      sizeof (GstNeovideoconvRegion));
+  neovideoconv->stats.time_min = G_MAXUINT64;
+  neovideoconv->qos_proportion = 1.0;
+  neovideoconv->qos_earliest_time = GST_CLOCK_TIME_NONE;
+  gst_base_transform_set_qos_enabled (GST_BASE_TRANSFORM (neovideoconv), TRUE);
+  g_mutex_init (&neovideoconv->slice_lock);
+  g_cond_init (&neovideoconv->slice_cond);
+  g_mutex_init (&neovideoconv->frame_lock);
+  g_cond_init (&neovideoconv->frame_cond);
+  GST_INFO_OBJECT (neovideoconv, "using %s kernels",
+      neovideoconv->kernels->name);
+}
+
+/* The stats are written by the streaming thread and slice workers and read
+ * by any thread through the stats property, without a lock on either side.
+ * The fields of one snapshot may come from different frames. */
+#define STAT_GET(field) __atomic_load_n (&(field), __ATOMIC_RELAXED)
+#define STAT_SET(field, v) __atomic_store_n (&(field), (v), __ATOMIC_RELAXED)
+#define STAT_ADD(field, v) __atomic_fetch_add (&(field), (v), __ATOMIC_RELAXED)
+
+static void
+gst_neovideoconv_stats_reset (GstNeovideoconvStats * stats)
+{
+  guint i;
+
+  STAT_SET (stats->frames_processed, 0);
+  STAT_SET (stats->frames_dropped, 0);
+  STAT_SET (stats->bytes_in, 0);
+  STAT_SET (stats->bytes_out, 0);
+  STAT_SET (stats->time_total, 0);
+  STAT_SET (stats->time_min, G_MAXUINT64);
+  STAT_SET (stats->time_max, 0);
+  STAT_SET (stats->tiles_total, 0);
+  STAT_SET (stats->tiles_dirty, 0);
+  for (i = 0; i < GST_NEOVIDEOCONV_TIME_BUCKETS; i++)
+    STAT_SET (stats->time_hist[i], 0);
+}
+
+/* Histogram bucket of @time: values below 16 ns get their own bucket,
+ * above that each power of two is split into 16 */
+static guint
+gst_neovideoconv_time_bucket (guint64 time)
+{
+  guint msb;
+
+  if (time < (1 << GST_NEOVIDEOCONV_TIME_SUB_BITS))
+    return time;
+  if (time >> GST_NEOVIDEOCONV_TIME_MAX_BITS)
+    return GST_NEOVIDEOCONV_TIME_BUCKETS - 1;
+
+  msb = 63 - __builtin_clzll (time);
+  return ((msb - GST_NEOVIDEOCONV_TIME_SUB_BITS + 1) <<
+      GST_NEOVIDEOCONV_TIME_SUB_BITS) |
+      ((time >> (msb - GST_NEOVIDEOCONV_TIME_SUB_BITS)) &
+      ((1 << GST_NEOVIDEOCONV_TIME_SUB_BITS) - 1));
+}
+
+/* the largest time falling into @bucket */
+static guint64
+gst_neovideoconv_time_bucket_max (guint bucket)
+{
+  guint group = bucket >> GST_NEOVIDEOCONV_TIME_SUB_BITS;
+  guint64 sub = bucket & ((1 << GST_NEOVIDEOCONV_TIME_SUB_BITS) - 1);
+  guint shift;
+
+  if (group == 0)
+    return bucket;
+
+  shift = group - 1;
+  return (((1 << GST_NEOVIDEOCONV_TIME_SUB_BITS) + sub + 1) << shift) - 1;
+}
+
+static void
+gst_neovideoconv_post_stats (GstNeovideoconv * neovideoconv);
+
+/* Accounts one converted frame, @time is the time spent on it in ns */
+static void
+gst_neovideoconv_record_frame (GstNeovideoconv * neovideoconv,
+    GstClockTime time, gsize bytes_in, gsize bytes_out)
+{
+  GstNeovideoconvStats *stats = &neovideoconv->stats;
+  guint64 old;
+  guint interval;
+
+  STAT_ADD (stats->frames_processed, 1);
+  STAT_ADD (stats->bytes_in, bytes_in);
+  STAT_ADD (stats->bytes_out, bytes_out);
+  STAT_ADD (stats->time_total, time);
+  STAT_ADD (stats->time_hist[gst_neovideoconv_time_bucket (time)], 1);
+
+  old = STAT_GET (stats->time_min);
+  while (time < old && !__atomic_compare_exchange_n (&stats->time_min, &old,
+          time, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  old = STAT_GET (stats->time_max);
+  while (time > old && !__atomic_compare_exchange_n (&stats->time_max, &old,
+          time, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+  interval = g_atomic_int_get (&neovideoconv->stats_interval);
+  if (interval > 0) {
+    GstClockTime now = gst_util_get_timestamp ();
+
+    if (!GST_CLOCK_TIME_IS_VALID (neovideoconv->last_stats_post)
+        || now - neovideoconv->last_stats_post >= interval * GST_MSECOND) {
+      neovideoconv->last_stats_post = now;
+      gst_neovideoconv_post_stats (neovideoconv);
+    }
+  }
+}
+
+static GstStructure *
+gst_neovideoconv_get_stats (GstNeovideoconv * neovideoconv)
+{
+  GstNeovideoconvStats *stats = &neovideoconv->stats;
+  const gchar *kernel = g_atomic_pointer_get (&neovideoconv->active_kernel);
+  guint64 frames, time_min, p99 = 0, seen = 0, total = 0;
+  guint64 tiles_total, tiles_dirty;
+  NeoTaskPoolCounters pool;
+  guint i;
+
+  neo_task_pool_get_counters (&pool);
+  frames = STAT_GET (stats->frames_processed);
+  time_min = STAT_GET (stats->time_min);
+  tiles_total = STAT_GET (stats->tiles_total);
+  tiles_dirty = STAT_GET (stats->tiles_dirty);
+
+  /* p99 is the first bucket covering 99% of the histogram */
+  for (i = 0; i < GST_NEOVIDEOCONV_TIME_BUCKETS; i++)
+    total += STAT_GET (stats->time_hist[i]);
+  for (i = 0; i < GST_NEOVIDEOCONV_TIME_BUCKETS && total > 0; i++) {
+    seen += STAT_GET (stats->time_hist[i]);
+    if (seen * 100 >= total * 99) {
+      p99 = gst_neovideoconv_time_bucket_max (i);
+      break;
+    }
+  }
+
+  return gst_structure_new ("application/x-neovideoconv-stats",
+      "frames-processed", G_TYPE_UINT64, frames,
+      "frames-dropped", G_TYPE_UINT64, STAT_GET (stats->frames_dropped),
+      "min-time", G_TYPE_UINT64, frames > 0 ? time_min : 0,
+      "avg-time", G_TYPE_UINT64,
+      frames > 0 ? STAT_GET (stats->time_total) / frames : 0,
+      "max-time", G_TYPE_UINT64, STAT_GET (stats->time_max),
+      "p99-time", G_TYPE_UINT64, p99,
+      "bytes-in", G_TYPE_UINT64, STAT_GET (stats->bytes_in),
+      "bytes-out", G_TYPE_UINT64, STAT_GET (stats->bytes_out),
+      "tiles-total", G_TYPE_UINT64, tiles_total,
+      "tiles-dirty", G_TYPE_UINT64, tiles_dirty,
+      "dirty-tile-ratio", G_TYPE_DOUBLE,
+      tiles_total > 0 ? (gdouble) tiles_dirty / tiles_total : 0.0,
+      "kernel", G_TYPE_STRING, kernel ? kernel : "none",
+      "n-threads", G_TYPE_UINT, g_atomic_int_get (&neovideoconv->n_slices),
+      "streaming", G_TYPE_BOOLEAN,
+      g_atomic_pointer_get (&neovideoconv->to_gray8_stream) != NULL,
+      "pool-queue-depth", G_TYPE_UINT, pool.queue_depth,
+      "pool-max-queue-depth", G_TYPE_UINT, pool.max_queue_depth,
+      "pool-utilization", G_TYPE_DOUBLE, pool.utilization, NULL);
+}
+
+static void
+gst_neovideoconv_post_stats (GstNeovideoconv * neovideoconv)
+{
+  gst_element_post_message (GST_ELEMENT (neovideoconv),
+      gst_message_new_element (GST_OBJECT (neovideoconv),
+          gst_neovideoconv_get_stats (neovideoconv)));
 }
 
 void
@@ -142,6 +672,55 @@ gst_neovideoconv_set_property (GObject * object, guint property_id,
   GST_DEBUG_OBJECT (neovideoconv, "set_property");
 
   switch (property_id) {
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (neovideoconv);
+      neovideoconv->n_threads = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
+    case PROP_METHOD:
+      GST_OBJECT_LOCK (neovideoconv);
+      neovideoconv->method = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
+    case PROP_STATS_INTERVAL:
+      g_atomic_int_set (&neovideoconv->stats_interval,
+          g_value_get_uint (value));
+      break;
+    case PROP_ROI:
+      GST_OBJECT_LOCK (neovideoconv);
+      neovideoconv->roi = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
+    case PROP_INCREMENTAL:
+      GST_OBJECT_LOCK (neovideoconv);
+      neovideoconv->incremental = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
+    case PROP_SCALE_METHOD:
+      GST_OBJECT_LOCK (neovideoconv);
+      neovideoconv->scale_method = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
+    case PROP_STREAM_THRESHOLD:
+      GST_OBJECT_LOCK (neovideoconv);
+      neovideoconv->stream_threshold = g_value_get_int64 (value);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
+    case PROP_ANALYZE:
+      GST_OBJECT_LOCK (neovideoconv);
+      neovideoconv->analyze = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
+    case PROP_ASYNC_DEPTH:
+      GST_OBJECT_LOCK (neovideoconv);
+      neovideoconv->async_depth = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
+    case PROP_MEMFD:
+      GST_OBJECT_LOCK (neovideoconv);
+      neovideoconv->memfd = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -157,6 +736,57 @@ gst_neovideoconv_get_property (GObject * object, guint property_id,
   GST_DEBUG_OBJECT (neovideoconv, "get_property");
 
   switch (property_id) {
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (neovideoconv);
+      g_value_set_uint (value, neovideoconv->n_threads);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
+    case PROP_METHOD:
+      GST_OBJECT_LOCK (neovideoconv);
+      g_value_set_enum (value, neovideoconv->method);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_neovideoconv_get_stats (neovideoconv));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, g_atomic_int_get (&neovideoconv->stats_interval));
+      break;
+    case PROP_ROI:
+      GST_OBJECT_LOCK (neovideoconv);
+      g_value_set_boolean (value, neovideoconv->roi);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
+    case PROP_INCREMENTAL:
+      GST_OBJECT_LOCK (neovideoconv);
+      g_value_set_boolean (value, neovideoconv->incremental);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
+    case PROP_SCALE_METHOD:
+      GST_OBJECT_LOCK (neovideoconv);
+      g_value_set_enum (value, neovideoconv->scale_method);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
+    case PROP_STREAM_THRESHOLD:
+      GST_OBJECT_LOCK (neovideoconv);
+      g_value_set_int64 (value, neovideoconv->stream_threshold);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
+    case PROP_ANALYZE:
+      GST_OBJECT_LOCK (neovideoconv);
+      g_value_set_boolean (value, neovideoconv->analyze);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
+    case PROP_ASYNC_DEPTH:
+      GST_OBJECT_LOCK (neovideoconv);
+      g_value_set_uint (value, neovideoconv->async_depth);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
+    case PROP_MEMFD:
+      GST_OBJECT_LOCK (neovideoconv);
+      g_value_set_boolean (value, neovideoconv->memfd);
+      GST_OBJECT_UNLOCK (neovideoconv);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -183,17 +813,198 @@ gst_neovideoconv_finalize (GObject * object)
   GST_DEBUG_OBJECT (neovideoconv, "finalize");
 
   /* clean up object here */
+  g_mutex_clear (&neovideoconv->slice_lock);
+  g_cond_clear (&neovideoconv->slice_cond);
+  g_mutex_clear (&neovideoconv->frame_lock);
+  g_cond_clear (&neovideoconv->frame_cond);
+  g_array_unref (neovideoconv->regions);
+  g_free (neovideoconv->tile_fingerprints);
+  g_free (neovideoconv->scale_xmap);
+  g_free (neovideoconv->scale_xcount);
+  g_free (neovideoconv->scale_xfrac);
 
   G_OBJECT_CLASS (gst_neovideoconv_parent_class)->finalize (object);
 }
 
+static void
+gst_neovideoconv_reset_qos (GstNeovideoconv * neovideoconv)
+{
+  GST_OBJECT_LOCK (neovideoconv);
+  neovideoconv->qos_proportion = 1.0;
+  neovideoconv->qos_earliest_time = GST_CLOCK_TIME_NONE;
+  GST_OBJECT_UNLOCK (neovideoconv);
+  neovideoconv->qos_credit = 0.0;
+}
+
+/* Appends a frame for @outbuf to the queue of the asynchronous mode,
+ * handing it to a worker when @inbuf is to be converted into it, or
+ * converted in place when @inbuf is NULL and @convert is TRUE. There is
+ * always room for it, see generate_output. */
+static void
+gst_neovideoconv_queue_frame (GstNeovideoconv * neovideoconv,
+    GstBuffer * inbuf, GstBuffer * outbuf, gboolean convert)
+{
+  GstNeovideoconvFrame *frame;
+
+  g_mutex_lock (&neovideoconv->frame_lock);
+  g_assert (neovideoconv->frames_queued < neovideoconv->frames_max);
+  frame = &neovideoconv->frames[(neovideoconv->frames_head +
+          neovideoconv->frames_queued) % neovideoconv->frames_max];
+  frame->inbuf = inbuf;
+  frame->outbuf = outbuf;
+  frame->converting = convert;
+  frame->failed = FALSE;
+  frame->done = !convert;
+  neovideoconv->frames_queued++;
+  g_mutex_unlock (&neovideoconv->frame_lock);
+
+  if (convert)
+    neo_task_queue_push (neovideoconv->workers, frame);
+}
+
+/* Takes the oldest frame out of the queue into @outbuf once it is
+ * converted. Waits for it if @wait is set or the queue is full, otherwise
+ * leaves @outbuf NULL while it is still being converted. Frames that
+ * failed to convert are dropped on the way. */
+static void
+gst_neovideoconv_pop_frame (GstNeovideoconv * neovideoconv, gboolean wait,
+    GstBuffer ** outbuf)
+{
+  GstNeovideoconvFrame *frame;
+
+  *outbuf = NULL;
+
+  for (;;) {
+    g_mutex_lock (&neovideoconv->frame_lock);
+    if (neovideoconv->frames_queued == 0) {
+      g_mutex_unlock (&neovideoconv->frame_lock);
+      return;
+    }
+    frame = &neovideoconv->frames[neovideoconv->frames_head];
+    while (!frame->done && (wait
+            || neovideoconv->frames_queued == neovideoconv->frames_max))
+      g_cond_wait (&neovideoconv->frame_cond, &neovideoconv->frame_lock);
+    if (!frame->done) {
+      g_mutex_unlock (&neovideoconv->frame_lock);
+      return;
+    }
+    neovideoconv->frames_head =
+        (neovideoconv->frames_head + 1) % neovideoconv->frames_max;
+    neovideoconv->frames_queued--;
+    g_mutex_unlock (&neovideoconv->frame_lock);
+
+    if (!frame->failed)
+      break;
+    /* never converted, convert_frame already warned */
+    GST_DEBUG_OBJECT (neovideoconv, "dropping unconverted frame");
+    gst_clear_buffer (&frame->outbuf);
+  }
+
+  /* only the streaming thread reuses the slot, and not before we return */
+  *outbuf = frame->outbuf;
+  frame->outbuf = NULL;
+  if (frame->converting)
+    gst_neovideoconv_record_frame (neovideoconv, frame->time,
+        frame->bytes_in, frame->bytes_out);
+}
+
+/* Pushes every queued frame in order, or drops them when @push is FALSE,
+ * before anything that must not overtake them */
+static GstFlowReturn
+gst_neovideoconv_drain_frames (GstNeovideoconv * neovideoconv, gboolean push)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBuffer *buf;
+
+  for (;;) {
+    gst_neovideoconv_pop_frame (neovideoconv, TRUE, &buf);
+    if (!buf)
+      break;
+    if (push && ret == GST_FLOW_OK)
+      ret = gst_pad_push (GST_BASE_TRANSFORM_SRC_PAD (neovideoconv), buf);
+    else
+      gst_buffer_unref (buf);
+  }
+
+  return ret;
+}
+
 static gboolean
 gst_neovideoconv_start (GstBaseTransform * trans)
 {
   GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (trans);
+  guint n_threads, async_depth, i;
+  gboolean memfd;
+  GError *err = NULL;
 
   GST_DEBUG_OBJECT (neovideoconv, "start");
 
+  neovideoconv->pool_hits = 0;
+  neovideoconv->pool_misses = 0;
+  gst_neovideoconv_stats_reset (&neovideoconv->stats);
+  neovideoconv->last_stats_post = GST_CLOCK_TIME_NONE;
+  gst_neovideoconv_reset_qos (neovideoconv);
+
+  GST_OBJECT_LOCK (neovideoconv);
+  n_threads = neovideoconv->n_threads;
+  neovideoconv->convert_regions = neovideoconv->roi;
+  neovideoconv->convert_incremental = neovideoconv->incremental;
+  neovideoconv->analyzing = neovideoconv->analyze;
+  async_depth = neovideoconv->async_depth;
+  memfd = neovideoconv->memfd;
+  GST_OBJECT_UNLOCK (neovideoconv);
+
+  if (memfd) {
+    neovideoconv->memfd_allocator = gst_neo_memfd_allocator_new ();
+    if (!neovideoconv->memfd_allocator)
+      GST_WARNING_OBJECT (neovideoconv, "memfd is not supported on this "
+          "system, allocating output as usual");
+  }
+
+  if (n_threads == 0)
+    n_threads = g_get_num_processors ();
+
+  /* frames converted out of order can't be compared with the previous one */
+  if (async_depth > 0 && neovideoconv->convert_incremental) {
+    GST_WARNING_OBJECT (neovideoconv, "incremental mode is not available "
+        "with async-depth, converting whole frames");
+    neovideoconv->convert_incremental = FALSE;
+  }
+
+  if (async_depth > 0) {
+    neovideoconv->workers = neo_task_queue_new (gst_neovideoconv_frame_func,
+        neovideoconv, n_threads, &err);
+    if (!neovideoconv->workers) {
+      GST_ELEMENT_ERROR (neovideoconv, RESOURCE, FAILED,
+          ("Could not create frame worker threads"), ("%s", err->message));
+      g_clear_error (&err);
+      return FALSE;
+    }
+    neovideoconv->frames = g_new0 (GstNeovideoconvFrame, async_depth);
+    for (i = 0; i < async_depth; i++)
+      neovideoconv->frames[i].regions = g_array_new (FALSE, FALSE,
+          sizeof (GstNeovideoconvRegion));
+    neovideoconv->frames_max = async_depth;
+    neovideoconv->frames_head = 0;
+    neovideoconv->frames_queued = 0;
+    GST_INFO_OBJECT (neovideoconv, "converting up to %u frames "
+        "asynchronously", async_depth);
+  } else if (n_threads > 1) {
+    /* the streaming thread converts the first slice itself */
+    neovideoconv->workers = neo_task_queue_new (gst_neovideoconv_slice_func,
+        neovideoconv, n_threads - 1, &err);
+    if (!neovideoconv->workers) {
+      GST_ELEMENT_ERROR (neovideoconv, RESOURCE, FAILED,
+          ("Could not create slice worker threads"), ("%s", err->message));
+      g_clear_error (&err);
+      return FALSE;
+    }
+  }
+
+  neovideoconv->slices = g_new0 (GstNeovideoconvSlice, n_threads);
+  g_atomic_int_set (&neovideoconv->n_slices, n_threads);
+  GST_INFO_OBJECT (neovideoconv, "converting with %u threads", n_threads);
+
   return TRUE;
 }
 
@@ -201,147 +1012,1966 @@ static gboolean
 gst_neovideoconv_stop (GstBaseTransform * trans)
 {
   GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (trans);
+  guint i;
 
   GST_DEBUG_OBJECT (neovideoconv, "stop");
 
+  GST_INFO_OBJECT (neovideoconv, "output pool hits %" G_GUINT64_FORMAT
+      ", misses %" G_GUINT64_FORMAT, neovideoconv->pool_hits,
+      neovideoconv->pool_misses);
+
+  if (neovideoconv->workers) {
+    /* waits for the tasks still queued, the threads are shared */
+    neo_task_queue_free (neovideoconv->workers);
+    neovideoconv->workers = NULL;
+  }
+  if (neovideoconv->frames) {
+    gst_neovideoconv_drain_frames (neovideoconv, FALSE);
+    for (i = 0; i < neovideoconv->frames_max; i++) {
+      g_free (neovideoconv->frames[i].slice.scale_rows);
+      g_free (neovideoconv->frames[i].slice.scale_sums);
+      g_array_unref (neovideoconv->frames[i].regions);
+    }
+    g_clear_pointer (&neovideoconv->frames, g_free);
+    neovideoconv->frames_max = 0;
+  }
+  for (i = 0; i < neovideoconv->n_slices; i++) {
+    g_free (neovideoconv->slices[i].scale_rows);
+    g_free (neovideoconv->slices[i].scale_sums);
+  }
+  g_atomic_int_set (&neovideoconv->n_slices, 0);
+  g_clear_pointer (&neovideoconv->slices, g_free);
+  g_atomic_pointer_set (&neovideoconv->active_kernel, NULL);
+  gst_clear_buffer (&neovideoconv->retained_outbuf);
+  g_clear_pointer (&neovideoconv->tile_fingerprints, g_free);
+  gst_clear_object (&neovideoconv->memfd_allocator);
+
+  /* one last message with the totals */
+  if (g_atomic_int_get (&neovideoconv->stats_interval) > 0)
+    gst_neovideoconv_post_stats (neovideoconv);
+
   return TRUE;
 }
 
+static gint
+gst_neovideoconv_layout_from_format (GstVideoFormat format)
+{
+  switch (format) {
+    case GST_VIDEO_FORMAT_RGB:
+      return NEO_LAYOUT_RGB;
+    case GST_VIDEO_FORMAT_BGR:
+      return NEO_LAYOUT_BGR;
+    case GST_VIDEO_FORMAT_RGBx:
+    case GST_VIDEO_FORMAT_RGBA:
+      return NEO_LAYOUT_RGBX;
+    case GST_VIDEO_FORMAT_BGRx:
+    case GST_VIDEO_FORMAT_BGRA:
+      return NEO_LAYOUT_BGRX;
+    case GST_VIDEO_FORMAT_xRGB:
+    case GST_VIDEO_FORMAT_ARGB:
+      return NEO_LAYOUT_XRGB;
+    case GST_VIDEO_FORMAT_xBGR:
+    case GST_VIDEO_FORMAT_ABGR:
+      return NEO_LAYOUT_XBGR;
+    default:
+      return -1;
+  }
+}
+
 static gboolean
-gst_neovideoconv_set_info (GstVideoFilter * filter, GstCaps * incaps,
-    GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
+gst_neovideoconv_is_planar_yuv (GstVideoFormat format)
 {
-  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (filter);
+  guint i;
 
-  GST_DEBUG_OBJECT(neovideoconv, "in caps : %" GST_PTR_FORMAT, incaps);
-  GST_DEBUG_OBJECT(neovideoconv, "out caps : %" GST_PTR_FORMAT, outcaps);
+  for (i = 0; i < G_N_ELEMENTS (planar_yuv_formats); i++) {
+    if (planar_yuv_formats[i] == format)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* GRAY8 from planar YUV is a plain copy of the Y rows */
+static void
+gst_neovideoconv_copy_luma_row (guint8 * dest, const guint8 * src, gint width,
+    const NeoLuma * luma)
+{
+  memcpy (dest, src, width);
+}
+
+/* and GRAY16_LE is y * 257, both bytes equal to y */
+static void
+gst_neovideoconv_copy_luma_row16 (guint8 * dest, const guint8 * src,
+    gint width, const NeoLuma * luma)
+{
+  gint i;
+
+  for (i = 0; i < width; i++)
+    dest[2 * i] = dest[2 * i + 1] = src[i];
+}
 
-  if (GST_VIDEO_FORMAT_INFO_FORMAT(in_info->finfo) == GST_VIDEO_FORMAT_INFO_FORMAT(out_info->finfo)) {
-    //set as passthrough
-    gst_base_transform_set_passthrough (GST_BASE_TRANSFORM(filter), TRUE);
+/* Restricts @frame to the area the caps describe. gst_video_frame_map()
+ * takes the size from GstVideoMeta, which may be larger, e.g. the coded
+ * size of a decoder, with GstVideoCropMeta telling where the visible area
+ * is. Without crop meta that is the top left corner. Only the plane
+ * pointers and the size change, so the frame still unmaps as usual. */
+static void
+gst_neovideoconv_crop_frame (GstVideoFrame * frame, const GstVideoInfo * info)
+{
+  const GstVideoFormatInfo *finfo = frame->info.finfo;
+  GstVideoCropMeta *crop = gst_buffer_get_video_crop_meta (frame->buffer);
+  gint width = GST_VIDEO_INFO_WIDTH (info);
+  gint height = GST_VIDEO_INFO_HEIGHT (info);
+  gboolean moved[GST_VIDEO_MAX_PLANES] = { FALSE, };
+  gint x = 0, y = 0;
+  guint c;
+
+  if (crop) {
+    x = CLAMP ((gint) crop->x, 0, GST_VIDEO_FRAME_WIDTH (frame) - width);
+    y = CLAMP ((gint) crop->y, 0, GST_VIDEO_FRAME_HEIGHT (frame) - height);
   }
+  if (x == 0 && y == 0 && GST_VIDEO_FRAME_WIDTH (frame) == width
+      && GST_VIDEO_FRAME_HEIGHT (frame) == height)
+    return;
 
+  GST_LOG ("cropping %dx%d to %dx%d at %d,%d", GST_VIDEO_FRAME_WIDTH (frame),
+      GST_VIDEO_FRAME_HEIGHT (frame), width, height, x, y);
 
-  return TRUE;
+  /* the first component of a plane moves its start, subsampled as needed */
+  for (c = 0; c < GST_VIDEO_FRAME_N_COMPONENTS (frame); c++) {
+    guint plane = GST_VIDEO_FORMAT_INFO_PLANE (finfo, c);
+
+    if (moved[plane])
+      continue;
+    moved[plane] = TRUE;
+    frame->data[plane] = (guint8 *) frame->data[plane] +
+        (y >> GST_VIDEO_FORMAT_INFO_H_SUB (finfo, c)) *
+        GST_VIDEO_FRAME_PLANE_STRIDE (frame, plane) +
+        (x >> GST_VIDEO_FORMAT_INFO_W_SUB (finfo, c)) *
+        GST_VIDEO_FRAME_COMP_PSTRIDE (frame, c);
+  }
+  frame->info.width = width;
+  frame->info.height = height;
 }
 
-/* transform */
-static GstFlowReturn
-gst_neovideoconv_transform_frame (GstVideoFilter * filter,
-    GstVideoFrame * inframe, GstVideoFrame * outframe)
+/* Sets the chroma planes of @frame to 128, neutral grey, only within
+ * @regions unless it is NULL. Plane n starts with component n in the
+ * formats this element outputs. */
+static void
+gst_neovideoconv_fill_chroma (GstVideoFrame * frame, GArray * regions)
 {
-  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (filter);
+  const GstVideoFormatInfo *finfo = frame->info.finfo;
+  guint plane, i;
 
-  GST_INFO_OBJECT (neovideoconv, "transform_frame %p %p", inframe, outframe);
-  gint row, col;
-  gint pixel_stride, row_stride, row_wrap;
-  gint d_pixel_stride, d_row_stride, d_row_wrap;
-  guint8 r, g, b;
-  guint8 y;
-  gint s_offsets[3], d_offsets[3];
-  guint8 *src, *dest;
+  for (plane = 1; plane < GST_VIDEO_FRAME_N_PLANES (frame); plane++) {
+    guint8 *data = GST_VIDEO_FRAME_PLANE_DATA (frame, plane);
+    gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, plane);
+    gint pstride = GST_VIDEO_FRAME_COMP_PSTRIDE (frame, plane);
+    gint w_sub = GST_VIDEO_FORMAT_INFO_W_SUB (finfo, plane);
+    gint h_sub = GST_VIDEO_FORMAT_INFO_H_SUB (finfo, plane);
 
-  src = GST_VIDEO_FRAME_PLANE_DATA (inframe, 0);
-  dest = GST_VIDEO_FRAME_PLANE_DATA (outframe, 0);
-  s_offsets[GST_VIDEO_COMP_R] =
-      GST_VIDEO_FRAME_COMP_POFFSET (inframe, GST_VIDEO_COMP_R);
-  s_offsets[GST_VIDEO_COMP_G] =
-      GST_VIDEO_FRAME_COMP_POFFSET (inframe, GST_VIDEO_COMP_G);
-  s_offsets[GST_VIDEO_COMP_B] =
-      GST_VIDEO_FRAME_COMP_POFFSET (inframe, GST_VIDEO_COMP_B);
+    if (!regions) {
+      gint height = GST_VIDEO_FRAME_COMP_HEIGHT (frame, plane);
+      gint row_bytes = GST_VIDEO_FRAME_COMP_WIDTH (frame, plane) * pstride;
 
-  d_offsets[GST_VIDEO_COMP_Y] =
-      GST_VIDEO_FRAME_COMP_POFFSET (outframe, GST_VIDEO_COMP_Y);
+      /* neither the row padding nor, when cropped in place, the columns
+       * outside the crop are visible, so one memset covers the plane */
+      memset (data, 128, (gsize) stride * (height - 1) + row_bytes);
+      continue;
+    }
 
-  row_stride = GST_VIDEO_FRAME_PLANE_STRIDE (inframe, 0);
-  pixel_stride = GST_VIDEO_FRAME_COMP_PSTRIDE (inframe, 0);
-  row_wrap = row_stride - pixel_stride * inframe->info.width;
+    /* every chroma sample covering a pixel of a region, so a region on odd
+     * coordinates also neutralises its subsampled neighbours */
+    for (i = 0; i < regions->len; i++) {
+      GstNeovideoconvRegion *region =
+          &g_array_index (regions, GstNeovideoconvRegion, i);
+      gint x0 = region->x >> w_sub;
+      gint x1 = GST_VIDEO_SUB_SCALE (w_sub, region->x + region->width);
+      gint y0 = region->y >> h_sub;
+      gint y1 = GST_VIDEO_SUB_SCALE (h_sub, region->y + region->height);
+      gint y;
 
-  d_row_stride = GST_VIDEO_FRAME_PLANE_STRIDE (outframe, 0);
-  d_pixel_stride = GST_VIDEO_FRAME_COMP_PSTRIDE (outframe, 0);
-  d_row_wrap = d_row_stride - d_pixel_stride * outframe->info.width;
-
-  if (outframe->info.finfo->format == GST_VIDEO_FORMAT_GRAY8) {
-    for (int row = 0; row < inframe->info.height; row++) {
-      for (int col = 0; col < inframe->info.width; col++) {
-        r = src[s_offsets[GST_VIDEO_COMP_R]];
-        g = src[s_offsets[GST_VIDEO_COMP_G]];
-        b = src[s_offsets[GST_VIDEO_COMP_B]];
-        /*Lightness method*/
-        //y = (MIN(r, MIN(g, b)) + MAX(r, MAX(g,b)))/2;
-        /*Average method*/
-        //y = (r + g + b) / 3;
-        /*Luminosity Method*/
-        y = 0.3*r + 0.59*g + 0.11*b;
-        dest[d_offsets[GST_VIDEO_COMP_Y]] = y;
-        src += pixel_stride;
-        dest += d_pixel_stride;
-      }
+      for (y = y0; y < y1; y++)
+        memset (data + (gsize) y * stride + x0 * pstride, 128,
+            (x1 - x0) * pstride);
     }
   }
-  return GST_FLOW_OK;
 }
 
-static GstFlowReturn
-gst_neovideoconv_transform_frame_ip (GstVideoFilter * filter,
-    GstVideoFrame * inframe)
+/* Size of the last level cache, shared by all elements */
+static gint64
+gst_neovideoconv_cache_size (void)
 {
-  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (filter);
+  static gsize cache_size = 0;
 
-  GST_DEBUG_OBJECT (neovideoconv, "transform_frame_ip");
-  return GST_FLOW_OK;
+  if (g_once_init_enter (&cache_size)) {
+    glong size = -1;
+
+#if defined(_SC_LEVEL3_CACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE)
+    size = sysconf (_SC_LEVEL3_CACHE_SIZE);
+    if (size <= 0)
+      size = sysconf (_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if (size <= 0)
+      size = FALLBACK_CACHE_SIZE;
+    GST_DEBUG ("last level cache is %ld bytes", size);
+
+    g_once_init_leave (&cache_size, size);
+  }
+
+  return cache_size;
 }
 
-static GstCaps *
-gst_neovideoconv_transform_caps (GstBaseTransform * trans,
-    GstPadDirection direction, GstCaps * caps, GstCaps * filter)
+/* Source coordinate of the centre of output pixel @x in 16.16 fixed point,
+ * clamped to the first and last source pixel */
+static gint64
+gst_neovideoconv_scale_coord (gint x, gint in_size, gint out_size)
 {
+  gint64 c;
 
-  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (trans);
-  GValue v_formats = G_VALUE_INIT;
-  GST_DEBUG_OBJECT (neovideoconv, "%s", __func__);
-  GstCaps *ret_caps = NULL, *temp_caps;
-  GST_DEBUG_OBJECT (neovideoconv, "received caps %p : %" GST_PTR_FORMAT, caps,
-      caps);
-  //check the pad direction SRC or SINK
-  if (direction == GST_PAD_SINK) {
-    //return SRC caps;
-    temp_caps = gst_caps_copy (caps);
-    GValue item = G_VALUE_INIT;
-    gst_value_list_init (&v_formats, 2);
-    g_value_init (&item, G_TYPE_STRING);
-    g_value_set_string (&item, gst_video_format_to_string (GST_VIDEO_FORMAT_RGB));
-    gst_value_list_append_value (&v_formats, &item);
-    g_value_unset (&item);
-    g_value_init (&item, G_TYPE_STRING);
-    g_value_set_string (&item, gst_video_format_to_string (GST_VIDEO_FORMAT_GRAY8));
-    gst_value_list_append_value (&v_formats, &item);
-    g_value_unset (&item);
-    gst_caps_set_value (temp_caps, "format", &v_formats);
-    g_value_unset (&v_formats);
-    GST_DEBUG_OBJECT (neovideoconv, "%s temp src caps are %" GST_PTR_FORMAT,
-        __func__, temp_caps);
-  } else {
-    //return SINK caps
-    temp_caps = gst_caps_copy (caps);
-    gst_caps_set_simple (temp_caps, "format", G_TYPE_STRING,
-        gst_video_format_to_string (GST_VIDEO_FORMAT_RGB), NULL);
-    GST_DEBUG_OBJECT (neovideoconv, "%s temp sink caps are %" GST_PTR_FORMAT,
-        __func__, temp_caps);
+  c = (((gint64) (2 * x + 1) * in_size) << 16) / (2 * out_size) - (1 << 15);
+
+  return CLAMP (c, 0, (gint64) (in_size - 1) << 16);
+}
+
+/* Precomputes the column mapping of the downscale and gives every slice
+ * room for its source rows and column sums */
+static gboolean
+gst_neovideoconv_setup_scaling (GstNeovideoconv * neovideoconv,
+    GstVideoInfo * in_info, GstVideoInfo * out_info)
+{
+  gint in_width = GST_VIDEO_INFO_WIDTH (in_info);
+  gint out_width = GST_VIDEO_INFO_WIDTH (out_info);
+  GstNeovideoconvScaleMethod method;
+  gint x;
+  guint i;
+
+  g_clear_pointer (&neovideoconv->scale_xmap, g_free);
+  g_clear_pointer (&neovideoconv->scale_xcount, g_free);
+  g_clear_pointer (&neovideoconv->scale_xfrac, g_free);
+
+  if (!neovideoconv->scaling)
+    return TRUE;
+
+  if (out_width > in_width
+      || GST_VIDEO_INFO_HEIGHT (out_info) > GST_VIDEO_INFO_HEIGHT (in_info)) {
+    GST_ERROR_OBJECT (neovideoconv, "can only downscale, not %dx%d -> %dx%d",
+        in_width, GST_VIDEO_INFO_HEIGHT (in_info), out_width,
+        GST_VIDEO_INFO_HEIGHT (out_info));
+    return FALSE;
   }
 
-  if (filter) {
-    GST_ERROR_OBJECT (neovideoconv, "filter caps : %s",
-        gst_caps_to_string (filter));
-    ret_caps =
-        gst_caps_intersect_full (temp_caps, filter, GST_CAPS_INTERSECT_FIRST);
-    gst_caps_unref (temp_caps);
+  GST_OBJECT_LOCK (neovideoconv);
+  method = neovideoconv->scale_method;
+  GST_OBJECT_UNLOCK (neovideoconv);
+
+  /* the slices tell the methods apart by scale_xcount */
+  if (method == GST_NEOVIDEOCONV_SCALE_BOX) {
+    neovideoconv->scale_xmap = g_new (gint, in_width);
+    neovideoconv->scale_xcount = g_new0 (gint, out_width);
+    for (x = 0; x < in_width; x++) {
+      neovideoconv->scale_xmap[x] = (gint64) x * out_width / in_width;
+      neovideoconv->scale_xcount[neovideoconv->scale_xmap[x]]++;
+    }
   } else {
-    ret_caps = temp_caps;
+    neovideoconv->scale_xmap = g_new (gint, out_width);
+    neovideoconv->scale_xfrac = g_new (gint, out_width);
+    for (x = 0; x < out_width; x++) {
+      gint64 sx = gst_neovideoconv_scale_coord (x, in_width, out_width);
+
+      neovideoconv->scale_xmap[x] = sx >> 16;
+      neovideoconv->scale_xfrac[x] = (sx >> 8) & 0xff;
+    }
   }
 
-  GST_DEBUG_OBJECT (neovideoconv, "caps %p : %" GST_PTR_FORMAT, ret_caps,
-      ret_caps);
+  /* two rows with one pixel of padding, so bilinear can always read the
+   * right neighbour */
+  for (i = 0; i < neovideoconv->n_slices; i++) {
+    GstNeovideoconvSlice *slice = &neovideoconv->slices[i];
 
-  return ret_caps;
+    slice->scale_rows = g_realloc (slice->scale_rows, 2 * (in_width + 1));
+    slice->scale_sums = g_realloc (slice->scale_sums,
+        out_width * sizeof (guint64));
+  }
+  for (i = 0; i < neovideoconv->frames_max; i++) {
+    GstNeovideoconvSlice *slice = &neovideoconv->frames[i].slice;
+
+    slice->scale_rows = g_realloc (slice->scale_rows, 2 * (in_width + 1));
+    slice->scale_sums = g_realloc (slice->scale_sums,
+        out_width * sizeof (guint64));
+  }
+
+  GST_DEBUG_OBJECT (neovideoconv, "%s downscale %dx%d -> %dx%d",
+      method == GST_NEOVIDEOCONV_SCALE_BOX ? "box" : "bilinear", in_width,
+      GST_VIDEO_INFO_HEIGHT (in_info), out_width,
+      GST_VIDEO_INFO_HEIGHT (out_info));
+
+  return TRUE;
+}
+
+static gboolean
+gst_neovideoconv_set_info (GstVideoFilter * filter, GstCaps * incaps,
+    GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
+{
+  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (filter);
+  GstVideoFormat in_format = GST_VIDEO_INFO_FORMAT (in_info);
+  GstVideoFormat out_format = GST_VIDEO_INFO_FORMAT (out_info);
+  gboolean yuv_in = gst_neovideoconv_is_planar_yuv (in_format);
+  gint64 stream_threshold;
+  gint layout;
+
+  GST_DEBUG_OBJECT(neovideoconv, "in caps : %" GST_PTR_FORMAT, incaps);
+  GST_DEBUG_OBJECT(neovideoconv, "out caps : %" GST_PTR_FORMAT, outcaps);
+
+  /* the frames held back by the asynchronous mode last one frame duration
+   * each, which may just have changed */
+  if (neovideoconv->frames)
+    gst_element_post_message (GST_ELEMENT (neovideoconv),
+        gst_message_new_latency (GST_OBJECT (neovideoconv)));
+
+  neovideoconv->luma_only = FALSE;
+  neovideoconv->chroma_fill = FALSE;
+  neovideoconv->out_pstride = 1;
+  g_atomic_pointer_set (&neovideoconv->to_gray8_stream, NULL);
+  gst_clear_buffer (&neovideoconv->retained_outbuf);
+  g_clear_pointer (&neovideoconv->tile_fingerprints, g_free);
+
+  neovideoconv->scaling =
+      GST_VIDEO_INFO_WIDTH (in_info) != GST_VIDEO_INFO_WIDTH (out_info)
+      || GST_VIDEO_INFO_HEIGHT (in_info) != GST_VIDEO_INFO_HEIGHT (out_info);
+
+  /* the tables only depend on the method, build them once per caps */
+  GST_OBJECT_LOCK (neovideoconv);
+  neo_luma_init (&neovideoconv->luma, neovideoconv->method);
+  GST_OBJECT_UNLOCK (neovideoconv);
+
+  layout = gst_neovideoconv_layout_from_format (in_format);
+
+  /* same format on both sides: desaturate the input buffer in place,
+   * keeping the caps downstream asked for. Planar YUV only needs neutral
+   * chroma for that. */
+  if (in_format == out_format && !neovideoconv->scaling) {
+    if (layout < 0 && !yuv_in) {
+      GST_ERROR_OBJECT (neovideoconv, "can't desaturate %s in place",
+          GST_VIDEO_INFO_NAME (in_info));
+      return FALSE;
+    }
+    gst_base_transform_set_passthrough (GST_BASE_TRANSFORM (filter), FALSE);
+    gst_base_transform_set_in_place (GST_BASE_TRANSFORM (filter), TRUE);
+    if (yuv_in) {
+      neovideoconv->desaturate = NULL;
+      neovideoconv->chroma_fill = TRUE;
+      g_atomic_pointer_set (&neovideoconv->active_kernel, "chroma-fill");
+      GST_DEBUG_OBJECT (neovideoconv, "filling the chroma of %s in place",
+          GST_VIDEO_INFO_NAME (in_info));
+      return TRUE;
+    }
+    neovideoconv->desaturate = neovideoconv->kernels->desaturate[layout];
+    g_atomic_pointer_set (&neovideoconv->active_kernel,
+        neovideoconv->kernels->name);
+    GST_DEBUG_OBJECT (neovideoconv, "desaturating %s in place with %s kernels",
+        GST_VIDEO_INFO_NAME (in_info), neovideoconv->kernels->name);
+    return TRUE;
+  }
+
+  gst_base_transform_set_passthrough (GST_BASE_TRANSFORM (filter), FALSE);
+  gst_base_transform_set_in_place (GST_BASE_TRANSFORM (filter), FALSE);
+
+  switch (out_format) {
+    case GST_VIDEO_FORMAT_GRAY8:
+      break;
+    case GST_VIDEO_FORMAT_I420:
+    case GST_VIDEO_FORMAT_NV12:
+      neovideoconv->chroma_fill = TRUE;
+      break;
+    case GST_VIDEO_FORMAT_GRAY16_LE:
+      neovideoconv->out_pstride = 2;
+      break;
+    default:
+      layout = -1;
+      yuv_in = FALSE;
+      break;
+  }
+
+  if ((layout < 0 && !yuv_in)
+      || (neovideoconv->scaling && neovideoconv->out_pstride != 1)) {
+    GST_ERROR_OBJECT (neovideoconv, "unsupported conversion %s %dx%d -> "
+        "%s %dx%d", GST_VIDEO_INFO_NAME (in_info),
+        GST_VIDEO_INFO_WIDTH (in_info), GST_VIDEO_INFO_HEIGHT (in_info),
+        GST_VIDEO_INFO_NAME (out_info), GST_VIDEO_INFO_WIDTH (out_info),
+        GST_VIDEO_INFO_HEIGHT (out_info));
+    return FALSE;
+  }
+
+  /* the Y plane is the luma already, for GRAY8 it can even be shared */
+  if (yuv_in) {
+    neovideoconv->luma_only = out_format == GST_VIDEO_FORMAT_GRAY8;
+    neovideoconv->to_gray8 = neovideoconv->out_pstride == 2 ?
+        gst_neovideoconv_copy_luma_row16 : gst_neovideoconv_copy_luma_row;
+    g_atomic_pointer_set (&neovideoconv->active_kernel, "y-plane");
+    GST_DEBUG_OBJECT (neovideoconv, "extracting the Y plane of %s into %s",
+        GST_VIDEO_INFO_NAME (in_info), GST_VIDEO_INFO_NAME (out_info));
+    return gst_neovideoconv_setup_scaling (neovideoconv, in_info, out_info);
+  }
+
+  neovideoconv->to_gray8 = neovideoconv->out_pstride == 2 ?
+      neovideoconv->kernels->to_gray16[layout] :
+      neovideoconv->kernels->to_gray8[layout];
+  g_atomic_pointer_set (&neovideoconv->active_kernel,
+      neovideoconv->kernels->name);
+
+  /* frames that don't fit the cache would only flush it for nothing */
+  GST_OBJECT_LOCK (neovideoconv);
+  stream_threshold = neovideoconv->stream_threshold;
+  GST_OBJECT_UNLOCK (neovideoconv);
+  if (stream_threshold < 0)
+    stream_threshold = gst_neovideoconv_cache_size ();
+  if (neovideoconv->out_pstride == 1 && !neovideoconv->scaling
+      && GST_VIDEO_INFO_SIZE (in_info) + GST_VIDEO_INFO_SIZE (out_info) >=
+      stream_threshold) {
+    g_atomic_pointer_set (&neovideoconv->to_gray8_stream,
+        neovideoconv->kernels->to_gray8_stream[layout]);
+    GST_DEBUG_OBJECT (neovideoconv, "frames of %" G_GSIZE_FORMAT " bytes, "
+        "streaming past the cache", GST_VIDEO_INFO_SIZE (in_info));
+  }
+
+  if (!gst_neovideoconv_setup_scaling (neovideoconv, in_info, out_info))
+    return FALSE;
+
+  if (neovideoconv->convert_incremental && !neovideoconv->scaling) {
+    neovideoconv->tiles_x = GST_ROUND_UP_N (GST_VIDEO_INFO_WIDTH (in_info),
+        TILE_SIZE) / TILE_SIZE;
+    neovideoconv->tiles_y = GST_ROUND_UP_N (GST_VIDEO_INFO_HEIGHT (in_info),
+        TILE_SIZE) / TILE_SIZE;
+    neovideoconv->tile_fingerprints = g_new0 (guint64,
+        neovideoconv->tiles_x * neovideoconv->tiles_y);
+  }
+  GST_DEBUG_OBJECT (neovideoconv, "converting %s to %s with %s kernels",
+      GST_VIDEO_INFO_NAME (in_info), GST_VIDEO_INFO_NAME (out_info),
+      neovideoconv->kernels->name);
+
+  return TRUE;
+}
+
+/* Makes sure @query carries allocation params with at least BUFFER_ALIGN
+ * alignment */
+static void
+gst_neovideoconv_align_allocation_params (GstQuery * query)
+{
+  GstAllocator *allocator = NULL;
+  GstAllocationParams params;
+
+  if (gst_query_get_n_allocation_params (query) > 0) {
+    gst_query_parse_nth_allocation_param (query, 0, &allocator, &params);
+    params.align = MAX (params.align, BUFFER_ALIGN - 1);
+    gst_query_set_nth_allocation_param (query, 0, allocator, &params);
+  } else {
+    gst_allocation_params_init (&params);
+    params.align = BUFFER_ALIGN - 1;
+    gst_query_add_allocation_param (query, NULL, &params);
+  }
+
+  if (allocator)
+    gst_object_unref (allocator);
+}
+
+static gboolean
+gst_neovideoconv_propose_allocation (GstBaseTransform * trans,
+    GstQuery * decide_query, GstQuery * query)
+{
+  if (!GST_BASE_TRANSFORM_CLASS (gst_neovideoconv_parent_class)->
+      propose_allocation (trans, decide_query, query))
+    return FALSE;
+
+  /* upstream may not handle GstVideoMeta, so only the buffer start is
+   * aligned here, not the strides */
+  if (decide_query)
+    gst_neovideoconv_align_allocation_params (query);
+
+  /* padded and cropped buffers are read in place, which spares upstream a
+   * copy into a tightly packed frame */
+  if (!gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL))
+    gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+  if (!gst_query_find_allocation_meta (query, GST_VIDEO_CROP_META_API_TYPE,
+          NULL))
+    gst_query_add_allocation_meta (query, GST_VIDEO_CROP_META_API_TYPE, NULL);
+
+  return TRUE;
+}
+
+static gboolean
+gst_neovideoconv_decide_allocation (GstBaseTransform * trans, GstQuery * query)
+{
+  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (trans);
+  GstBufferPool *pool = NULL;
+  GstStructure *config;
+  GstCaps *outcaps;
+  GstVideoInfo info;
+  guint size = 0, min = 0, max = 0;
+  gboolean update_pool;
+
+  neovideoconv->downstream_video_meta =
+      gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+  GST_DEBUG_OBJECT (neovideoconv, "downstream supports video meta: %d",
+      neovideoconv->downstream_video_meta);
+
+  gst_query_parse_allocation (query, &outcaps, NULL);
+  if (!outcaps || !gst_video_info_from_caps (&info, outcaps))
+    return FALSE;
+
+  gst_neovideoconv_align_allocation_params (query);
+
+  /* memfd output replaces whatever allocator downstream proposed, the
+   * parent configures the pool with allocation param 0 */
+  if (neovideoconv->memfd_allocator) {
+    GstAllocationParams params;
+
+    gst_query_parse_nth_allocation_param (query, 0, NULL, &params);
+    gst_query_set_nth_allocation_param (query, 0,
+        neovideoconv->memfd_allocator, &params);
+  }
+
+  /* always allocate from a video pool, so that output buffers are recycled
+   * instead of allocated per frame. A pool of downstream allocates its own
+   * memory, so memfd output gets a pool of its own. */
+  update_pool = gst_query_get_n_allocation_pools (query) > 0;
+  if (update_pool)
+    gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min, &max);
+  if (pool && (!GST_IS_VIDEO_BUFFER_POOL (pool)
+          || neovideoconv->memfd_allocator))
+    gst_clear_object (&pool);
+  if (!pool)
+    pool = gst_video_buffer_pool_new ();
+
+  /* the incremental mode keeps the previous output buffer */
+  if (neovideoconv->tile_fingerprints) {
+    min++;
+    if (max > 0)
+      max++;
+  }
+
+  /* with GstVideoMeta downstream, pad each row to a multiple of
+   * BUFFER_ALIGN so every row starts aligned for the SIMD kernels */
+  if (neovideoconv->downstream_video_meta) {
+    GstVideoAlignment align;
+    guint i;
+
+    gst_video_alignment_reset (&align);
+    for (i = 0; i < GST_VIDEO_MAX_PLANES; i++)
+      align.stride_align[i] = BUFFER_ALIGN - 1;
+    gst_video_info_align (&info, &align);
+
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_add_option (config,
+        GST_BUFFER_POOL_OPTION_VIDEO_META);
+    gst_buffer_pool_config_add_option (config,
+        GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT);
+    gst_buffer_pool_config_set_video_alignment (config, &align);
+    gst_buffer_pool_config_set_params (config, outcaps, info.size, min, max);
+    gst_buffer_pool_set_config (pool, config);
+  }
+  size = MAX (size, info.size);
+
+  if (update_pool)
+    gst_query_set_nth_allocation_pool (query, 0, pool, size, min, max);
+  else
+    gst_query_add_allocation_pool (query, pool, size, min, max);
+  gst_object_unref (pool);
+
+  return GST_BASE_TRANSFORM_CLASS (gst_neovideoconv_parent_class)->
+      decide_allocation (trans, query);
+}
+
+static void gst_neovideoconv_merge_histograms (GstNeovideoconv * neovideoconv,
+    gint n_slices);
+static void gst_neovideoconv_analyze_plane (GstNeovideoconvSlice * slice,
+    GstVideoFrame * frame);
+static void gst_neovideoconv_add_analysis_meta (const guint64 hist[256],
+    GstBuffer * buffer);
+
+/* Wraps the Y plane of @inbuf as a GRAY8 buffer sharing its memory. Only
+ * possible when the plane sits in a single memory and either downstream
+ * reads GstVideoMeta or the Y stride already is the default GRAY8 one. */
+static GstBuffer *
+gst_neovideoconv_wrap_luma (GstNeovideoconv * neovideoconv, GstBuffer * inbuf)
+{
+  GstVideoFilter *filter = GST_VIDEO_FILTER (neovideoconv);
+  GstVideoMeta *meta;
+  GstVideoCropMeta *crop;
+  GstBuffer *outbuf;
+  gsize offset, size;
+  gint stride, width, height;
+  guint idx, length;
+  gsize skip;
+  gsize out_offset[GST_VIDEO_MAX_PLANES] = { 0, };
+  gint out_stride[GST_VIDEO_MAX_PLANES] = { 0, };
+
+  width = GST_VIDEO_INFO_WIDTH (&filter->in_info);
+  height = GST_VIDEO_INFO_HEIGHT (&filter->in_info);
+
+  meta = gst_buffer_get_video_meta (inbuf);
+  if (meta) {
+    offset = meta->offset[0];
+    stride = meta->stride[0];
+  } else {
+    offset = GST_VIDEO_INFO_PLANE_OFFSET (&filter->in_info, 0);
+    stride = GST_VIDEO_INFO_PLANE_STRIDE (&filter->in_info, 0);
+  }
+
+  /* the visible area starts at the crop origin, whose rows the wrapped
+   * buffer begins with */
+  crop = gst_buffer_get_video_crop_meta (inbuf);
+  if (crop)
+    offset += (gsize) crop->y * stride + crop->x;
+
+  if (!neovideoconv->downstream_video_meta
+      && stride != GST_VIDEO_INFO_PLANE_STRIDE (&filter->out_info, 0))
+    return NULL;
+
+  size = (gsize) stride * (height - 1) + width;
+  if (!gst_buffer_find_memory (inbuf, offset, size, &idx, &length, &skip)
+      || length != 1)
+    return NULL;
+
+  outbuf = gst_buffer_copy_region (inbuf, GST_BUFFER_COPY_FLAGS |
+      GST_BUFFER_COPY_TIMESTAMPS | GST_BUFFER_COPY_MEMORY, offset, size);
+  if (!outbuf)
+    return NULL;
+
+  out_stride[0] = stride;
+  gst_buffer_add_video_meta_full (outbuf, GST_VIDEO_FRAME_FLAG_NONE,
+      GST_VIDEO_FORMAT_GRAY8, width, height, 1, out_offset, out_stride);
+
+  return outbuf;
+}
+
+static GstFlowReturn
+gst_neovideoconv_prepare_output_buffer (GstBaseTransform * trans,
+    GstBuffer * inbuf, GstBuffer ** outbuf)
+{
+  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (trans);
+  GstFlowReturn ret;
+
+  /* only ever the buffer prepared right now, a stale pointer could match
+   * an unrelated buffer reallocated at the same address */
+  neovideoconv->wrapped_outbuf = NULL;
+
+  /* a wrapped Y plane would leave the memory of the input, not memfds */
+  if (neovideoconv->luma_only && !neovideoconv->scaling
+      && !neovideoconv->memfd_allocator
+      && !gst_base_transform_is_passthrough (trans)) {
+    GstClockTime start = gst_util_get_timestamp ();
+
+    *outbuf = gst_neovideoconv_wrap_luma (neovideoconv, inbuf);
+    if (*outbuf) {
+      GstBaseTransformClass *klass = GST_BASE_TRANSFORM_GET_CLASS (trans);
+
+      GST_LOG_OBJECT (neovideoconv, "wrapped Y plane of %p", inbuf);
+      /* the default prepare_output_buffer is skipped, so the metas (ROI,
+       * ...) have to be carried over here */
+      if (klass->copy_metadata
+          && !klass->copy_metadata (trans, inbuf, *outbuf))
+        GST_WARNING_OBJECT (neovideoconv, "could not copy metadata");
+      neovideoconv->wrapped_outbuf = *outbuf;
+      if (neovideoconv->analyzing) {
+        GstVideoFrame frame;
+
+        if (gst_video_frame_map (&frame,
+                &GST_VIDEO_FILTER (neovideoconv)->in_info, inbuf,
+                GST_MAP_READ)) {
+          gst_neovideoconv_crop_frame (&frame,
+              &GST_VIDEO_FILTER (neovideoconv)->in_info);
+          gst_neovideoconv_analyze_plane (&neovideoconv->slices[0], &frame);
+          gst_neovideoconv_merge_histograms (neovideoconv, 1);
+          gst_video_frame_unmap (&frame);
+          gst_neovideoconv_add_analysis_meta (neovideoconv->hist, *outbuf);
+        }
+      }
+      gst_neovideoconv_record_frame (neovideoconv,
+          gst_util_get_timestamp () - start, gst_buffer_get_size (inbuf),
+          gst_buffer_get_size (*outbuf));
+      return GST_FLOW_OK;
+    }
+    GST_LOG_OBJECT (neovideoconv, "Y plane can't be wrapped, copying");
+  }
+
+  ret = GST_BASE_TRANSFORM_CLASS (gst_neovideoconv_parent_class)->
+      prepare_output_buffer (trans, inbuf, outbuf);
+
+  /* a pooled buffer seen before was recycled, anything else was allocated
+   * for this frame */
+  if (ret == GST_FLOW_OK && *outbuf != inbuf) {
+    if ((*outbuf)->pool && gst_mini_object_get_qdata (GST_MINI_OBJECT (*outbuf),
+            pool_seen_quark)) {
+      neovideoconv->pool_hits++;
+    } else {
+      neovideoconv->pool_misses++;
+      if ((*outbuf)->pool)
+        gst_mini_object_set_qdata (GST_MINI_OBJECT (*outbuf), pool_seen_quark,
+            GINT_TO_POINTER (1), NULL);
+      GST_DEBUG_OBJECT (neovideoconv, "output pool miss, %" G_GUINT64_FORMAT
+          " hits %" G_GUINT64_FORMAT " misses", neovideoconv->pool_hits,
+          neovideoconv->pool_misses);
+    }
+  }
+
+  return ret;
+}
+
+static gboolean
+gst_neovideoconv_src_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (trans);
+
+  /* keep our own copy, the base class doesn't expose its QoS values */
+  if (GST_EVENT_TYPE (event) == GST_EVENT_QOS) {
+    gdouble proportion;
+    GstClockTimeDiff diff;
+    GstClockTime timestamp;
+
+    gst_event_parse_qos (event, NULL, &proportion, &diff, &timestamp);
+
+    GST_OBJECT_LOCK (neovideoconv);
+    neovideoconv->qos_proportion = proportion;
+    if (!GST_CLOCK_TIME_IS_VALID (timestamp))
+      neovideoconv->qos_earliest_time = GST_CLOCK_TIME_NONE;
+    else if (diff < 0 && (GstClockTime) - diff > timestamp)
+      neovideoconv->qos_earliest_time = 0;
+    else
+      neovideoconv->qos_earliest_time = timestamp + diff;
+    GST_OBJECT_UNLOCK (neovideoconv);
+
+    GST_LOG_OBJECT (neovideoconv, "QoS proportion %g, earliest time %"
+        GST_TIME_FORMAT, proportion,
+        GST_TIME_ARGS (neovideoconv->qos_earliest_time));
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (gst_neovideoconv_parent_class)->src_event
+      (trans, event);
+}
+
+static gboolean
+gst_neovideoconv_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (trans);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+    gst_neovideoconv_reset_qos (neovideoconv);
+
+  /* the queued frames go out before the event, or are flushed */
+  if (neovideoconv->frames) {
+    if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+      gst_neovideoconv_drain_frames (neovideoconv, FALSE);
+    else if (GST_EVENT_IS_SERIALIZED (event))
+      gst_neovideoconv_drain_frames (neovideoconv, TRUE);
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (gst_neovideoconv_parent_class)->sink_event
+      (trans, event);
+}
+
+/* Whether @buf is not worth converting: either it is already late for the
+ * last QoS event, or downstream asked for fewer frames with a proportion
+ * above 1 and this one belongs to the 1 - 1/proportion share being shed */
+static gboolean
+gst_neovideoconv_qos_drop (GstNeovideoconv * neovideoconv, GstBuffer * buf)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM (neovideoconv);
+  GstClockTime timestamp, running_time, stream_time, earliest_time;
+  GstMessage *msg;
+  gdouble proportion;
+  gboolean late;
+
+  if (!gst_base_transform_is_qos_enabled (trans))
+    return FALSE;
+
+  timestamp = GST_BUFFER_TIMESTAMP (buf);
+  if (trans->segment.format != GST_FORMAT_TIME
+      || !GST_CLOCK_TIME_IS_VALID (timestamp))
+    return FALSE;
+
+  running_time = gst_segment_to_running_time (&trans->segment,
+      GST_FORMAT_TIME, timestamp);
+  if (!GST_CLOCK_TIME_IS_VALID (running_time))
+    return FALSE;
+
+  GST_OBJECT_LOCK (neovideoconv);
+  proportion = neovideoconv->qos_proportion;
+  earliest_time = neovideoconv->qos_earliest_time;
+  GST_OBJECT_UNLOCK (neovideoconv);
+
+  late = GST_CLOCK_TIME_IS_VALID (earliest_time)
+      && running_time <= earliest_time;
+
+  if (!late) {
+    if (proportion <= 1.0) {
+      neovideoconv->qos_credit = 0.0;
+      return FALSE;
+    }
+    neovideoconv->qos_credit += 1.0 / proportion;
+    if (neovideoconv->qos_credit >= 1.0) {
+      neovideoconv->qos_credit -= 1.0;
+      return FALSE;
+    }
+  }
+
+  STAT_ADD (neovideoconv->stats.frames_dropped, 1);
+  GST_DEBUG_OBJECT (neovideoconv, "dropping frame at %" GST_TIME_FORMAT
+      ", %s", GST_TIME_ARGS (running_time),
+      late ? "late" : "shedding by proportion");
+
+  /* same message the base class posts for the frames it drops */
+  stream_time = gst_segment_to_stream_time (&trans->segment, GST_FORMAT_TIME,
+      timestamp);
+  msg = gst_message_new_qos (GST_OBJECT_CAST (neovideoconv), FALSE,
+      running_time, stream_time, timestamp, GST_BUFFER_DURATION (buf));
+  gst_message_set_qos_values (msg, late ?
+      GST_CLOCK_DIFF (running_time, earliest_time) : 0, proportion, 1000000);
+  gst_message_set_qos_stats (msg, GST_FORMAT_BUFFERS,
+      STAT_GET (neovideoconv->stats.frames_processed),
+      STAT_GET (neovideoconv->stats.frames_dropped));
+  gst_element_post_message (GST_ELEMENT_CAST (neovideoconv), msg);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_neovideoconv_submit_input_buffer (GstBaseTransform * trans,
+    gboolean is_discont, GstBuffer * input)
+{
+  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (trans);
+  GstFlowReturn ret;
+
+  /* shed the frame before any output buffer is allocated for it, the base
+   * class marks the next buffer DISCONT */
+  if (gst_neovideoconv_qos_drop (neovideoconv, input)) {
+    gst_buffer_unref (input);
+    return GST_BASE_TRANSFORM_FLOW_DROPPED;
+  }
+
+  /* renegotiating changes what the queued frames are converted with */
+  if (neovideoconv->frames && gst_pad_needs_reconfigure (trans->srcpad)) {
+    ret = gst_neovideoconv_drain_frames (neovideoconv, TRUE);
+    if (ret != GST_FLOW_OK) {
+      gst_buffer_unref (input);
+      return ret;
+    }
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (gst_neovideoconv_parent_class)->
+      submit_input_buffer (trans, is_discont, input);
+}
+
+static GstFlowReturn
+gst_neovideoconv_transform (GstBaseTransform * trans, GstBuffer * inbuf,
+    GstBuffer * outbuf)
+{
+  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (trans);
+
+  /* the output already is the Y plane, nothing to touch */
+  if (outbuf == neovideoconv->wrapped_outbuf) {
+    neovideoconv->wrapped_outbuf = NULL;
+    return GST_FLOW_OK;
+  }
+
+  if (neovideoconv->frames) {
+    gst_neovideoconv_queue_frame (neovideoconv, gst_buffer_ref (inbuf),
+        outbuf, TRUE);
+    neovideoconv->frame_queued = TRUE;
+    return GST_FLOW_OK;
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (gst_neovideoconv_parent_class)->transform
+      (trans, inbuf, outbuf);
+}
+
+static GstFlowReturn
+gst_neovideoconv_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (trans);
+
+  if (neovideoconv->frames) {
+    gst_neovideoconv_queue_frame (neovideoconv, NULL, buf, TRUE);
+    neovideoconv->frame_queued = TRUE;
+    return GST_FLOW_OK;
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (gst_neovideoconv_parent_class)->
+      transform_ip (trans, buf);
+}
+
+/* In the asynchronous mode the output for a new input is queued instead of
+ * returned, and the oldest queued frame is returned once it is converted.
+ * While the queue is full that one is waited for, which leaves room for the
+ * next input and holds a frame back by at most async-depth - 1 inputs. */
+static GstFlowReturn
+gst_neovideoconv_generate_output (GstBaseTransform * trans,
+    GstBuffer ** outbuf)
+{
+  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (trans);
+  GstBuffer *buf = NULL;
+  GstFlowReturn ret;
+
+  if (!neovideoconv->frames)
+    return GST_BASE_TRANSFORM_CLASS (gst_neovideoconv_parent_class)->
+        generate_output (trans, outbuf);
+
+  if (trans->queued_buf) {
+    neovideoconv->frame_queued = FALSE;
+    ret = GST_BASE_TRANSFORM_CLASS (gst_neovideoconv_parent_class)->
+        generate_output (trans, &buf);
+    if (ret != GST_FLOW_OK) {
+      *outbuf = buf;
+      return ret;
+    }
+    /* output that needed no conversion still waits for the frames before */
+    if (buf && !neovideoconv->frame_queued)
+      gst_neovideoconv_queue_frame (neovideoconv, NULL, buf, FALSE);
+  }
+
+  gst_neovideoconv_pop_frame (neovideoconv, FALSE, outbuf);
+
+  return GST_FLOW_OK;
+}
+
+/* Time the frames of the asynchronous mode are held back at most */
+static GstClockTime
+gst_neovideoconv_async_latency (GstNeovideoconv * neovideoconv)
+{
+  GstVideoInfo *info = &GST_VIDEO_FILTER (neovideoconv)->in_info;
+  guint async_depth;
+
+  GST_OBJECT_LOCK (neovideoconv);
+  async_depth = neovideoconv->async_depth;
+  GST_OBJECT_UNLOCK (neovideoconv);
+
+  if (async_depth <= 1 || GST_VIDEO_INFO_FPS_N (info) <= 0)
+    return 0;
+
+  return gst_util_uint64_scale (async_depth - 1,
+      GST_SECOND * GST_VIDEO_INFO_FPS_D (info), GST_VIDEO_INFO_FPS_N (info));
+}
+
+static gboolean
+gst_neovideoconv_query (GstBaseTransform * trans, GstPadDirection direction,
+    GstQuery * query)
+{
+  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (trans);
+  gboolean ret;
+
+  ret = GST_BASE_TRANSFORM_CLASS (gst_neovideoconv_parent_class)->query
+      (trans, direction, query);
+
+  if (ret && direction == GST_PAD_SRC
+      && GST_QUERY_TYPE (query) == GST_QUERY_LATENCY) {
+    GstClockTime latency = gst_neovideoconv_async_latency (neovideoconv);
+    GstClockTime min, max;
+    gboolean live;
+
+    if (latency > 0) {
+      gst_query_parse_latency (query, &live, &min, &max);
+      min += latency;
+      if (GST_CLOCK_TIME_IS_VALID (max))
+        max += latency;
+      gst_query_set_latency (query, live, min, max);
+      GST_DEBUG_OBJECT (neovideoconv, "added %" GST_TIME_FORMAT
+          " of latency, now min %" GST_TIME_FORMAT " max %" GST_TIME_FORMAT,
+          GST_TIME_ARGS (latency), GST_TIME_ARGS (min), GST_TIME_ARGS (max));
+    }
+  }
+
+  return ret;
+}
+
+/* Adds @width luma values @pstride bytes apart to @hist */
+static inline void
+gst_neovideoconv_histogram_row (guint32 hist[4][256], const guint8 * data,
+    gint width, gint pstride)
+{
+  gint i;
+
+  for (i = 0; i + 4 <= width; i += 4) {
+    hist[0][data[0]]++;
+    hist[1][data[pstride]]++;
+    hist[2][data[2 * pstride]]++;
+    hist[3][data[3 * pstride]]++;
+    data += 4 * pstride;
+  }
+  for (; i < width; i++) {
+    hist[0][data[0]]++;
+    data += pstride;
+  }
+}
+
+/* Adds rows @row_start to @row_end to the slice histogram, called right
+ * after they were converted so that they are still in the cache. That is
+ * the output luma, or in place the G of the desaturated pixels. */
+static void
+gst_neovideoconv_analyze_rows (GstNeovideoconvSlice * slice, gint row_start,
+    gint row_end)
+{
+  GstVideoFrame *frame = slice->outframe ? slice->outframe : slice->inframe;
+  gint width = GST_VIDEO_FRAME_WIDTH (frame);
+  gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
+  const guint8 *data = GST_VIDEO_FRAME_PLANE_DATA (frame, 0);
+  gint pstride, row;
+
+  if (slice->outframe) {
+    /* GRAY16_LE is binned by its upper byte */
+    pstride = slice->neovideoconv->out_pstride;
+    data += pstride - 1;
+  } else {
+    pstride = GST_VIDEO_FRAME_COMP_PSTRIDE (frame, 1);
+    data += GST_VIDEO_FRAME_COMP_POFFSET (frame, 1);
+  }
+
+  for (row = row_start; row < row_end; row++)
+    gst_neovideoconv_histogram_row (slice->hist, data + row * stride, width,
+        pstride);
+}
+
+/* Adds the histogram of @slice to @hist */
+static void
+gst_neovideoconv_sum_histogram (guint64 hist[256],
+    const GstNeovideoconvSlice * slice)
+{
+  gint h, v;
+
+  for (h = 0; h < 4; h++) {
+    for (v = 0; v < 256; v++)
+      hist[v] += slice->hist[h][v];
+  }
+}
+
+/* Sums the histograms of the first @n_slices slices into the frame one */
+static void
+gst_neovideoconv_merge_histograms (GstNeovideoconv * neovideoconv,
+    gint n_slices)
+{
+  gint i;
+
+  memset (neovideoconv->hist, 0, sizeof (neovideoconv->hist));
+  for (i = 0; i < n_slices; i++)
+    gst_neovideoconv_sum_histogram (neovideoconv->hist,
+        &neovideoconv->slices[i]);
+}
+
+/* Histogram of the GRAY8 or Y plane of @frame into @slice, for luma that is
+ * passed on as is rather than converted by the slices */
+static void
+gst_neovideoconv_analyze_plane (GstNeovideoconvSlice * slice,
+    GstVideoFrame * frame)
+{
+  gint width = GST_VIDEO_FRAME_COMP_WIDTH (frame, 0);
+  gint height = GST_VIDEO_FRAME_COMP_HEIGHT (frame, 0);
+  gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
+  const guint8 *data = GST_VIDEO_FRAME_PLANE_DATA (frame, 0);
+  gint row;
+
+  memset (slice->hist, 0, sizeof (slice->hist));
+  for (row = 0; row < height; row++)
+    gst_neovideoconv_histogram_row (slice->hist, data + row * stride, width,
+        1);
+}
+
+/* Attaches the frame histogram @hist and the statistics derived from it
+ * to @buffer, replacing the analysis of an earlier element */
+static void
+gst_neovideoconv_add_analysis_meta (const guint64 hist[256],
+    GstBuffer * buffer)
+{
+  guint32 counts[256];
+  guint64 n = 0, sum = 0, sum_sq = 0;
+  guint min = 0, max = 0, v;
+  gdouble mean = 0.0, variance = 0.0;
+  GstCustomMeta *meta;
+  GBytes *bytes;
+
+  for (v = 0; v < 256; v++) {
+    counts[v] = hist[v];
+    if (hist[v] == 0)
+      continue;
+    if (n == 0)
+      min = v;
+    max = v;
+    n += hist[v];
+    sum += hist[v] * v;
+    sum_sq += hist[v] * v * v;
+  }
+  if (n > 0) {
+    mean = (gdouble) sum / n;
+    variance = MAX ((gdouble) sum_sq / n - mean * mean, 0.0);
+  }
+
+  meta = gst_buffer_get_custom_meta (buffer,
+      GST_NEOVIDEOCONV_ANALYSIS_META_NAME);
+  if (meta)
+    gst_buffer_remove_meta (buffer, (GstMeta *) meta);
+  meta = gst_buffer_add_custom_meta (buffer,
+      GST_NEOVIDEOCONV_ANALYSIS_META_NAME);
+
+  bytes = g_bytes_new (counts, sizeof (counts));
+  gst_structure_set (gst_custom_meta_get_structure (meta),
+      "mean", G_TYPE_DOUBLE, mean, "variance", G_TYPE_DOUBLE, variance,
+      "min", G_TYPE_UINT, min, "max", G_TYPE_UINT, max,
+      "histogram", G_TYPE_BYTES, bytes, NULL);
+  g_bytes_unref (bytes);
+}
+
+/* Converts the parts of the slice rows covered by a region of interest,
+ * one kernel call per region row. Overlapping regions are converted twice,
+ * which gives the same result as once. */
+static void
+gst_neovideoconv_convert_slice_regions (GstNeovideoconvSlice * slice)
+{
+  GstNeovideoconv *neovideoconv = slice->neovideoconv;
+  GstVideoFrame *inframe = slice->inframe;
+  GstVideoFrame *outframe = slice->outframe;
+  gint out_pstride = neovideoconv->out_pstride;
+  gint pstride, row_stride, d_row_stride = 0, row;
+  guint8 *src, *dest = NULL;
+  guint i;
+
+  pstride = GST_VIDEO_FRAME_COMP_PSTRIDE (inframe, 0);
+  row_stride = GST_VIDEO_FRAME_PLANE_STRIDE (inframe, 0);
+  src = GST_VIDEO_FRAME_PLANE_DATA (inframe, 0);
+
+  if (outframe) {
+    d_row_stride = GST_VIDEO_FRAME_PLANE_STRIDE (outframe, 0);
+    dest = GST_VIDEO_FRAME_PLANE_DATA (outframe, 0);
+    for (row = slice->row_start; row < slice->row_end; row++)
+      memset (dest + row * d_row_stride, 0,
+          GST_VIDEO_FRAME_WIDTH (outframe) * out_pstride);
+  }
+
+  for (i = 0; i < slice->regions->len; i++) {
+    GstNeovideoconvRegion *region =
+        &g_array_index (slice->regions, GstNeovideoconvRegion, i);
+    gint row_end = MIN (region->y + region->height, slice->row_end);
+
+    for (row = MAX (region->y, slice->row_start); row < row_end; row++) {
+      guint8 *s = src + row * row_stride + region->x * pstride;
+
+      if (outframe) {
+        neovideoconv->to_gray8 (dest + row * d_row_stride +
+            region->x * out_pstride, s, region->width, &neovideoconv->luma);
+      } else {
+        neovideoconv->desaturate (s, region->width, &neovideoconv->luma);
+        /* in place only the regions are grey, overlaps count twice */
+        if (neovideoconv->analyzing)
+          gst_neovideoconv_histogram_row (slice->hist,
+              s + GST_VIDEO_FRAME_COMP_POFFSET (inframe, 1), region->width,
+              pstride);
+      }
+    }
+  }
+
+  /* the output is black outside the regions, and that is analyzed too */
+  if (outframe && neovideoconv->analyzing)
+    gst_neovideoconv_analyze_rows (slice, slice->row_start, slice->row_end);
+}
+
+/* Fingerprint of @rows rows of @bytes bytes, four independent
+ * multiply-xor lanes over 8-byte words so it runs at about memory speed */
+static guint64
+gst_neovideoconv_fingerprint (const guint8 * data, gint stride, gint bytes,
+    gint rows)
+{
+  const guint64 prime = G_GUINT64_CONSTANT (0x100000001b3);
+  guint64 h[4] = { 1, 2, 3, 4 };
+  guint64 w;
+  gint row, i, l;
+
+#define MIX(h, w) G_STMT_START { \
+    (h) = ((h) ^ (w)) * prime; \
+    (h) ^= (h) >> 32; \
+  } G_STMT_END
+
+  for (row = 0; row < rows; row++, data += stride) {
+    for (i = 0; i + 32 <= bytes; i += 32) {
+      for (l = 0; l < 4; l++) {
+        memcpy (&w, data + i + 8 * l, 8);
+        MIX (h[l], w);
+      }
+    }
+    for (; i + 8 <= bytes; i += 8) {
+      memcpy (&w, data + i, 8);
+      MIX (h[0], w);
+    }
+    for (; i < bytes; i++)
+      MIX (h[1], data[i]);
+  }
+
+#undef MIX
+
+  return h[0] ^ ((h[1] << 17) | (h[1] >> 47)) ^ ((h[2] << 31) | (h[2] >> 33))
+      ^ ((h[3] << 47) | (h[3] >> 17));
+}
+
+/* Converts the tiles of the slice whose fingerprint changed and copies the
+ * others from the previous output, when there is one */
+static void
+gst_neovideoconv_convert_slice_tiles (GstNeovideoconvSlice * slice)
+{
+  GstNeovideoconv *neovideoconv = slice->neovideoconv;
+  GstVideoFrame *inframe = slice->inframe;
+  GstVideoFrame *outframe = slice->outframe;
+  GstVideoFrame *prev = NULL;
+  gint out_pstride = neovideoconv->out_pstride;
+  gint width, pstride, row_stride, d_row_stride, p_row_stride = 0;
+  gint ty, tx, row;
+  const guint8 *src, *prev_data = NULL;
+  guint8 *dest;
+
+  width = GST_VIDEO_FRAME_WIDTH (inframe);
+  pstride = GST_VIDEO_FRAME_COMP_PSTRIDE (inframe, 0);
+  row_stride = GST_VIDEO_FRAME_PLANE_STRIDE (inframe, 0);
+  src = GST_VIDEO_FRAME_PLANE_DATA (inframe, 0);
+  d_row_stride = GST_VIDEO_FRAME_PLANE_STRIDE (outframe, 0);
+  dest = GST_VIDEO_FRAME_PLANE_DATA (outframe, 0);
+
+  if (neovideoconv->have_prev_frame) {
+    prev = &neovideoconv->prev_frame;
+    p_row_stride = GST_VIDEO_FRAME_PLANE_STRIDE (prev, 0);
+    prev_data = GST_VIDEO_FRAME_PLANE_DATA (prev, 0);
+  }
+
+  for (ty = slice->row_start / TILE_SIZE; ty * TILE_SIZE < slice->row_end;
+      ty++) {
+    gint y0 = ty * TILE_SIZE;
+    gint y1 = MIN (y0 + TILE_SIZE, slice->row_end);
+
+    for (tx = 0; tx < neovideoconv->tiles_x; tx++) {
+      guint64 *fingerprint =
+          &neovideoconv->tile_fingerprints[ty * neovideoconv->tiles_x + tx];
+      gint x0 = tx * TILE_SIZE;
+      gint w = MIN (TILE_SIZE, width - x0);
+      guint64 hash;
+
+      hash = gst_neovideoconv_fingerprint (src + y0 * row_stride +
+          x0 * pstride, row_stride, w * pstride, y1 - y0);
+      slice->tiles++;
+
+      if (prev && hash == *fingerprint) {
+        for (row = y0; row < y1; row++)
+          memcpy (dest + row * d_row_stride + x0 * out_pstride,
+              prev_data + row * p_row_stride + x0 * out_pstride,
+              w * out_pstride);
+        continue;
+      }
+
+      *fingerprint = hash;
+      slice->tiles_dirty++;
+      for (row = y0; row < y1; row++)
+        neovideoconv->to_gray8 (dest + row * d_row_stride + x0 * out_pstride,
+            src + row * row_stride + x0 * pstride, w, &neovideoconv->luma);
+    }
+
+    if (neovideoconv->analyzing)
+      gst_neovideoconv_analyze_rows (slice, y0, y1);
+  }
+}
+
+/* Converts input row @y into @dest, padded with a copy of its last pixel */
+static void
+gst_neovideoconv_scale_load_row (GstNeovideoconv * neovideoconv,
+    GstVideoFrame * inframe, gint y, guint8 * dest)
+{
+  gint width = GST_VIDEO_FRAME_WIDTH (inframe);
+  const guint8 *src = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (inframe, 0) +
+      y * GST_VIDEO_FRAME_PLANE_STRIDE (inframe, 0);
+
+  neovideoconv->to_gray8 (dest, src, width, &neovideoconv->luma);
+  dest[width] = dest[width - 1];
+}
+
+/* Downscales while converting, the slice rows are output rows. Box adds
+ * every input pixel to the one output pixel covering it, so each input row
+ * is read and converted once. Bilinear only converts the two input rows
+ * around each output row, keeping them for the next output row. */
+static void
+gst_neovideoconv_convert_slice_scaled (GstNeovideoconvSlice * slice)
+{
+  GstNeovideoconv *neovideoconv = slice->neovideoconv;
+  GstVideoFrame *inframe = slice->inframe;
+  GstVideoFrame *outframe = slice->outframe;
+  gint in_width = GST_VIDEO_FRAME_WIDTH (inframe);
+  gint in_height = GST_VIDEO_FRAME_HEIGHT (inframe);
+  gint out_width = GST_VIDEO_FRAME_WIDTH (outframe);
+  gint out_height = GST_VIDEO_FRAME_HEIGHT (outframe);
+  gint d_row_stride = GST_VIDEO_FRAME_PLANE_STRIDE (outframe, 0);
+  guint8 *dest = GST_VIDEO_FRAME_PLANE_DATA (outframe, 0);
+  guint8 *rows[2] = { slice->scale_rows, slice->scale_rows + in_width + 1 };
+  gint loaded[2] = { -1, -1 };
+  gint row, x, y;
+
+  for (row = slice->row_start; row < slice->row_end; row++) {
+    guint8 *d = dest + row * d_row_stride;
+
+    if (neovideoconv->scale_xcount) {
+      /* the input rows y with y * out_height / in_height == row */
+      gint y0 = ((gint64) row * in_height + out_height - 1) / out_height;
+      gint y1 = ((gint64) (row + 1) * in_height + out_height - 1) / out_height;
+      guint64 *sums = slice->scale_sums;
+
+      memset (sums, 0, out_width * sizeof (guint64));
+      for (y = y0; y < y1; y++) {
+        gst_neovideoconv_scale_load_row (neovideoconv, inframe, y, rows[0]);
+        for (x = 0; x < in_width; x++)
+          sums[neovideoconv->scale_xmap[x]] += rows[0][x];
+      }
+
+      for (x = 0; x < out_width; x++) {
+        guint64 n = (guint64) neovideoconv->scale_xcount[x] * (y1 - y0);
+
+        d[x] = (sums[x] + n / 2) / n;
+      }
+    } else {
+      gint64 sy = gst_neovideoconv_scale_coord (row, in_height, out_height);
+      gint y0 = sy >> 16;
+      gint y1 = MIN (y0 + 1, in_height - 1);
+      gint fy = (sy >> 8) & 0xff;
+
+      /* rows[0] holds y0 and rows[1] y1, moving up a row when possible */
+      if (loaded[0] != y0) {
+        if (loaded[1] == y0) {
+          guint8 *tmp = rows[0];
+
+          rows[0] = rows[1];
+          rows[1] = tmp;
+          loaded[1] = loaded[0];
+        } else {
+          gst_neovideoconv_scale_load_row (neovideoconv, inframe, y0, rows[0]);
+        }
+        loaded[0] = y0;
+      }
+      if (loaded[1] != y1) {
+        gst_neovideoconv_scale_load_row (neovideoconv, inframe, y1, rows[1]);
+        loaded[1] = y1;
+      }
+
+      for (x = 0; x < out_width; x++) {
+        gint x0 = neovideoconv->scale_xmap[x];
+        gint fx = neovideoconv->scale_xfrac[x];
+        guint top = rows[0][x0] * (256 - fx) + rows[0][x0 + 1] * fx;
+        guint bottom = rows[1][x0] * (256 - fx) + rows[1][x0 + 1] * fx;
+
+        d[x] = (top * (256 - fy) + bottom * fy + (1 << 15)) >> 16;
+      }
+    }
+
+    if (neovideoconv->analyzing)
+      gst_neovideoconv_analyze_rows (slice, row, row + 1);
+  }
+}
+
+/* transform */
+static void
+gst_neovideoconv_convert_slice (GstNeovideoconvSlice * slice)
+{
+  GstNeovideoconv *neovideoconv = slice->neovideoconv;
+  GstVideoFrame *inframe = slice->inframe;
+  GstVideoFrame *outframe = slice->outframe;
+  NeoToGray8Func to_gray8;
+  gint row, width;
+  gint row_stride, d_row_stride;
+  guint8 *src;
+  guint8 *dest;
+
+  if (neovideoconv->analyzing)
+    memset (slice->hist, 0, sizeof (slice->hist));
+
+  if (neovideoconv->scaling) {
+    gst_neovideoconv_convert_slice_scaled (slice);
+    return;
+  }
+  if (slice->regions) {
+    gst_neovideoconv_convert_slice_regions (slice);
+    return;
+  }
+  if (slice->incremental) {
+    gst_neovideoconv_convert_slice_tiles (slice);
+    return;
+  }
+
+  row_stride = GST_VIDEO_FRAME_PLANE_STRIDE (inframe, 0);
+  src = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (inframe, 0) +
+      slice->row_start * row_stride;
+  width = GST_VIDEO_FRAME_WIDTH (inframe);
+
+  /* in place: no output frame, the input rows are rewritten */
+  if (!outframe) {
+    for (row = slice->row_start; row < slice->row_end; row++) {
+      neovideoconv->desaturate (src, width, &neovideoconv->luma);
+      if (neovideoconv->analyzing)
+        gst_neovideoconv_analyze_rows (slice, row, row + 1);
+      src += row_stride;
+    }
+    return;
+  }
+
+  d_row_stride = GST_VIDEO_FRAME_PLANE_STRIDE (outframe, 0);
+  dest = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (outframe, 0) +
+      slice->row_start * d_row_stride;
+
+  /* one kernel call per row, the kernels handle the row tail themselves */
+  to_gray8 = neovideoconv->to_gray8_stream ? neovideoconv->to_gray8_stream :
+      neovideoconv->to_gray8;
+  for (row = slice->row_start; row < slice->row_end; row++) {
+    to_gray8 (dest, src, width, &neovideoconv->luma);
+    if (neovideoconv->analyzing)
+      gst_neovideoconv_analyze_rows (slice, row, row + 1);
+    src += row_stride;
+    dest += d_row_stride;
+  }
+}
+
+static void
+gst_neovideoconv_slice_func (gpointer data, gpointer user_data)
+{
+  GstNeovideoconvSlice *slice = data;
+  GstNeovideoconv *neovideoconv = user_data;
+
+  gst_neovideoconv_convert_slice (slice);
+
+  g_mutex_lock (&neovideoconv->slice_lock);
+  if (--neovideoconv->slices_pending == 0)
+    g_cond_signal (&neovideoconv->slice_cond);
+  g_mutex_unlock (&neovideoconv->slice_lock);
+}
+
+/* Fills @regions with the regions of interest of @frame, clipped to it.
+ * Returns FALSE when the whole frame is to be converted. */
+static gboolean
+gst_neovideoconv_collect_regions (GstNeovideoconv * neovideoconv,
+    GstVideoFrame * frame, GArray * regions)
+{
+  guint width = GST_VIDEO_FRAME_WIDTH (frame);
+  guint height = GST_VIDEO_FRAME_HEIGHT (frame);
+  gpointer state = NULL;
+  GstMeta *meta;
+
+  if (!neovideoconv->convert_regions)
+    return FALSE;
+
+  g_array_set_size (regions, 0);
+  while ((meta = gst_buffer_iterate_meta_filtered (frame->buffer, &state,
+              GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE))) {
+    GstVideoRegionOfInterestMeta *roi = (GstVideoRegionOfInterestMeta *) meta;
+    GstNeovideoconvRegion region;
+
+    if (roi->x >= width || roi->y >= height || roi->w == 0 || roi->h == 0)
+      continue;
+
+    region.x = roi->x;
+    region.y = roi->y;
+    region.width = MIN (roi->w, width - roi->x);
+    region.height = MIN (roi->h, height - roi->y);
+    g_array_append_val (regions, region);
+  }
+
+  GST_LOG_OBJECT (neovideoconv, "converting %u regions", regions->len);
+
+  return TRUE;
+}
+
+/* Converts @inframe into @outframe, or in place when @outframe is NULL,
+ * spreading the rows over the slice workers */
+static void
+gst_neovideoconv_run_slices (GstNeovideoconv * neovideoconv,
+    GstVideoFrame * inframe, GstVideoFrame * outframe)
+{
+  GstVideoFilter *filter = GST_VIDEO_FILTER (neovideoconv);
+  GArray *regions = NULL;
+  gboolean incremental;
+  gint height, n_slices, unit, n_units, i;
+
+  /* when scaling the slices are made of output rows, regions of interest
+   * don't apply then */
+  if (neovideoconv->scaling) {
+    height = GST_VIDEO_FRAME_HEIGHT (outframe);
+  } else {
+    height = GST_VIDEO_FRAME_HEIGHT (inframe);
+    if (gst_neovideoconv_collect_regions (neovideoconv, inframe,
+            neovideoconv->regions))
+      regions = neovideoconv->regions;
+  }
+
+  /* tiles are fingerprinted whole, so slices get whole tile rows then */
+  incremental = outframe && !regions && neovideoconv->tile_fingerprints;
+  unit = incremental ? TILE_SIZE : 1;
+  n_units = (height + unit - 1) / unit;
+
+  n_slices = MIN ((gint) neovideoconv->n_slices, height / MIN_SLICE_ROWS);
+  n_slices = CLAMP (n_slices, 1, n_units);
+
+  if (incremental && neovideoconv->retained_outbuf)
+    neovideoconv->have_prev_frame =
+        gst_video_frame_map (&neovideoconv->prev_frame, &filter->out_info,
+        neovideoconv->retained_outbuf, GST_MAP_READ);
+
+  /* spread the rows evenly, slice sizes differ by at most one unit */
+  for (i = 0; i < n_slices; i++) {
+    GstNeovideoconvSlice *slice = &neovideoconv->slices[i];
+
+    slice->neovideoconv = neovideoconv;
+    slice->inframe = inframe;
+    slice->outframe = outframe;
+    slice->regions = regions;
+    slice->incremental = incremental;
+    slice->row_start = MIN ((gint64) n_units * i / n_slices * unit, height);
+    slice->row_end = MIN ((gint64) n_units * (i + 1) / n_slices * unit,
+        height);
+    slice->tiles = slice->tiles_dirty = 0;
+  }
+
+  if (n_slices > 1) {
+    g_mutex_lock (&neovideoconv->slice_lock);
+    neovideoconv->slices_pending = n_slices - 1;
+    g_mutex_unlock (&neovideoconv->slice_lock);
+
+    for (i = 1; i < n_slices; i++)
+      neo_task_queue_push (neovideoconv->workers, &neovideoconv->slices[i]);
+  }
+
+  gst_neovideoconv_convert_slice (&neovideoconv->slices[0]);
+
+  if (n_slices > 1) {
+    g_mutex_lock (&neovideoconv->slice_lock);
+    while (neovideoconv->slices_pending > 0)
+      g_cond_wait (&neovideoconv->slice_cond, &neovideoconv->slice_lock);
+    g_mutex_unlock (&neovideoconv->slice_lock);
+  }
+
+  if (neovideoconv->have_prev_frame) {
+    gst_video_frame_unmap (&neovideoconv->prev_frame);
+    neovideoconv->have_prev_frame = FALSE;
+  }
+
+  if (neovideoconv->analyzing)
+    gst_neovideoconv_merge_histograms (neovideoconv, n_slices);
+
+  /* the fingerprints now describe this frame, keep its output to copy the
+   * unchanged tiles from. Output that doesn't match them is useless. */
+  if (incremental) {
+    for (i = 0; i < n_slices; i++) {
+      STAT_ADD (neovideoconv->stats.tiles_total, neovideoconv->slices[i].tiles);
+      STAT_ADD (neovideoconv->stats.tiles_dirty,
+          neovideoconv->slices[i].tiles_dirty);
+    }
+    gst_buffer_replace (&neovideoconv->retained_outbuf, outframe->buffer);
+  } else {
+    gst_clear_buffer (&neovideoconv->retained_outbuf);
+  }
+}
+
+static GstFlowReturn
+gst_neovideoconv_transform_frame (GstVideoFilter * filter,
+    GstVideoFrame * inframe, GstVideoFrame * outframe)
+{
+  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (filter);
+  GstClockTime start;
+
+  GST_LOG_OBJECT (neovideoconv, "transform_frame %p %p", inframe, outframe);
+
+  start = gst_util_get_timestamp ();
+  gst_neovideoconv_crop_frame (inframe, &filter->in_info);
+  gst_neovideoconv_run_slices (neovideoconv, inframe, outframe);
+  if (neovideoconv->chroma_fill)
+    gst_neovideoconv_fill_chroma (outframe, NULL);
+  if (neovideoconv->analyzing)
+    gst_neovideoconv_add_analysis_meta (neovideoconv->hist, outframe->buffer);
+  gst_neovideoconv_record_frame (neovideoconv,
+      gst_util_get_timestamp () - start, gst_buffer_get_size (inframe->buffer),
+      gst_buffer_get_size (outframe->buffer));
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_neovideoconv_transform_frame_ip (GstVideoFilter * filter,
+    GstVideoFrame * inframe)
+{
+  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (filter);
+  GstClockTime start;
+  gsize size;
+
+  GST_LOG_OBJECT (neovideoconv, "transform_frame_ip %p", inframe);
+
+  /* the buffer keeps its crop meta, only the visible area is converted */
+  start = gst_util_get_timestamp ();
+  gst_neovideoconv_crop_frame (inframe, &filter->in_info);
+  /* planar YUV in place only needs its chroma neutralised */
+  if (neovideoconv->desaturate)
+    gst_neovideoconv_run_slices (neovideoconv, inframe, NULL);
+  else if (neovideoconv->analyzing) {
+    gst_neovideoconv_analyze_plane (&neovideoconv->slices[0], inframe);
+    gst_neovideoconv_merge_histograms (neovideoconv, 1);
+  }
+  /* in place the chroma outside the regions of interest stays */
+  if (neovideoconv->chroma_fill)
+    gst_neovideoconv_fill_chroma (inframe,
+        gst_neovideoconv_collect_regions (neovideoconv, inframe,
+            neovideoconv->regions) ? neovideoconv->regions : NULL);
+  if (neovideoconv->analyzing)
+    gst_neovideoconv_add_analysis_meta (neovideoconv->hist, inframe->buffer);
+  size = gst_buffer_get_size (inframe->buffer);
+  gst_neovideoconv_record_frame (neovideoconv,
+      gst_util_get_timestamp () - start, size, size);
+
+  return GST_FLOW_OK;
+}
+
+/* Converts a frame of the asynchronous mode on a worker, as
+ * transform_frame or transform_frame_ip would with a single slice */
+static gboolean
+gst_neovideoconv_convert_frame (GstNeovideoconv * neovideoconv,
+    GstNeovideoconvFrame * frame)
+{
+  GstVideoFilter *filter = GST_VIDEO_FILTER (neovideoconv);
+  GstNeovideoconvSlice *slice = &frame->slice;
+  GstVideoFrame inframe, outframe;
+  gboolean in_place = frame->inbuf == NULL;
+  guint64 hist[256];
+
+  if (!gst_video_frame_map (&inframe, &filter->in_info,
+          in_place ? frame->outbuf : frame->inbuf,
+          in_place ? GST_MAP_READWRITE : GST_MAP_READ))
+    goto invalid_buffer;
+  if (!in_place && !gst_video_frame_map (&outframe, &filter->out_info,
+          frame->outbuf, GST_MAP_WRITE)) {
+    gst_video_frame_unmap (&inframe);
+    goto invalid_buffer;
+  }
+
+  gst_neovideoconv_crop_frame (&inframe, &filter->in_info);
+
+  slice->neovideoconv = neovideoconv;
+  slice->inframe = &inframe;
+  slice->outframe = in_place ? NULL : &outframe;
+  slice->regions = NULL;
+  slice->incremental = FALSE;
+  slice->row_start = 0;
+  if (neovideoconv->scaling) {
+    slice->row_end = GST_VIDEO_FRAME_HEIGHT (&outframe);
+  } else {
+    slice->row_end = GST_VIDEO_FRAME_HEIGHT (&inframe);
+    if (gst_neovideoconv_collect_regions (neovideoconv, &inframe,
+            frame->regions))
+      slice->regions = frame->regions;
+  }
+
+  /* planar YUV in place only needs its chroma neutralised */
+  if (!in_place || neovideoconv->desaturate)
+    gst_neovideoconv_convert_slice (slice);
+  else if (neovideoconv->analyzing)
+    gst_neovideoconv_analyze_plane (slice, &inframe);
+  if (neovideoconv->chroma_fill)
+    gst_neovideoconv_fill_chroma (in_place ? &inframe : &outframe,
+        in_place ? slice->regions : NULL);
+  if (neovideoconv->analyzing) {
+    memset (hist, 0, sizeof (hist));
+    gst_neovideoconv_sum_histogram (hist, slice);
+    gst_neovideoconv_add_analysis_meta (hist, frame->outbuf);
+  }
+
+  frame->bytes_in = gst_buffer_get_size (inframe.buffer);
+  frame->bytes_out = gst_buffer_get_size (frame->outbuf);
+  if (!in_place)
+    gst_video_frame_unmap (&outframe);
+  gst_video_frame_unmap (&inframe);
+
+  return TRUE;
+
+invalid_buffer:
+  GST_ELEMENT_WARNING (neovideoconv, CORE, NOT_IMPLEMENTED, (NULL),
+      ("invalid video buffer received"));
+  return FALSE;
+}
+
+static void
+gst_neovideoconv_frame_func (gpointer data, gpointer user_data)
+{
+  GstNeovideoconvFrame *frame = data;
+  GstNeovideoconv *neovideoconv = user_data;
+  GstClockTime start = gst_util_get_timestamp ();
+  gboolean converted;
+
+  converted = gst_neovideoconv_convert_frame (neovideoconv, frame);
+  /* upstream can have the input back before the frame leaves the queue */
+  gst_clear_buffer (&frame->inbuf);
+
+  g_mutex_lock (&neovideoconv->frame_lock);
+  frame->failed = !converted;
+  frame->time = gst_util_get_timestamp () - start;
+  frame->done = TRUE;
+  g_cond_signal (&neovideoconv->frame_cond);
+  g_mutex_unlock (&neovideoconv->frame_lock);
+}
+
+static void
+gst_neovideoconv_append_format (GValue * formats, GstVideoFormat format)
+{
+  GValue item = G_VALUE_INIT;
+  const gchar *name = gst_video_format_to_string (format);
+  guint i;
+
+  for (i = 0; i < gst_value_list_get_size (formats); i++) {
+    if (g_str_equal (g_value_get_string (gst_value_list_get_value (formats,
+                    i)), name))
+      return;
+  }
+
+  g_value_init (&item, G_TYPE_STRING);
+  g_value_set_string (&item, name);
+  gst_value_list_append_value (formats, &item);
+  g_value_unset (&item);
+}
+
+/* Adds the formats @format can be converted to (sink direction) or from
+ * (src direction), to @same_size for conversions keeping the frame size,
+ * to @scaled for those that may also downscale and to @deep for GRAY16.
+ * Packed RGB can pass through, any input can become GRAY8, GRAY16_LE, I420
+ * or NV12. Only the 8-bit luma outputs can be smaller than the input. */
+static void
+gst_neovideoconv_append_peer_formats (GValue * same_size, GValue * scaled,
+    GValue * deep, const gchar * format, GstPadDirection direction)
+{
+  GstVideoFormat f = gst_video_format_from_string (format);
+  gboolean packed = gst_neovideoconv_layout_from_format (f) >= 0;
+  guint i;
+
+  if (direction == GST_PAD_SINK) {
+    if (packed)
+      gst_neovideoconv_append_format (same_size, f);
+    else if (!gst_neovideoconv_is_planar_yuv (f))
+      return;
+    gst_neovideoconv_append_format (scaled, GST_VIDEO_FORMAT_GRAY8);
+    gst_neovideoconv_append_format (scaled, GST_VIDEO_FORMAT_I420);
+    gst_neovideoconv_append_format (scaled, GST_VIDEO_FORMAT_NV12);
+    gst_neovideoconv_append_format (deep, GST_VIDEO_FORMAT_GRAY16_LE);
+  } else if (f == GST_VIDEO_FORMAT_GRAY8 || f == GST_VIDEO_FORMAT_I420
+      || f == GST_VIDEO_FORMAT_NV12 || f == GST_VIDEO_FORMAT_GRAY16_LE) {
+    GValue *formats = f == GST_VIDEO_FORMAT_GRAY16_LE ? deep : scaled;
+
+    for (i = 0; i < G_N_ELEMENTS (packed_rgb_formats); i++)
+      gst_neovideoconv_append_format (formats, packed_rgb_formats[i]);
+    for (i = 0; i < G_N_ELEMENTS (planar_yuv_formats); i++)
+      gst_neovideoconv_append_format (formats, planar_yuv_formats[i]);
+  } else if (packed) {
+    gst_neovideoconv_append_format (same_size, f);
+  }
+}
+
+/* Opens up width and height of @structure to every size the other pad can
+ * have: up to the input size on the src side, from the output size on
+ * the sink side. The pixel aspect ratio then follows the scale factors. */
+static void
+gst_neovideoconv_widen_size (GstStructure * structure,
+    GstPadDirection direction)
+{
+  static const gchar *fields[] = { "width", "height" };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (fields); i++) {
+    const GValue *v = gst_structure_get_value (structure, fields[i]);
+    gint min, max;
+
+    if (!v)
+      continue;
+    if (G_VALUE_HOLDS_INT (v)) {
+      min = max = g_value_get_int (v);
+    } else if (GST_VALUE_HOLDS_INT_RANGE (v)) {
+      min = gst_value_get_int_range_min (v);
+      max = gst_value_get_int_range_max (v);
+    } else {
+      continue;
+    }
+
+    if (direction == GST_PAD_SINK)
+      min = 1;
+    else
+      max = G_MAXINT;
+
+    if (min < max)
+      gst_structure_set (structure, fields[i], GST_TYPE_INT_RANGE, min, max,
+          NULL);
+    else
+      gst_structure_set (structure, fields[i], G_TYPE_INT, min, NULL);
+  }
+
+  if (gst_structure_has_field (structure, "pixel-aspect-ratio"))
+    gst_structure_set (structure, "pixel-aspect-ratio",
+        GST_TYPE_FRACTION_RANGE, 1, G_MAXINT, G_MAXINT, 1, NULL);
+}
+
+/* Appends a copy of @structure with the formats in @formats, if any */
+static void
+gst_neovideoconv_append_peer_structure (GstCaps * caps,
+    const GstStructure * structure, GstCapsFeatures * features,
+    GValue * formats, gboolean scaled, GstPadDirection direction)
+{
+  GstStructure *peer;
+
+  if (gst_value_list_get_size (formats) == 0) {
+    g_value_unset (formats);
+    return;
+  }
+
+  peer = gst_structure_copy (structure);
+  gst_structure_take_value (peer, "format", formats);
+  if (scaled)
+    gst_neovideoconv_widen_size (peer, direction);
+
+  gst_caps_append_structure_full (caps, peer,
+      features ? gst_caps_features_copy (features) : NULL);
+}
+
+static GstCaps *
+gst_neovideoconv_transform_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * filter)
+{
+
+  GstNeovideoconv *neovideoconv = GST_NEOVIDEOCONV (trans);
+  GST_DEBUG_OBJECT (neovideoconv, "%s", __func__);
+  GstCaps *ret_caps = NULL, *temp_caps;
+  guint i, j;
+  GST_DEBUG_OBJECT (neovideoconv, "received caps %p : %" GST_PTR_FORMAT, caps,
+      caps);
+
+  //map the formats of every structure to the ones of the other pad, the
+  //same size ones first
+  temp_caps = gst_caps_new_empty ();
+  for (i = 0; i < gst_caps_get_size (caps); i++) {
+    GstStructure *structure;
+    GstCapsFeatures *features;
+    const GValue *format;
+    GValue same_size = G_VALUE_INIT;
+    GValue scaled = G_VALUE_INIT;
+    GValue deep = G_VALUE_INIT;
+
+    structure = gst_caps_get_structure (caps, i);
+    features = gst_caps_get_features (caps, i);
+    format = gst_structure_get_value (structure, "format");
+
+    if (!format) {
+      GstStructure *peer = gst_structure_copy (structure);
+
+      gst_caps_append_structure_full (temp_caps, gst_structure_copy (peer),
+          features ? gst_caps_features_copy (features) : NULL);
+      gst_neovideoconv_widen_size (peer, direction);
+      gst_caps_append_structure_full (temp_caps, peer,
+          features ? gst_caps_features_copy (features) : NULL);
+      continue;
+    }
+
+    gst_value_list_init (&same_size, G_N_ELEMENTS (packed_rgb_formats));
+    gst_value_list_init (&scaled, G_N_ELEMENTS (packed_rgb_formats) +
+        G_N_ELEMENTS (planar_yuv_formats) + 3);
+    gst_value_list_init (&deep, G_N_ELEMENTS (packed_rgb_formats) +
+        G_N_ELEMENTS (planar_yuv_formats));
+    if (GST_VALUE_HOLDS_LIST (format)) {
+      for (j = 0; j < gst_value_list_get_size (format); j++)
+        gst_neovideoconv_append_peer_formats (&same_size, &scaled, &deep,
+            g_value_get_string (gst_value_list_get_value (format, j)),
+            direction);
+    } else if (G_VALUE_HOLDS_STRING (format)) {
+      gst_neovideoconv_append_peer_formats (&same_size, &scaled, &deep,
+          g_value_get_string (format), direction);
+    }
+
+    gst_neovideoconv_append_peer_structure (temp_caps, structure, features,
+        &same_size, FALSE, direction);
+    gst_neovideoconv_append_peer_structure (temp_caps, structure, features,
+        &scaled, TRUE, direction);
+    gst_neovideoconv_append_peer_structure (temp_caps, structure, features,
+        &deep, FALSE, direction);
+  }
+  GST_DEBUG_OBJECT (neovideoconv, "%s temp %s caps are %" GST_PTR_FORMAT,
+      __func__, direction == GST_PAD_SINK ? "src" : "sink", temp_caps);
+
+  if (filter) {
+    GST_DEBUG_OBJECT (neovideoconv, "filter caps : %" GST_PTR_FORMAT, filter);
+    ret_caps =
+        gst_caps_intersect_full (temp_caps, filter, GST_CAPS_INTERSECT_FIRST);
+    gst_caps_unref (temp_caps);
+  } else {
+    ret_caps = temp_caps;
+  }
+
+  GST_DEBUG_OBJECT (neovideoconv, "caps %p : %" GST_PTR_FORMAT, ret_caps,
+      ret_caps);
+
+  return ret_caps;
+}
+
+/* Keeps the size of the other side when possible, and when it has to
+ * change picks the pixel aspect ratio that keeps the display aspect ratio */
+static GstCaps *
+gst_neovideoconv_fixate_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * othercaps)
+{
+  GstStructure *ins, *outs;
+  gint in_width, in_height, out_width, out_height, par_n, par_d;
+
+  othercaps = gst_caps_truncate (othercaps);
+  othercaps = gst_caps_make_writable (othercaps);
+  ins = gst_caps_get_structure (caps, 0);
+  outs = gst_caps_get_structure (othercaps, 0);
+
+  if (gst_structure_get_int (ins, "width", &in_width))
+    gst_structure_fixate_field_nearest_int (outs, "width", in_width);
+  if (gst_structure_get_int (ins, "height", &in_height))
+    gst_structure_fixate_field_nearest_int (outs, "height", in_height);
+
+  if (gst_structure_get_int (ins, "width", &in_width)
+      && gst_structure_get_int (ins, "height", &in_height)
+      && gst_structure_get_int (outs, "width", &out_width)
+      && gst_structure_get_int (outs, "height", &out_height)
+      && gst_structure_get_fraction (ins, "pixel-aspect-ratio", &par_n, &par_d)
+      && gst_structure_has_field (outs, "pixel-aspect-ratio")
+      && gst_util_fraction_multiply (par_n, par_d, in_width, out_width,
+          &par_n, &par_d)
+      && gst_util_fraction_multiply (par_n, par_d, out_height, in_height,
+          &par_n, &par_d))
+    gst_structure_fixate_field_nearest_fraction (outs, "pixel-aspect-ratio",
+        par_n, par_d);
+
+  GST_DEBUG_OBJECT (trans, "fixated to %" GST_PTR_FORMAT, othercaps);
+
+  return GST_BASE_TRANSFORM_CLASS (gst_neovideoconv_parent_class)->fixate_caps
+      (trans, direction, caps, othercaps);
+}
+
+static gboolean
+gst_neovideoconv_transform_meta (GstBaseTransform * trans, GstBuffer * outbuf,
+    GstMeta * meta, GstBuffer * inbuf)
+{
+  GstVideoFilter *filter = GST_VIDEO_FILTER (trans);
+
+  /* the output only holds the cropped area already */
+  if (meta->info->api == GST_VIDEO_CROP_META_API_TYPE)
+    return FALSE;
+
+  /* the analysis of the input doesn't describe the output */
+  if (gst_meta_info_is_custom (meta->info)
+      && gst_custom_meta_has_name ((GstCustomMeta *) meta,
+          GST_NEOVIDEOCONV_ANALYSIS_META_NAME))
+    return FALSE;
+
+  /* regions of interest stay valid in GRAY8, scaled along when the size
+   * changes */
+  if (meta->info->api == GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE) {
+    GstVideoMetaTransform transform = { &filter->in_info, &filter->out_info };
+
+    if (!GST_NEOVIDEOCONV (trans)->scaling)
+      return TRUE;
+
+    meta->info->transform_func (outbuf, meta, inbuf,
+        gst_video_meta_transform_scale_get_quark (), &transform);
+    return FALSE;
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (gst_neovideoconv_parent_class)->
+      transform_meta (trans, outbuf, meta, inbuf);
 }
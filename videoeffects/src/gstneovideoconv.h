@@ -23,6 +23,9 @@
 #include <gst/video/video.h>
 #include <gst/video/gstvideofilter.h>
 
+#include "neovideoconv-kernels.h"
+#include "neotaskpool.h"
+
 G_BEGIN_DECLS
 #define GST_TYPE_NEOVIDEOCONV   (gst_neovideoconv_get_type())
 #define GST_NEOVIDEOCONV(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_NEOVIDEOCONV,GstNeovideoconv))
@@ -31,11 +34,205 @@ G_BEGIN_DECLS
 #define GST_IS_NEOVIDEOCONV_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_NEOVIDEOCONV))
 typedef struct _GstNeovideoconv GstNeovideoconv;
 typedef struct _GstNeovideoconvClass GstNeovideoconvClass;
+typedef struct _GstNeovideoconvSlice GstNeovideoconvSlice;
+typedef struct _GstNeovideoconvStats GstNeovideoconvStats;
+typedef struct _GstNeovideoconvRegion GstNeovideoconvRegion;
+typedef struct _GstNeovideoconvFrame GstNeovideoconvFrame;
+
+typedef enum
+{
+  GST_NEOVIDEOCONV_SCALE_BOX,
+  GST_NEOVIDEOCONV_SCALE_BILINEAR,
+} GstNeovideoconvScaleMethod;
+
+/* a region of interest, clipped to the frame */
+struct _GstNeovideoconvRegion
+{
+  gint x;
+  gint y;
+  gint width;
+  gint height;
+};
+
+/* log-linear processing time histogram: 16 buckets per power of two
+ * nanoseconds up to 2^41 ns, longer times land in the last bucket */
+#define GST_NEOVIDEOCONV_TIME_SUB_BITS 4
+#define GST_NEOVIDEOCONV_TIME_MAX_BITS 41
+#define GST_NEOVIDEOCONV_TIME_BUCKETS \
+    ((GST_NEOVIDEOCONV_TIME_MAX_BITS - GST_NEOVIDEOCONV_TIME_SUB_BITS + 1) \
+        << GST_NEOVIDEOCONV_TIME_SUB_BITS)
+
+/* Name of the GstCustomMeta holding the analysis of a frame's luma when
+ * the analyze property is set. Its structure has the fields mean and
+ * variance (gdouble), min and max (guint) and histogram, a GBytes of 256
+ * native endian guint32 pixel counts. GRAY16 luma is binned and measured
+ * by its upper byte. */
+#define GST_NEOVIDEOCONV_ANALYSIS_META_NAME "GstNeovideoconvAnalysisMeta"
+
+/* a band of rows of the current frame, handled by one thread */
+struct _GstNeovideoconvSlice
+{
+  GstNeovideoconv *neovideoconv;
+  GstVideoFrame *inframe;
+  GstVideoFrame *outframe;
+  /* GstNeovideoconvRegion to convert, NULL for the whole frame */
+  GArray *regions;
+  /* whole tile rows, converting only tiles that changed */
+  gboolean incremental;
+  gint row_start;
+  gint row_end;
+  guint tiles;
+  guint tiles_dirty;
+  /* when scaling: converted source rows and column sums of one output row,
+   * owned by the slice */
+  guint8 *scale_rows;
+  guint64 *scale_sums;
+  /* when analyzing: luma histogram of the slice, split four ways so that
+   * consecutive equal values don't wait on each other's increment */
+  guint32 hist[4][256];
+};
+
+/* a frame queued in the asynchronous mode, converted whole by one worker */
+struct _GstNeovideoconvFrame
+{
+  /* the input, NULL when converted in place, and the output, owned by the
+   * frame until it leaves the queue */
+  GstBuffer *inbuf;
+  GstBuffer *outbuf;
+  /* FALSE for output that only needs to keep its place in the queue */
+  gboolean converting;
+  /* the whole frame as a single slice, with its own scaling rows and
+   * histogram, and its regions of interest */
+  GstNeovideoconvSlice slice;
+  GArray *regions;
+  /* set by the worker under frame_lock, failed when the buffers could
+   * not be mapped and the output was left unconverted */
+  gboolean done;
+  gboolean failed;
+  GstClockTime time;
+  gsize bytes_in;
+  gsize bytes_out;
+};
+
+/* Only ever touched with atomic operations, so the streaming thread
+ * never waits for a reader of the stats property. Times are in ns. */
+struct _GstNeovideoconvStats
+{
+  guint64 frames_processed;
+  guint64 frames_dropped;
+  guint64 bytes_in;
+  guint64 bytes_out;
+  guint64 time_total;
+  guint64 time_min;
+  guint64 time_max;
+  guint64 tiles_total;
+  guint64 tiles_dirty;
+  guint time_hist[GST_NEOVIDEOCONV_TIME_BUCKETS];
+};
 
 struct _GstNeovideoconv
 {
   GstVideoFilter base_neovideoconv;
 
+  const NeoKernels *kernels;
+  NeoToGray8Func to_gray8;
+  NeoDesaturateFunc desaturate;
+  /* to_gray8 bypassing the cache, for whole frames above stream_threshold,
+   * NULL otherwise */
+  NeoToGray8Func to_gray8_stream;
+  /* bytes per output luma sample, 2 when to_gray8 writes GRAY16_LE */
+  gint out_pstride;
+  /* the output has chroma planes, set to neutral 128 */
+  gboolean chroma_fill;
+  gboolean luma_only;
+  gboolean downstream_video_meta;
+  /* output buffer wrapping the input Y plane, not to be converted */
+  GstBuffer *wrapped_outbuf;
+
+  /* output buffers recycled by / newly allocated from the pool */
+  guint64 pool_hits;
+  guint64 pool_misses;
+
+  /* properties */
+  guint n_threads;
+  NeoLumaMethod method;
+  guint stats_interval;
+  gboolean roi;
+  gint64 stream_threshold;
+  gboolean analyze;
+  guint async_depth;
+  gboolean memfd;
+
+  /* output allocator when memfd is set and supported, READY to NULL */
+  GstAllocator *memfd_allocator;
+
+  /* histogram of the converted luma is collected, streaming thread only,
+   * hist holds the one of the whole frame once it is converted */
+  gboolean analyzing;
+  guint64 hist[256];
+
+  /* regions of interest of the current frame, streaming thread only */
+  gboolean convert_regions;
+  GArray *regions;
+
+  /* incremental mode: input fingerprint per tile and the output of the
+   * frame they were taken from, streaming thread only */
+  gboolean incremental;
+  gboolean convert_incremental;
+  gint tiles_x;
+  gint tiles_y;
+  guint64 *tile_fingerprints;
+  GstBuffer *retained_outbuf;
+  GstVideoFrame prev_frame;
+  gboolean have_prev_frame;
+
+  /* output smaller than the input, filtered while converting. For box
+   * scale_xmap is the output column of each input column and scale_xcount
+   * the number of input columns per output column, for bilinear
+   * scale_xmap is the left input column of each output column and
+   * scale_xfrac the weight of the right one out of 256. */
+  GstNeovideoconvScaleMethod scale_method;
+  gboolean scaling;
+  gint *scale_xmap;
+  gint *scale_xcount;
+  gint *scale_xfrac;
+
+  GstNeovideoconvStats stats;
+  /* name of the row function in use, for the stats */
+  const gchar *active_kernel;
+  GstClockTime last_stats_post;
+
+  /* from the last QoS event, protected by the object lock */
+  gdouble qos_proportion;
+  GstClockTime qos_earliest_time;
+  /* streaming thread only: share of a frame owed to conversion while
+   * shedding frames by proportion */
+  gdouble qos_credit;
+
+  /* weights and lookup tables of the method, built in set_info */
+  NeoLuma luma;
+
+  /* queue of the slice tasks on the shared workers, between start and
+   * stop */
+  NeoTaskQueue *workers;
+  guint n_slices;
+  GstNeovideoconvSlice *slices;
+  GMutex slice_lock;
+  GCond slice_cond;
+  guint slices_pending;
+
+  /* asynchronous mode, between start and stop: the workers convert whole
+   * frames, queued in arrival order in a ring of frames_max from
+   * frames_head and passed on in that order once converted. The ring is
+   * only changed by the streaming thread, done by the workers. */
+  GstNeovideoconvFrame *frames;
+  guint frames_max;
+  guint frames_head;
+  guint frames_queued;
+  /* transform queued the frame of the output being generated */
+  gboolean frame_queued;
+  GMutex frame_lock;
+  GCond frame_cond;
 };
 
 struct _GstNeovideoconvClass
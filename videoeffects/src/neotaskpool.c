@@ -0,0 +1,369 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_SCHED_SETAFFINITY
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <sched.h>
+#endif
+
+#include <gst/gst.h>
+#include "neotaskpool.h"
+
+GST_DEBUG_CATEGORY_STATIC (neo_task_pool_debug_category);
+#define GST_CAT_DEFAULT neo_task_pool_debug_category
+
+#define MAX_THREADS 1024
+
+struct _NeoTaskQueue
+{
+  NeoTaskFunc func;
+  gpointer user_data;
+  guint max_running;
+
+  /* protected by the pool lock */
+  GQueue tasks;
+  guint running;
+  /* link in the ready queue of the pool, while tasks is not empty and
+   * fewer than max_running are running */
+  GList ready_link;
+  gboolean ready;
+  /* signalled when tasks is empty and running is 0 */
+  GCond idle_cond;
+};
+
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+
+  /* from plugin_init */
+  gboolean initialized;
+  guint n_threads;
+  GArray *cpus;
+
+  /* the workers, started by the first queue */
+  GThread **threads;
+  guint n_started;
+  gint64 start_time;
+
+  /* queues with tasks waiting, the one to take a task from next first */
+  GQueue ready;
+
+  guint n_queues;
+  guint queue_depth;
+  guint max_queue_depth;
+  guint64 tasks_run;
+  /* time spent running tasks in us, of the finished ones */
+  gint64 busy_time;
+} NeoTaskPool;
+
+/* a static GMutex and GCond need no initialization */
+static NeoTaskPool pool;
+
+/* Parses a CPU list such as "0-3,6" into @cpus. Returns FALSE if it is
+ * malformed. */
+static gboolean
+neo_task_pool_parse_cpus (const gchar * list, GArray * cpus)
+{
+  gchar **ranges = g_strsplit (list, ",", -1);
+  gboolean ret = TRUE;
+  guint i;
+
+  for (i = 0; ranges[i] && ret; i++) {
+    gchar *range = g_strstrip (ranges[i]);
+    gchar *end;
+    guint64 first, last, cpu;
+
+    if (*range == '\0')
+      continue;
+
+    first = g_ascii_strtoull (range, &end, 10);
+    last = first;
+    if (end == range) {
+      ret = FALSE;
+      break;
+    }
+    if (*end == '-') {
+      range = end + 1;
+      last = g_ascii_strtoull (range, &end, 10);
+      if (end == range)
+        ret = FALSE;
+    }
+    if (*end != '\0' || last < first || last >= 1024)
+      ret = FALSE;
+
+    for (cpu = first; ret && cpu <= last; cpu++) {
+      guint c = cpu;
+
+      g_array_append_val (cpus, c);
+    }
+  }
+  g_strfreev (ranges);
+
+  return ret;
+}
+
+static void
+neo_task_pool_set_affinity (void)
+{
+#ifdef HAVE_SCHED_SETAFFINITY
+  cpu_set_t set;
+  guint i;
+
+  CPU_ZERO (&set);
+  for (i = 0; i < pool.cpus->len; i++) {
+    guint cpu = g_array_index (pool.cpus, guint, i);
+
+    if (cpu < CPU_SETSIZE)
+      CPU_SET (cpu, &set);
+  }
+
+  /* 0 is the calling thread on Linux */
+  if (sched_setaffinity (0, sizeof (set), &set) < 0)
+    GST_WARNING ("could not set the CPU affinity of a worker: %s",
+        g_strerror (errno));
+#endif
+}
+
+/* Puts @queue in line for the workers if it has a task it may run, with
+ * the pool lock held */
+static void
+neo_task_queue_update_ready (NeoTaskQueue * queue)
+{
+  if (queue->ready || g_queue_is_empty (&queue->tasks)
+      || queue->running >= queue->max_running)
+    return;
+
+  g_queue_push_tail_link (&pool.ready, &queue->ready_link);
+  queue->ready = TRUE;
+  g_cond_signal (&pool.cond);
+}
+
+static gpointer
+neo_task_pool_worker (gpointer data)
+{
+  if (pool.cpus)
+    neo_task_pool_set_affinity ();
+
+  g_mutex_lock (&pool.lock);
+  for (;;) {
+    NeoTaskQueue *queue;
+    gpointer task;
+    gint64 start;
+
+    while (g_queue_is_empty (&pool.ready))
+      g_cond_wait (&pool.cond, &pool.lock);
+
+    /* one task per queue and round, the queue gets back in line at the end
+     * while it has tasks it may run */
+    queue = g_queue_pop_head_link (&pool.ready)->data;
+    task = g_queue_pop_head (&queue->tasks);
+    queue->running++;
+    queue->ready = FALSE;
+    neo_task_queue_update_ready (queue);
+    pool.queue_depth--;
+    g_mutex_unlock (&pool.lock);
+
+    start = g_get_monotonic_time ();
+    queue->func (task, queue->user_data);
+
+    g_mutex_lock (&pool.lock);
+    pool.busy_time += g_get_monotonic_time () - start;
+    pool.tasks_run++;
+    queue->running--;
+    neo_task_queue_update_ready (queue);
+    if (queue->running == 0 && g_queue_is_empty (&queue->tasks))
+      g_cond_broadcast (&queue->idle_cond);
+  }
+
+  return NULL;
+}
+
+/* Starts the workers, with the pool lock held. They live as long as the
+ * process, as a plugin is never unloaded. */
+static gboolean
+neo_task_pool_start (GError ** error)
+{
+  GError *err = NULL;
+  guint i;
+
+  if (pool.n_started > 0)
+    return TRUE;
+
+  pool.threads = g_new0 (GThread *, pool.n_threads);
+  for (i = 0; i < pool.n_threads; i++) {
+    gchar *name = g_strdup_printf ("neotask%u", i);
+
+    pool.threads[i] = g_thread_try_new (name, neo_task_pool_worker, NULL,
+        &err);
+    g_free (name);
+    if (!pool.threads[i])
+      break;
+    pool.n_started++;
+  }
+
+  /* fewer workers are fine, none is not */
+  if (pool.n_started == 0) {
+    g_propagate_error (error, err);
+    g_clear_pointer (&pool.threads, g_free);
+    return FALSE;
+  }
+  if (err) {
+    GST_WARNING ("started %u of %u workers: %s", pool.n_started,
+        pool.n_threads, err->message);
+    g_clear_error (&err);
+  }
+
+  pool.start_time = g_get_monotonic_time ();
+  GST_INFO ("started %u workers", pool.n_started);
+
+  return TRUE;
+}
+
+/* Reads the size and affinity of the pool from the environment. Called by
+ * plugin_init, any later call does nothing. */
+void
+neo_task_pool_init (void)
+{
+  const gchar *env;
+
+  g_mutex_lock (&pool.lock);
+  if (pool.initialized) {
+    g_mutex_unlock (&pool.lock);
+    return;
+  }
+
+  GST_DEBUG_CATEGORY_INIT (neo_task_pool_debug_category, "neotaskpool", 0,
+      "worker pool shared by the videoeffects elements");
+
+  g_queue_init (&pool.ready);
+
+  pool.n_threads = g_get_num_processors ();
+  env = g_getenv ("NEOVIDEOEFFECTS_THREADS");
+  if (env && *env) {
+    gchar *end;
+    guint64 n = g_ascii_strtoull (env, &end, 10);
+
+    if (*end == '\0' && n > 0)
+      pool.n_threads = MIN (n, MAX_THREADS);
+    else
+      GST_WARNING ("ignoring invalid NEOVIDEOEFFECTS_THREADS=%s", env);
+  }
+
+  env = g_getenv ("NEOVIDEOEFFECTS_AFFINITY");
+  if (env && *env) {
+#ifdef HAVE_SCHED_SETAFFINITY
+    pool.cpus = g_array_new (FALSE, FALSE, sizeof (guint));
+    if (!neo_task_pool_parse_cpus (env, pool.cpus) || pool.cpus->len == 0) {
+      GST_WARNING ("ignoring invalid NEOVIDEOEFFECTS_AFFINITY=%s", env);
+      g_clear_pointer (&pool.cpus, g_array_unref);
+    }
+#else
+    GST_WARNING ("CPU affinity is not supported, ignoring "
+        "NEOVIDEOEFFECTS_AFFINITY");
+#endif
+  }
+
+  GST_INFO ("%u workers%s%s", pool.n_threads, pool.cpus ? " on CPUs " : "",
+      pool.cpus ? env : "");
+
+  pool.initialized = TRUE;
+  g_mutex_unlock (&pool.lock);
+}
+
+void
+neo_task_pool_get_counters (NeoTaskPoolCounters * counters)
+{
+  gint64 elapsed;
+
+  g_mutex_lock (&pool.lock);
+  counters->n_threads = pool.n_started > 0 ? pool.n_started : pool.n_threads;
+  counters->n_queues = pool.n_queues;
+  counters->queue_depth = pool.queue_depth;
+  counters->max_queue_depth = pool.max_queue_depth;
+  counters->tasks_run = pool.tasks_run;
+  elapsed = pool.n_started > 0 ?
+      (g_get_monotonic_time () - pool.start_time) * pool.n_started : 0;
+  counters->utilization = elapsed > 0 ?
+      MIN ((gdouble) pool.busy_time / elapsed, 1.0) : 0.0;
+  g_mutex_unlock (&pool.lock);
+}
+
+/* Creates the queue of an element instance, whose tasks @func runs with
+ * @user_data on up to @max_running workers at a time. Starts the workers
+ * if this is the first queue and fails if none could be started. */
+NeoTaskQueue *
+neo_task_queue_new (NeoTaskFunc func, gpointer user_data, guint max_running,
+    GError ** error)
+{
+  NeoTaskQueue *queue;
+
+  g_return_val_if_fail (pool.initialized, NULL);
+
+  g_mutex_lock (&pool.lock);
+  if (!neo_task_pool_start (error)) {
+    g_mutex_unlock (&pool.lock);
+    return NULL;
+  }
+  pool.n_queues++;
+  g_mutex_unlock (&pool.lock);
+
+  queue = g_new0 (NeoTaskQueue, 1);
+  queue->func = func;
+  queue->user_data = user_data;
+  queue->max_running = MAX (max_running, 1);
+  g_queue_init (&queue->tasks);
+  queue->ready_link.data = queue;
+  g_cond_init (&queue->idle_cond);
+
+  return queue;
+}
+
+/* Queues a task running the function of @queue with @data */
+void
+neo_task_queue_push (NeoTaskQueue * queue, gpointer data)
+{
+  g_mutex_lock (&pool.lock);
+  g_queue_push_tail (&queue->tasks, data);
+  pool.queue_depth++;
+  pool.max_queue_depth = MAX (pool.max_queue_depth, pool.queue_depth);
+  neo_task_queue_update_ready (queue);
+  g_mutex_unlock (&pool.lock);
+}
+
+/* Waits until the tasks of @queue have run and frees it */
+void
+neo_task_queue_free (NeoTaskQueue * queue)
+{
+  g_mutex_lock (&pool.lock);
+  while (queue->running > 0 || !g_queue_is_empty (&queue->tasks))
+    g_cond_wait (&queue->idle_cond, &pool.lock);
+  pool.n_queues--;
+  g_mutex_unlock (&pool.lock);
+
+  g_cond_clear (&queue->idle_cond);
+  g_free (queue);
+}
@@ -0,0 +1,71 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _NEOTASKPOOL_H_
+#define _NEOTASKPOOL_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* One pool of worker threads shared by every element of the plugin in the
+ * process, set up by plugin_init. Its size is NEOVIDEOEFFECTS_THREADS,
+ * the number of processors by default, and NEOVIDEOEFFECTS_AFFINITY
+ * optionally restricts the workers to a list of CPUs such as "0-3,6". The
+ * threads are started by the first queue created, so merely loading the
+ * plugin, e.g. in the registry scanner, starts none.
+ *
+ * Each element instance pushes its tasks to a queue of its own, which runs
+ * at most max_running of them at a time, its n-threads. The workers take
+ * one task from each queue with pending tasks in turn, so an instance
+ * splitting frames into many slices can't hold back the others for longer
+ * than one task each. Tasks must not wait for other tasks. */
+
+typedef struct _NeoTaskQueue NeoTaskQueue;
+typedef struct _NeoTaskPoolCounters NeoTaskPoolCounters;
+
+/* called by a worker with the data of the task and the user_data of its
+ * queue, like a GFunc of a GThreadPool */
+typedef void (*NeoTaskFunc) (gpointer data, gpointer user_data);
+
+struct _NeoTaskPoolCounters
+{
+  guint n_threads;
+  /* queues created and not freed yet, one per running element */
+  guint n_queues;
+  /* tasks waiting for a worker, now and at most so far */
+  guint queue_depth;
+  guint max_queue_depth;
+  /* tasks run to completion so far */
+  guint64 tasks_run;
+  /* share of the time of the workers spent running tasks since they were
+   * started, 0.0 to 1.0 */
+  gdouble utilization;
+};
+
+void neo_task_pool_init (void);
+void neo_task_pool_get_counters (NeoTaskPoolCounters * counters);
+
+NeoTaskQueue *neo_task_queue_new (NeoTaskFunc func, gpointer user_data,
+    guint max_running, GError ** error);
+void neo_task_queue_push (NeoTaskQueue * queue, gpointer data);
+void neo_task_queue_free (NeoTaskQueue * queue);
+
+G_END_DECLS
+#endif
@@ -0,0 +1,595 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <immintrin.h>
+
+#include "neovideoconv-kernels.h"
+
+/* Loads 8 packed pixels, 4 per 128-bit lane. For 3-byte pixels each lane
+ * load reads 16 bytes of which only the first 12 are used, so the caller
+ * has to leave 4 bytes of slack after the last pixel. */
+static inline __m256i
+neo_load8_avx2 (const guint8 * src, gint pstride)
+{
+  __m256i v;
+
+  if (pstride == 4)
+    return _mm256_loadu_si256 ((const __m256i *) src);
+
+  v = _mm256_castsi128_si256 (_mm_loadu_si128 ((const __m128i *) src));
+  return _mm256_inserti128_si256 (v,
+      _mm_loadu_si128 ((const __m128i *) (src + 12)), 1);
+}
+
+/* 8 pixels to 8 luma values in 32-bit lanes. @shuf_rg gathers (r, g) pairs
+ * zero-extended to 16 bits, so one pmaddwd gives their weighted sum, and
+ * @shuf_r, @shuf_g, @shuf_b each component zero-extended to 32 bits. */
+static inline __m256i
+neo_luma_epi32_avx2 (__m256i px, __m256i shuf_rg, __m256i shuf_r,
+    __m256i shuf_g, __m256i shuf_b, const NeoLuma * luma)
+{
+  __m256i acc, b;
+
+  b = _mm256_shuffle_epi8 (px, shuf_b);
+
+  if (luma->lightness) {
+    __m256i r = _mm256_shuffle_epi8 (px, shuf_r);
+    __m256i g = _mm256_shuffle_epi8 (px, shuf_g);
+    __m256i lo = _mm256_min_epi32 (r, _mm256_min_epi32 (g, b));
+    __m256i hi = _mm256_max_epi32 (r, _mm256_max_epi32 (g, b));
+
+    acc = _mm256_add_epi32 (_mm256_add_epi32 (lo, hi), _mm256_set1_epi32 (1));
+    return _mm256_srli_epi32 (acc, 1);
+  }
+
+  acc = _mm256_madd_epi16 (_mm256_shuffle_epi8 (px, shuf_rg),
+      _mm256_set1_epi32 ((luma->weights[1] << 16) | luma->weights[0]));
+  acc = _mm256_add_epi32 (acc,
+      _mm256_madd_epi16 (b, _mm256_set1_epi32 (luma->weights[2])));
+  acc = _mm256_add_epi32 (acc, _mm256_set1_epi32 (NEO_LUMA_ROUND));
+
+  return _mm256_srli_epi32 (acc, NEO_LUMA_SHIFT);
+}
+
+/* pshufb indices gathering components of the 4 pixels in a lane */
+#define NEO_SHUF_PAIR(ps, c0, c1) \
+    (c0), -1, (c1), -1, (ps) + (c0), -1, (ps) + (c1), -1, \
+    2 * (ps) + (c0), -1, 2 * (ps) + (c1), -1, \
+    3 * (ps) + (c0), -1, 3 * (ps) + (c1), -1
+#define NEO_SHUF_SINGLE(ps, c) \
+    (c), -1, -1, -1, (ps) + (c), -1, -1, -1, \
+    2 * (ps) + (c), -1, -1, -1, 3 * (ps) + (c), -1, -1, -1
+#define NEO_SHUF(shuf) _mm256_setr_epi8 (shuf, shuf)
+
+#define NEO_LUMA8_AVX2(s, ps) \
+    neo_luma_epi32_avx2 (neo_load8_avx2 ((s), (ps)), shuf_rg, shuf_r, \
+        shuf_g, shuf_b, luma)
+
+/* 3-byte layouts need +2 pixels of slack for the over-read of the last
+ * lane load */
+#define NEO_DEFINE_AVX2(isa, name, pstride, r, g, b) \
+void \
+neo_##name##_to_gray8_avx2 (guint8 * dest, const guint8 * src, gint width, \
+    const NeoLuma * luma) \
+{ \
+  const __m256i shuf_rg = NEO_SHUF (NEO_SHUF_PAIR (pstride, r, g)); \
+  const __m256i shuf_r = NEO_SHUF (NEO_SHUF_SINGLE (pstride, r)); \
+  const __m256i shuf_g = NEO_SHUF (NEO_SHUF_SINGLE (pstride, g)); \
+  const __m256i shuf_b = NEO_SHUF (NEO_SHUF_SINGLE (pstride, b)); \
+  /* undoes the lane interleaving of the two pack steps */ \
+  const __m256i order = _mm256_setr_epi32 (0, 4, 1, 5, 2, 6, 3, 7); \
+  const gint slack = pstride == 3 ? 2 : 0; \
+  gint i = 0; \
+  \
+  for (; i + 32 + slack <= width; i += 32) { \
+    const guint8 *s = src + i * pstride; \
+    __m256i p01, p23; \
+    \
+    p01 = _mm256_packs_epi32 (NEO_LUMA8_AVX2 (s, pstride), \
+        NEO_LUMA8_AVX2 (s + 8 * pstride, pstride)); \
+    p23 = _mm256_packs_epi32 (NEO_LUMA8_AVX2 (s + 16 * pstride, pstride), \
+        NEO_LUMA8_AVX2 (s + 24 * pstride, pstride)); \
+    _mm256_storeu_si256 ((__m256i *) (dest + i), \
+        _mm256_permutevar8x32_epi32 (_mm256_packus_epi16 (p01, p23), order)); \
+  } \
+  \
+  if (i < width) \
+    neo_##name##_to_gray8_scalar (dest + i, src + i * pstride, width - i, \
+        luma); \
+}
+
+NEO_DEFINE_LAYOUTS (NEO_DEFINE_AVX2, avx2)
+
+/* vmovntdq needs 32-byte aligned destinations, the unaligned head and the
+ * tail use regular stores */
+void
+neo_stream_copy_avx2 (guint8 * dest, const guint8 * src, gint n)
+{
+  gint i = 0;
+
+  for (; i < n && ((guintptr) (dest + i) & 31); i++)
+    dest[i] = src[i];
+  for (; i + 32 <= n; i += 32)
+    _mm256_stream_si256 ((__m256i *) (dest + i),
+        _mm256_loadu_si256 ((const __m256i *) (src + i)));
+  for (; i < n; i++)
+    dest[i] = src[i];
+}
+
+void
+neo_stream_fence_avx2 (void)
+{
+  _mm_sfence ();
+}
+
+/* One output byte of 16 pixels, @p01 and @p23 holding bytes 0/1 and 2/3
+ * of each pixel as 16-bit pairs. Everything stays within 128-bit lanes,
+ * so the pixel order comes out as it went in. */
+static inline __m256i
+neo_matrix_row_avx2 (__m256i p01_lo, __m256i p01_hi, __m256i p23_lo,
+    __m256i p23_hi, const NeoColorMatrix * m, gint k)
+{
+  const __m256i c01 = _mm256_set1_epi32 (
+      ((guint32) (guint16) m->coeffs[k][1] << 16) |
+      (guint16) m->coeffs[k][0]);
+  const __m256i c23 = _mm256_set1_epi32 (
+      ((guint32) (guint16) m->coeffs[k][3] << 16) |
+      (guint16) m->coeffs[k][2]);
+  const __m256i offset = _mm256_set1_epi32 (m->offsets[k]);
+  __m256i lo, hi;
+
+  lo = _mm256_add_epi32 (_mm256_madd_epi16 (p01_lo, c01),
+      _mm256_madd_epi16 (p23_lo, c23));
+  hi = _mm256_add_epi32 (_mm256_madd_epi16 (p01_hi, c01),
+      _mm256_madd_epi16 (p23_hi, c23));
+  lo = _mm256_srai_epi32 (_mm256_add_epi32 (lo, offset), NEO_MATRIX_SHIFT);
+  hi = _mm256_srai_epi32 (_mm256_add_epi32 (hi, offset), NEO_MATRIX_SHIFT);
+
+  lo = _mm256_packs_epi32 (lo, hi);
+  return _mm256_packus_epi16 (lo, lo);
+}
+
+#define NEO_EXTRACT4_EPI16_AVX2(v0, v1, c) \
+    _mm256_packs_epi32 ( \
+        _mm256_and_si256 (_mm256_srli_epi32 ((v0), (c) * 8), \
+            _mm256_set1_epi32 (0xff)), \
+        _mm256_and_si256 (_mm256_srli_epi32 ((v1), (c) * 8), \
+            _mm256_set1_epi32 (0xff)))
+
+void
+neo_color_matrix32_avx2 (guint8 * data, gint width,
+    const NeoColorMatrix * matrix)
+{
+  gint i = 0;
+
+  for (; i + 16 <= width; i += 16) {
+    guint8 *d = data + i * 4;
+    __m256i v0 = _mm256_loadu_si256 ((const __m256i *) d);
+    __m256i v1 = _mm256_loadu_si256 ((const __m256i *) (d + 32));
+    __m256i b0 = NEO_EXTRACT4_EPI16_AVX2 (v0, v1, 0);
+    __m256i b1 = NEO_EXTRACT4_EPI16_AVX2 (v0, v1, 1);
+    __m256i b2 = NEO_EXTRACT4_EPI16_AVX2 (v0, v1, 2);
+    __m256i b3 = NEO_EXTRACT4_EPI16_AVX2 (v0, v1, 3);
+    __m256i p01_lo = _mm256_unpacklo_epi16 (b0, b1);
+    __m256i p01_hi = _mm256_unpackhi_epi16 (b0, b1);
+    __m256i p23_lo = _mm256_unpacklo_epi16 (b2, b3);
+    __m256i p23_hi = _mm256_unpackhi_epi16 (b2, b3);
+    __m256i o0, o1, o2, o3, o01, o23;
+
+    o0 = neo_matrix_row_avx2 (p01_lo, p01_hi, p23_lo, p23_hi, matrix, 0);
+    o1 = neo_matrix_row_avx2 (p01_lo, p01_hi, p23_lo, p23_hi, matrix, 1);
+    o2 = neo_matrix_row_avx2 (p01_lo, p01_hi, p23_lo, p23_hi, matrix, 2);
+    o3 = neo_matrix_row_avx2 (p01_lo, p01_hi, p23_lo, p23_hi, matrix, 3);
+
+    o01 = _mm256_unpacklo_epi8 (o0, o1);
+    o23 = _mm256_unpacklo_epi8 (o2, o3);
+    _mm256_storeu_si256 ((__m256i *) d, _mm256_unpacklo_epi16 (o01, o23));
+    _mm256_storeu_si256 ((__m256i *) (d + 32),
+        _mm256_unpackhi_epi16 (o01, o23));
+  }
+
+  if (i < width)
+    neo_color_matrix32_scalar (data + i * 4, width - i, matrix);
+}
+
+#define NEO_LOAD16_EPU8_AVX2(p) \
+    _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *) (p)))
+
+/* packus works within 128-bit lanes, the permute puts the two 8-byte
+ * halves of @v next to each other */
+static inline __m128i
+neo_pack16_avx2 (__m256i v)
+{
+  return _mm256_castsi256_si128 (_mm256_permute4x64_epi64
+      (_mm256_packus_epi16 (v, v), 0xd8));
+}
+
+/* 16 bytes widened to 16-bit lanes at a time, the sums fit unsigned
+ * 16 bits as with SSE2 */
+void
+neo_conv_row_avx2 (gint16 * dest, const guint8 * src, gint n, gint step,
+    const gint16 * taps, gint radius)
+{
+  const __m256i round = _mm256_set1_epi16 (1 << (NEO_CONV_ROW_SHIFT - 1));
+  __m256i t[2 * NEO_CONV_MAX_RADIUS + 1];
+  gint n_taps = 2 * radius + 1;
+  gint i = 0, k;
+
+  for (k = 0; k < n_taps; k++)
+    t[k] = _mm256_set1_epi16 (taps[k]);
+
+  for (; i + 32 <= n; i += 32) {
+    const guint8 *s = src + i - radius * step;
+    __m256i lo = round, hi = round;
+
+    for (k = 0; k < n_taps; k++) {
+      lo = _mm256_add_epi16 (lo,
+          _mm256_mullo_epi16 (NEO_LOAD16_EPU8_AVX2 (s + k * step), t[k]));
+      hi = _mm256_add_epi16 (hi,
+          _mm256_mullo_epi16 (NEO_LOAD16_EPU8_AVX2 (s + k * step + 16),
+              t[k]));
+    }
+    _mm256_storeu_si256 ((__m256i *) (dest + i),
+        _mm256_srli_epi16 (lo, NEO_CONV_ROW_SHIFT));
+    _mm256_storeu_si256 ((__m256i *) (dest + i + 16),
+        _mm256_srli_epi16 (hi, NEO_CONV_ROW_SHIFT));
+  }
+
+  if (i < n)
+    neo_conv_row_scalar (dest + i, src + i, n - i, step, taps, radius);
+}
+
+/* Same pairing of rows as SSE2. The unpacks and packs all stay within
+ * 128-bit lanes, only the final byte pack needs the lanes reordered. */
+void
+neo_conv_column_avx2 (guint8 * dest, const gint16 * const *rows, gint n,
+    const gint16 * taps, gint radius)
+{
+  const __m256i round =
+      _mm256_set1_epi32 (1 << (NEO_CONV_COLUMN_SHIFT - 1));
+  __m256i pairs[NEO_CONV_MAX_RADIUS + 1];
+  gint n_taps = 2 * radius + 1;
+  gint i = 0, k, h;
+
+  for (k = 0; k < n_taps; k += 2) {
+    gint16 next = k + 1 < n_taps ? taps[k + 1] : 0;
+
+    pairs[k / 2] = _mm256_set1_epi32 (((guint32) (guint16) next << 16) |
+        (guint16) taps[k]);
+  }
+
+  for (; i + 32 <= n; i += 32) {
+    __m256i acc[4] = { round, round, round, round };
+    __m256i lo, hi;
+
+    for (k = 0; k < n_taps; k += 2) {
+      const gint16 *r0 = rows[k];
+      const gint16 *r1 = rows[k + 1 < n_taps ? k + 1 : k];
+
+      for (h = 0; h < 2; h++) {
+        __m256i a = _mm256_loadu_si256 ((const __m256i *) (r0 + i + 16 * h));
+        __m256i b = _mm256_loadu_si256 ((const __m256i *) (r1 + i + 16 * h));
+
+        acc[2 * h] = _mm256_add_epi32 (acc[2 * h],
+            _mm256_madd_epi16 (_mm256_unpacklo_epi16 (a, b), pairs[k / 2]));
+        acc[2 * h + 1] = _mm256_add_epi32 (acc[2 * h + 1],
+            _mm256_madd_epi16 (_mm256_unpackhi_epi16 (a, b), pairs[k / 2]));
+      }
+    }
+
+    lo = _mm256_packs_epi32 (_mm256_srai_epi32 (acc[0],
+            NEO_CONV_COLUMN_SHIFT), _mm256_srai_epi32 (acc[1],
+            NEO_CONV_COLUMN_SHIFT));
+    hi = _mm256_packs_epi32 (_mm256_srai_epi32 (acc[2],
+            NEO_CONV_COLUMN_SHIFT), _mm256_srai_epi32 (acc[3],
+            NEO_CONV_COLUMN_SHIFT));
+    _mm256_storeu_si256 ((__m256i *) (dest + i),
+        _mm256_permute4x64_epi64 (_mm256_packus_epi16 (lo, hi), 0xd8));
+  }
+
+  if (i < n) {
+    const gint16 *tail[2 * NEO_CONV_MAX_RADIUS + 1];
+
+    for (k = 0; k < n_taps; k++)
+      tail[k] = rows[k] + i;
+    neo_conv_column_scalar (dest + i, tail, n - i, taps, radius);
+  }
+}
+
+void
+neo_unsharp_avx2 (guint8 * data, const guint8 * src, gint n, gint amount)
+{
+  const __m256i one = _mm256_set1_epi16 (1);
+  const __m256i coeffs = _mm256_set1_epi32 ((128 << 16) | (guint16) amount);
+  gint i = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    __m256i s = NEO_LOAD16_EPU8_AVX2 (src + i);
+    __m256i detail = _mm256_sub_epi16 (s, NEO_LOAD16_EPU8_AVX2 (data + i));
+    __m256i lo = _mm256_madd_epi16 (_mm256_unpacklo_epi16 (detail, one),
+        coeffs);
+    __m256i hi = _mm256_madd_epi16 (_mm256_unpackhi_epi16 (detail, one),
+        coeffs);
+
+    detail = _mm256_packs_epi32 (_mm256_srai_epi32 (lo, 8),
+        _mm256_srai_epi32 (hi, 8));
+    _mm_storeu_si128 ((__m128i *) (data + i),
+        neo_pack16_avx2 (_mm256_add_epi16 (s, detail)));
+  }
+
+  if (i < n)
+    neo_unsharp_scalar (data + i, src + i, n - i, amount);
+}
+
+void
+neo_sobel_avx2 (guint8 * dest, const guint8 * above, const guint8 * row,
+    const guint8 * below, gint n, gint step)
+{
+  gint i = MIN (step, n);
+
+  neo_sobel_span_scalar (dest, above, row, below, 0, i, n, step);
+
+  for (; i + 16 + step <= n; i += 16) {
+    __m256i al = NEO_LOAD16_EPU8_AVX2 (above + i - step);
+    __m256i ac = NEO_LOAD16_EPU8_AVX2 (above + i);
+    __m256i ar = NEO_LOAD16_EPU8_AVX2 (above + i + step);
+    __m256i bl = NEO_LOAD16_EPU8_AVX2 (below + i - step);
+    __m256i bc = NEO_LOAD16_EPU8_AVX2 (below + i);
+    __m256i br = NEO_LOAD16_EPU8_AVX2 (below + i + step);
+    __m256i gx, gy;
+
+    gx = _mm256_add_epi16 (_mm256_sub_epi16 (ar, al),
+        _mm256_sub_epi16 (br, bl));
+    gx = _mm256_add_epi16 (gx,
+        _mm256_slli_epi16 (_mm256_sub_epi16 (NEO_LOAD16_EPU8_AVX2 (row + i +
+                    step), NEO_LOAD16_EPU8_AVX2 (row + i - step)), 1));
+    gy = _mm256_add_epi16 (_mm256_add_epi16 (bl, br),
+        _mm256_slli_epi16 (bc, 1));
+    gy = _mm256_sub_epi16 (gy, _mm256_add_epi16 (_mm256_add_epi16 (al, ar),
+            _mm256_slli_epi16 (ac, 1)));
+    gx = _mm256_add_epi16 (_mm256_abs_epi16 (gx), _mm256_abs_epi16 (gy));
+    gx = _mm256_srli_epi16 (_mm256_add_epi16 (gx, _mm256_set1_epi16 (2)), 2);
+    _mm_storeu_si128 ((__m128i *) (dest + i), neo_pack16_avx2 (gx));
+  }
+
+  neo_sobel_span_scalar (dest, above, row, below, i, n, n, step);
+}
+
+/* The 3D LUT kernels handle two pixels at a time, one per 128-bit lane,
+ * with the same steps as SSE2 */
+static inline __m256i
+neo_lut3d_keep_avx2 (const NeoLut3D * lut)
+{
+  guint8 mask[4];
+  guint32 bits;
+  gint k;
+
+  for (k = 0; k < 4; k++)
+    mask[k] = lut->keep[k] ? 0xff : 0;
+  memcpy (&bits, mask, 4);
+
+  return _mm256_set1_epi32 (bits);
+}
+
+/* 8 bytes at @lo and at @hi in the low halves of the two lanes */
+static inline __m256i
+neo_load_pair_avx2 (const void *lo, const void *hi)
+{
+  return _mm256_inserti128_si256 (_mm256_castsi128_si256 (_mm_loadl_epi64
+          ((const __m128i *) lo)), _mm_loadl_epi64 ((const __m128i *) hi), 1);
+}
+
+/* (256 - f, f) pairs of the low and high lane pixels */
+static inline __m256i
+neo_lerp_weights_avx2 (gint f_lo, gint f_hi)
+{
+  return _mm256_inserti128_si256 (_mm256_castsi128_si256 (_mm_set1_epi32
+          ((f_lo << 16) | (256 - f_lo))), _mm_set1_epi32 ((f_hi << 16) |
+          (256 - f_hi)), 1);
+}
+
+static inline __m256i
+neo_lerp_avx2 (__m256i a, __m256i b, __m256i weights)
+{
+  __m256i v = _mm256_madd_epi16 (_mm256_unpacklo_epi16 (a, b), weights);
+
+  return _mm256_srai_epi32 (_mm256_add_epi32 (v, _mm256_set1_epi32 (128)), 8);
+}
+
+static inline __m256i
+neo_narrow_avx2 (__m256i v)
+{
+  return _mm256_packs_epi32 (v, v);
+}
+
+/* Packs the four 32-bit values of each lane to bytes, merges the bytes to
+ * keep from the two input pixels and stores both pixels */
+static inline void
+neo_store_pair_avx2 (guint8 * dest, const guint8 * src, __m256i v,
+    __m256i keep)
+{
+  __m256i px;
+  __m128i out;
+
+  v = neo_narrow_avx2 (v);
+  v = _mm256_packus_epi16 (v, v);
+  /* pixel of the low lane in dword 0, of the high lane in dword 4 */
+  v = _mm256_permutevar8x32_epi32 (v, _mm256_setr_epi32 (0, 4, 0, 0, 0, 0, 0,
+          0));
+  px = _mm256_castsi128_si256 (_mm_loadl_epi64 ((const __m128i *) src));
+  v = _mm256_or_si256 (_mm256_and_si256 (keep, px),
+      _mm256_andnot_si256 (keep, v));
+  out = _mm256_castsi256_si128 (v);
+  _mm_storel_epi64 ((__m128i *) dest, out);
+}
+
+void
+neo_lut3d_trilinear_avx2 (guint8 * dest, const guint8 * src, gint width,
+    const NeoLut3D * lut)
+{
+  const __m256i keep = neo_lut3d_keep_avx2 (lut);
+  const __m256i round = _mm256_set1_epi32 (1 << (NEO_LUT3D_NODE_SHIFT - 1));
+  const gint16 *nodes = lut->nodes;
+  gint dr = lut->step[0] * 4, dg = lut->step[1] * 4, db = lut->step[2] * 4;
+  gint i = 0, f[3], g[3];
+
+  if (lut->pstride != 4) {
+    neo_lut3d_trilinear_scalar (dest, src, width, lut);
+    return;
+  }
+
+  for (; i + 2 <= width; i += 2) {
+    const guint8 *s = src + i * 4;
+    const gint16 *a = nodes + neo_lut3d_cell (lut, s, f) * 4;
+    const gint16 *b = nodes + neo_lut3d_cell (lut, s + 4, g) * 4;
+    __m256i wr = neo_lerp_weights_avx2 (f[0], g[0]);
+    __m256i wg = neo_lerp_weights_avx2 (f[1], g[1]);
+    __m256i c00, c10, c01, c11, c0, c1, c;
+
+    c00 = neo_lerp_avx2 (neo_load_pair_avx2 (a, b),
+        neo_load_pair_avx2 (a + dr, b + dr), wr);
+    c10 = neo_lerp_avx2 (neo_load_pair_avx2 (a + dg, b + dg),
+        neo_load_pair_avx2 (a + dg + dr, b + dg + dr), wr);
+    c01 = neo_lerp_avx2 (neo_load_pair_avx2 (a + db, b + db),
+        neo_load_pair_avx2 (a + db + dr, b + db + dr), wr);
+    c11 = neo_lerp_avx2 (neo_load_pair_avx2 (a + db + dg, b + db + dg),
+        neo_load_pair_avx2 (a + db + dg + dr, b + db + dg + dr), wr);
+    c0 = neo_lerp_avx2 (neo_narrow_avx2 (c00), neo_narrow_avx2 (c10), wg);
+    c1 = neo_lerp_avx2 (neo_narrow_avx2 (c01), neo_narrow_avx2 (c11), wg);
+    c = neo_lerp_avx2 (neo_narrow_avx2 (c0), neo_narrow_avx2 (c1),
+        neo_lerp_weights_avx2 (f[2], g[2]));
+
+    c = _mm256_srai_epi32 (_mm256_add_epi32 (c, round), NEO_LUT3D_NODE_SHIFT);
+    neo_store_pair_avx2 (dest + i * 4, s, c, keep);
+  }
+
+  if (i < width)
+    neo_lut3d_trilinear_scalar (dest + i * 4, src + i * 4, width - i, lut);
+}
+
+void
+neo_lut3d_tetrahedral_avx2 (guint8 * dest, const guint8 * src, gint width,
+    const NeoLut3D * lut)
+{
+  const __m256i keep = neo_lut3d_keep_avx2 (lut);
+  const __m256i round = _mm256_set1_epi32 (1 << (NEO_LUT3D_NODE_SHIFT + 7));
+  const gint16 *nodes = lut->nodes;
+  guint32 a[4], b[4];
+  gint i = 0, v[4], w[4];
+
+  if (lut->pstride != 4) {
+    neo_lut3d_tetrahedral_scalar (dest, src, width, lut);
+    return;
+  }
+
+  for (; i + 2 <= width; i += 2) {
+    const guint8 *s = src + i * 4;
+    __m256i p01, p23, w01, w23, c;
+
+    neo_lut3d_tetrahedron (lut, s, a, v);
+    neo_lut3d_tetrahedron (lut, s + 4, b, w);
+    p01 = _mm256_unpacklo_epi16 (neo_load_pair_avx2 (nodes + a[0] * 4,
+            nodes + b[0] * 4), neo_load_pair_avx2 (nodes + a[1] * 4,
+            nodes + b[1] * 4));
+    p23 = _mm256_unpacklo_epi16 (neo_load_pair_avx2 (nodes + a[2] * 4,
+            nodes + b[2] * 4), neo_load_pair_avx2 (nodes + a[3] * 4,
+            nodes + b[3] * 4));
+    w01 = _mm256_setr_epi32 ((v[1] << 16) | v[0], (v[1] << 16) | v[0],
+        (v[1] << 16) | v[0], (v[1] << 16) | v[0], (w[1] << 16) | w[0],
+        (w[1] << 16) | w[0], (w[1] << 16) | w[0], (w[1] << 16) | w[0]);
+    w23 = _mm256_setr_epi32 ((v[3] << 16) | v[2], (v[3] << 16) | v[2],
+        (v[3] << 16) | v[2], (v[3] << 16) | v[2], (w[3] << 16) | w[2],
+        (w[3] << 16) | w[2], (w[3] << 16) | w[2], (w[3] << 16) | w[2]);
+    c = _mm256_add_epi32 (_mm256_madd_epi16 (p01, w01),
+        _mm256_madd_epi16 (p23, w23));
+
+    c = _mm256_srai_epi32 (_mm256_add_epi32 (c, round),
+        NEO_LUT3D_NODE_SHIFT + 8);
+    neo_store_pair_avx2 (dest + i * 4, s, c, keep);
+  }
+
+  if (i < width)
+    neo_lut3d_tetrahedral_scalar (dest + i * 4, src + i * 4, width - i, lut);
+}
+
+/* As in SSE2, each 128-bit lane shrinking its own 16 bytes of a row */
+void
+neo_shrink4_avx2 (guint8 * dest, const guint8 * const *rows, gint n)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i ones = _mm256_set1_epi16 (1);
+  const __m256i round = _mm256_set1_epi32 (8);
+  const guint8 *tail[4];
+  gint i = 0, k;
+
+  for (; i + 8 <= n; i += 8) {
+    __m256i lo = zero, hi = zero, v;
+    guint32 out[2];
+
+    for (k = 0; k < 4; k++) {
+      __m256i r = _mm256_loadu_si256 ((const __m256i *) (rows[k] + 4 * i));
+
+      lo = _mm256_add_epi16 (lo, _mm256_unpacklo_epi8 (r, zero));
+      hi = _mm256_add_epi16 (hi, _mm256_unpackhi_epi8 (r, zero));
+    }
+    v = _mm256_packs_epi32 (_mm256_madd_epi16 (lo, ones),
+        _mm256_madd_epi16 (hi, ones));
+    v = _mm256_srli_epi32 (_mm256_add_epi32 (_mm256_madd_epi16 (v, ones),
+            round), 4);
+    v = _mm256_packs_epi32 (v, v);
+    v = _mm256_packus_epi16 (v, v);
+    out[0] = _mm_cvtsi128_si32 (_mm256_castsi256_si128 (v));
+    out[1] = _mm_cvtsi128_si32 (_mm256_extracti128_si256 (v, 1));
+    memcpy (dest + i, out, 8);
+  }
+
+  if (i < n) {
+    for (k = 0; k < 4; k++)
+      tail[k] = rows[k] + 4 * i;
+    neo_shrink4_scalar (dest + i, tail, n - i);
+  }
+}
+
+void
+neo_block_sad_avx2 (guint32 * sums, const guint8 * a, const guint8 * b,
+    gint n)
+{
+  gint i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    __m256i sad = _mm256_sad_epu8 (_mm256_loadu_si256 ((const __m256i *) (a +
+                8 * i)), _mm256_loadu_si256 ((const __m256i *) (b + 8 * i)));
+    guint64 s[4];
+
+    _mm256_storeu_si256 ((__m256i *) s, sad);
+    sums[i] += s[0];
+    sums[i + 1] += s[1];
+    sums[i + 2] += s[2];
+    sums[i + 3] += s[3];
+  }
+
+  if (i < n)
+    neo_block_sad_scalar (sums + i, a + 8 * i, b + 8 * i, n - i);
+}
@@ -0,0 +1,440 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <arm_neon.h>
+
+#include "neovideoconv-kernels.h"
+
+static inline uint8x16_t
+neo_luma_neon (uint8x16_t r, uint8x16_t g, uint8x16_t b, const NeoLuma * luma)
+{
+  uint8x8_t wr, wg, wb;
+  uint16x8_t lo, hi;
+
+  /* vrhadd is (a + b + 1) >> 1, exactly the scalar lightness */
+  if (luma->lightness)
+    return vrhaddq_u8 (vminq_u8 (r, vminq_u8 (g, b)),
+        vmaxq_u8 (r, vmaxq_u8 (g, b)));
+
+  wr = vdup_n_u8 (luma->weights[0]);
+  wg = vdup_n_u8 (luma->weights[1]);
+  wb = vdup_n_u8 (luma->weights[2]);
+
+  lo = vmull_u8 (vget_low_u8 (r), wr);
+  lo = vmlal_u8 (lo, vget_low_u8 (g), wg);
+  lo = vmlal_u8 (lo, vget_low_u8 (b), wb);
+  hi = vmull_u8 (vget_high_u8 (r), wr);
+  hi = vmlal_u8 (hi, vget_high_u8 (g), wg);
+  hi = vmlal_u8 (hi, vget_high_u8 (b), wb);
+
+  /* rounding narrow shift is (x + 128) >> 8, same as the reference */
+  return vcombine_u8 (vrshrn_n_u16 (lo, NEO_LUMA_SHIFT),
+      vrshrn_n_u16 (hi, NEO_LUMA_SHIFT));
+}
+
+/* vld3/vld4 deinterleave 16 pixels into one register per component */
+#define NEO_DEFINE_NEON(isa, name, pstride, r, g, b) \
+void \
+neo_##name##_to_gray8_neon (guint8 * dest, const guint8 * src, gint width, \
+    const NeoLuma * luma) \
+{ \
+  gint i = 0; \
+  \
+  for (; i + 16 <= width; i += 16) { \
+    const guint8 *s = src + i * pstride; \
+    uint8x16_t y; \
+    \
+    if (pstride == 3) { \
+      uint8x16x3_t px = vld3q_u8 (s); \
+      y = neo_luma_neon (px.val[r % 3], px.val[g % 3], px.val[b % 3], luma); \
+    } else { \
+      uint8x16x4_t px = vld4q_u8 (s); \
+      y = neo_luma_neon (px.val[r], px.val[g], px.val[b], luma); \
+    } \
+    vst1q_u8 (dest + i, y); \
+  } \
+  \
+  if (i < width) \
+    neo_##name##_to_gray8_scalar (dest + i, src + i * pstride, width - i, \
+        luma); \
+}
+
+NEO_DEFINE_LAYOUTS (NEO_DEFINE_NEON, neon)
+
+/* AArch64 stnp is a store pair with a non-temporal hint, 32 bytes at a
+ * time. 32-bit ARM has no such store, a plain copy it is. */
+void
+neo_stream_copy_neon (guint8 * dest, const guint8 * src, gint n)
+{
+  gint i = 0;
+
+#if defined(__aarch64__) && defined(__GNUC__)
+  for (; i + 32 <= n; i += 32) {
+    uint8x16_t lo = vld1q_u8 (src + i);
+    uint8x16_t hi = vld1q_u8 (src + i + 16);
+
+    __asm__ volatile ("stnp %q0, %q1, [%2]"::"w" (lo), "w" (hi),
+        "r" (dest + i):"memory");
+  }
+#endif
+  for (; i < n; i++)
+    dest[i] = src[i];
+}
+
+void
+neo_stream_fence_neon (void)
+{
+#if defined(__aarch64__) && defined(__GNUC__)
+  __asm__ volatile ("dmb ishst":::"memory");
+#endif
+}
+
+/* One output byte of 8 pixels from the widened bytes @b of each pixel */
+static inline uint8x8_t
+neo_matrix_row_neon (const int16x8_t b[4], const NeoColorMatrix * m, gint k)
+{
+  int32x4_t lo = vdupq_n_s32 (m->offsets[k]);
+  int32x4_t hi = lo;
+  gint j;
+
+  for (j = 0; j < 4; j++) {
+    lo = vmlal_n_s16 (lo, vget_low_s16 (b[j]), m->coeffs[k][j]);
+    hi = vmlal_n_s16 (hi, vget_high_s16 (b[j]), m->coeffs[k][j]);
+  }
+
+  /* saturating narrows clamp to 0..255 like the reference */
+  return vqmovn_u16 (vcombine_u16 (vqshrun_n_s32 (lo, NEO_MATRIX_SHIFT),
+          vqshrun_n_s32 (hi, NEO_MATRIX_SHIFT)));
+}
+
+/* vld4 splits 16 pixels into their four bytes, vst4 puts them back */
+void
+neo_color_matrix32_neon (guint8 * data, gint width,
+    const NeoColorMatrix * matrix)
+{
+  gint i = 0, j, k;
+
+  for (; i + 16 <= width; i += 16) {
+    uint8x16x4_t px = vld4q_u8 (data + i * 4);
+    int16x8_t lo[4], hi[4];
+    uint8x16x4_t out;
+
+    for (j = 0; j < 4; j++) {
+      lo[j] = vreinterpretq_s16_u16 (vmovl_u8 (vget_low_u8 (px.val[j])));
+      hi[j] = vreinterpretq_s16_u16 (vmovl_u8 (vget_high_u8 (px.val[j])));
+    }
+    for (k = 0; k < 4; k++)
+      out.val[k] = vcombine_u8 (neo_matrix_row_neon (lo, matrix, k),
+          neo_matrix_row_neon (hi, matrix, k));
+    vst4q_u8 (data + i * 4, out);
+  }
+
+  if (i < width)
+    neo_color_matrix32_scalar (data + i * 4, width - i, matrix);
+}
+
+void
+neo_conv_row_neon (gint16 * dest, const guint8 * src, gint n, gint step,
+    const gint16 * taps, gint radius)
+{
+  gint n_taps = 2 * radius + 1;
+  gint i = 0, k;
+
+  for (; i + 16 <= n; i += 16) {
+    const guint8 *s = src + i - radius * step;
+    uint16x8_t lo = vdupq_n_u16 (0), hi = vdupq_n_u16 (0);
+
+    for (k = 0; k < n_taps; k++) {
+      uint8x16_t v = vld1q_u8 (s + k * step);
+
+      lo = vmlaq_n_u16 (lo, vmovl_u8 (vget_low_u8 (v)), taps[k]);
+      hi = vmlaq_n_u16 (hi, vmovl_u8 (vget_high_u8 (v)), taps[k]);
+    }
+    /* vrshr rounds the way the reference does */
+    vst1q_s16 (dest + i, vreinterpretq_s16_u16 (vrshrq_n_u16 (lo,
+                NEO_CONV_ROW_SHIFT)));
+    vst1q_s16 (dest + i + 8, vreinterpretq_s16_u16 (vrshrq_n_u16 (hi,
+                NEO_CONV_ROW_SHIFT)));
+  }
+
+  if (i < n)
+    neo_conv_row_scalar (dest + i, src + i, n - i, step, taps, radius);
+}
+
+void
+neo_conv_column_neon (guint8 * dest, const gint16 * const *rows, gint n,
+    const gint16 * taps, gint radius)
+{
+  gint n_taps = 2 * radius + 1;
+  gint i = 0, k, h;
+
+  for (; i + 16 <= n; i += 16) {
+    int32x4_t acc[4];
+    uint16x8_t lo, hi;
+
+    for (h = 0; h < 4; h++)
+      acc[h] = vdupq_n_s32 (0);
+    for (k = 0; k < n_taps; k++) {
+      int16x8_t a = vld1q_s16 (rows[k] + i);
+      int16x8_t b = vld1q_s16 (rows[k] + i + 8);
+
+      acc[0] = vmlal_n_s16 (acc[0], vget_low_s16 (a), taps[k]);
+      acc[1] = vmlal_n_s16 (acc[1], vget_high_s16 (a), taps[k]);
+      acc[2] = vmlal_n_s16 (acc[2], vget_low_s16 (b), taps[k]);
+      acc[3] = vmlal_n_s16 (acc[3], vget_high_s16 (b), taps[k]);
+    }
+
+    /* rounding saturating narrows clamp to 0..255 like the reference */
+    lo = vcombine_u16 (vqrshrun_n_s32 (acc[0], NEO_CONV_COLUMN_SHIFT),
+        vqrshrun_n_s32 (acc[1], NEO_CONV_COLUMN_SHIFT));
+    hi = vcombine_u16 (vqrshrun_n_s32 (acc[2], NEO_CONV_COLUMN_SHIFT),
+        vqrshrun_n_s32 (acc[3], NEO_CONV_COLUMN_SHIFT));
+    vst1q_u8 (dest + i, vcombine_u8 (vqmovn_u16 (lo), vqmovn_u16 (hi)));
+  }
+
+  if (i < n) {
+    const gint16 *tail[2 * NEO_CONV_MAX_RADIUS + 1];
+
+    for (k = 0; k < n_taps; k++)
+      tail[k] = rows[k] + i;
+    neo_conv_column_scalar (dest + i, tail, n - i, taps, radius);
+  }
+}
+
+static inline uint8x8_t
+neo_unsharp_neon8 (uint8x8_t s, uint8x8_t b, gint amount)
+{
+  int16x8_t s16 = vreinterpretq_s16_u16 (vmovl_u8 (s));
+  int16x8_t detail = vreinterpretq_s16_u16 (vsubl_u8 (s, b));
+  int32x4_t lo = vmull_n_s16 (vget_low_s16 (detail), amount);
+  int32x4_t hi = vmull_n_s16 (vget_high_s16 (detail), amount);
+
+  detail = vcombine_s16 (vrshrn_n_s32 (lo, 8), vrshrn_n_s32 (hi, 8));
+  return vqmovun_s16 (vaddq_s16 (s16, detail));
+}
+
+void
+neo_unsharp_neon (guint8 * data, const guint8 * src, gint n, gint amount)
+{
+  gint i = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    uint8x16_t s = vld1q_u8 (src + i);
+    uint8x16_t b = vld1q_u8 (data + i);
+
+    vst1q_u8 (data + i,
+        vcombine_u8 (neo_unsharp_neon8 (vget_low_u8 (s), vget_low_u8 (b),
+                amount), neo_unsharp_neon8 (vget_high_u8 (s),
+                vget_high_u8 (b), amount)));
+  }
+
+  if (i < n)
+    neo_unsharp_scalar (data + i, src + i, n - i, amount);
+}
+
+/* Sobel of 8 bytes at @i, returned as 16-bit magnitudes before the
+ * rounding shift */
+static inline uint16x8_t
+neo_sobel_neon8 (const guint8 * above, const guint8 * row,
+    const guint8 * below, gint i, gint step)
+{
+  int16x8_t al = vreinterpretq_s16_u16 (vmovl_u8 (vld1_u8 (above + i - step)));
+  int16x8_t ac = vreinterpretq_s16_u16 (vmovl_u8 (vld1_u8 (above + i)));
+  int16x8_t ar = vreinterpretq_s16_u16 (vmovl_u8 (vld1_u8 (above + i + step)));
+  int16x8_t bl = vreinterpretq_s16_u16 (vmovl_u8 (vld1_u8 (below + i - step)));
+  int16x8_t bc = vreinterpretq_s16_u16 (vmovl_u8 (vld1_u8 (below + i)));
+  int16x8_t br = vreinterpretq_s16_u16 (vmovl_u8 (vld1_u8 (below + i + step)));
+  int16x8_t mx = vreinterpretq_s16_u16 (vsubl_u8 (vld1_u8 (row + i + step),
+          vld1_u8 (row + i - step)));
+  int16x8_t gx, gy;
+
+  gx = vaddq_s16 (vsubq_s16 (ar, al), vsubq_s16 (br, bl));
+  gx = vaddq_s16 (gx, vshlq_n_s16 (mx, 1));
+  gy = vaddq_s16 (vaddq_s16 (bl, br), vshlq_n_s16 (bc, 1));
+  gy = vsubq_s16 (gy, vaddq_s16 (vaddq_s16 (al, ar), vshlq_n_s16 (ac, 1)));
+
+  return vreinterpretq_u16_s16 (vaddq_s16 (vabsq_s16 (gx), vabsq_s16 (gy)));
+}
+
+void
+neo_sobel_neon (guint8 * dest, const guint8 * above, const guint8 * row,
+    const guint8 * below, gint n, gint step)
+{
+  gint i = MIN (step, n);
+
+  neo_sobel_span_scalar (dest, above, row, below, 0, i, n, step);
+
+  for (; i + 16 + step <= n; i += 16) {
+    uint16x8_t lo = neo_sobel_neon8 (above, row, below, i, step);
+    uint16x8_t hi = neo_sobel_neon8 (above, row, below, i + 8, step);
+
+    /* (x + 2) >> 2 then clamped to 255 */
+    vst1q_u8 (dest + i, vcombine_u8 (vqmovn_u16 (vrshrq_n_u16 (lo, 2)),
+            vqmovn_u16 (vrshrq_n_u16 (hi, 2))));
+  }
+
+  neo_sobel_span_scalar (dest, above, row, below, i, n, n, step);
+}
+
+/* The 3D LUT kernels handle one pixel at a time with its four bytes side by
+ * side, the nodes being stored the same way */
+static inline uint8x8_t
+neo_lut3d_keep_neon (const NeoLut3D * lut)
+{
+  guint8 mask[8] = { 0, };
+  gint k;
+
+  for (k = 0; k < 4; k++)
+    mask[k] = lut->keep[k] ? 0xff : 0;
+
+  return vld1_u8 (mask);
+}
+
+/* Packs the four values to bytes and stores them with the bytes to keep
+ * taken from @src */
+static inline void
+neo_store_pixel_neon (guint8 * dest, const guint8 * src, int32x4_t v,
+    uint8x8_t keep)
+{
+  guint8 in[8] = { 0, }, out[8];
+  uint8x8_t px;
+
+  memcpy (in, src, 4);
+  px = vqmovun_s16 (vcombine_s16 (vmovn_s32 (v), vmovn_s32 (v)));
+  vst1_u8 (out, vbsl_u8 (keep, vld1_u8 (in), px));
+  memcpy (dest, out, 4);
+}
+
+/* (a * (256 - f) + b * f + 128) >> 8 of four values */
+static inline int32x4_t
+neo_lerp_neon (int16x4_t a, int16x4_t b, gint f)
+{
+  int32x4_t v = vmull_n_s16 (a, 256 - f);
+
+  return vrshrq_n_s32 (vmlal_n_s16 (v, b, f), 8);
+}
+
+void
+neo_lut3d_trilinear_neon (guint8 * dest, const guint8 * src, gint width,
+    const NeoLut3D * lut)
+{
+  const uint8x8_t keep = neo_lut3d_keep_neon (lut);
+  gint dr = lut->step[0] * 4, dg = lut->step[1] * 4, db = lut->step[2] * 4;
+  gint i, f[3];
+
+  if (lut->pstride != 4) {
+    neo_lut3d_trilinear_scalar (dest, src, width, lut);
+    return;
+  }
+
+  for (i = 0; i < width; i++) {
+    const guint8 *s = src + i * 4;
+    const gint16 *n = lut->nodes + neo_lut3d_cell (lut, s, f) * 4;
+    int32x4_t c00, c10, c01, c11, c0, c1, c;
+
+    c00 = neo_lerp_neon (vld1_s16 (n), vld1_s16 (n + dr), f[0]);
+    c10 = neo_lerp_neon (vld1_s16 (n + dg), vld1_s16 (n + dg + dr), f[0]);
+    c01 = neo_lerp_neon (vld1_s16 (n + db), vld1_s16 (n + db + dr), f[0]);
+    c11 = neo_lerp_neon (vld1_s16 (n + db + dg), vld1_s16 (n + db + dg + dr),
+        f[0]);
+    c0 = neo_lerp_neon (vmovn_s32 (c00), vmovn_s32 (c10), f[1]);
+    c1 = neo_lerp_neon (vmovn_s32 (c01), vmovn_s32 (c11), f[1]);
+    c = neo_lerp_neon (vmovn_s32 (c0), vmovn_s32 (c1), f[2]);
+
+    neo_store_pixel_neon (dest + i * 4, s,
+        vrshrq_n_s32 (c, NEO_LUT3D_NODE_SHIFT), keep);
+  }
+}
+
+void
+neo_lut3d_tetrahedral_neon (guint8 * dest, const guint8 * src, gint width,
+    const NeoLut3D * lut)
+{
+  const uint8x8_t keep = neo_lut3d_keep_neon (lut);
+  const gint16 *nodes = lut->nodes;
+  guint32 node[4];
+  gint i, j, w[4];
+
+  if (lut->pstride != 4) {
+    neo_lut3d_tetrahedral_scalar (dest, src, width, lut);
+    return;
+  }
+
+  for (i = 0; i < width; i++) {
+    const guint8 *s = src + i * 4;
+    int32x4_t c;
+
+    neo_lut3d_tetrahedron (lut, s, node, w);
+    c = vmull_n_s16 (vld1_s16 (nodes + node[0] * 4), w[0]);
+    for (j = 1; j < 4; j++)
+      c = vmlal_n_s16 (c, vld1_s16 (nodes + node[j] * 4), w[j]);
+
+    neo_store_pixel_neon (dest + i * 4, s,
+        vrshrq_n_s32 (c, NEO_LUT3D_NODE_SHIFT + 8), keep);
+  }
+}
+
+void
+neo_shrink4_neon (guint8 * dest, const guint8 * const *rows, gint n)
+{
+  const guint8 *tail[4];
+  gint i = 0, k;
+
+  for (; i + 4 <= n; i += 4) {
+    uint16x8_t pairs = vpaddlq_u8 (vld1q_u8 (rows[0] + 4 * i));
+    uint16x4_t v;
+    guint8 out[8];
+
+    for (k = 1; k < 4; k++)
+      pairs = vpadalq_u8 (pairs, vld1q_u8 (rows[k] + 4 * i));
+    v = vmovn_u32 (vrshrq_n_u32 (vpaddlq_u16 (pairs), 4));
+    vst1_u8 (out, vmovn_u16 (vcombine_u16 (v, v)));
+    memcpy (dest + i, out, 4);
+  }
+
+  if (i < n) {
+    for (k = 0; k < 4; k++)
+      tail[k] = rows[k] + 4 * i;
+    neo_shrink4_scalar (dest + i, tail, n - i);
+  }
+}
+
+void
+neo_block_sad_neon (guint32 * sums, const guint8 * a, const guint8 * b,
+    gint n)
+{
+  gint i = 0;
+
+  for (; i + 2 <= n; i += 2) {
+    uint8x16_t d = vabdq_u8 (vld1q_u8 (a + 8 * i), vld1q_u8 (b + 8 * i));
+    uint64x2_t sad = vpaddlq_u32 (vpaddlq_u16 (vpaddlq_u8 (d)));
+
+    sums[i] += vgetq_lane_u64 (sad, 0);
+    sums[i + 1] += vgetq_lane_u64 (sad, 1);
+  }
+
+  if (i < n)
+    neo_block_sad_scalar (sums + i, a + 8 * i, b + 8 * i, n - i);
+}
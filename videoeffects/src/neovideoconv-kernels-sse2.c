@@ -0,0 +1,590 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <emmintrin.h>
+
+#include "neovideoconv-kernels.h"
+
+/* Splits 16 packed 3-byte pixels into three planes of 16 bytes using only
+ * SSE2 unpacks: each round interleaves the low halves against the high
+ * halves, and after four rounds the bytes end up sorted by component. */
+static inline void
+neo_deinterleave3_sse2 (const guint8 * src, __m128i * c0, __m128i * c1,
+    __m128i * c2)
+{
+  __m128i t00 = _mm_loadu_si128 ((const __m128i *) src);
+  __m128i t01 = _mm_loadu_si128 ((const __m128i *) (src + 16));
+  __m128i t02 = _mm_loadu_si128 ((const __m128i *) (src + 32));
+
+  __m128i t10 = _mm_unpacklo_epi8 (t00, _mm_unpackhi_epi64 (t01, t01));
+  __m128i t11 = _mm_unpacklo_epi8 (_mm_unpackhi_epi64 (t00, t00), t02);
+  __m128i t12 = _mm_unpacklo_epi8 (t01, _mm_unpackhi_epi64 (t02, t02));
+
+  __m128i t20 = _mm_unpacklo_epi8 (t10, _mm_unpackhi_epi64 (t11, t11));
+  __m128i t21 = _mm_unpacklo_epi8 (_mm_unpackhi_epi64 (t10, t10), t12);
+  __m128i t22 = _mm_unpacklo_epi8 (t11, _mm_unpackhi_epi64 (t12, t12));
+
+  __m128i t30 = _mm_unpacklo_epi8 (t20, _mm_unpackhi_epi64 (t21, t21));
+  __m128i t31 = _mm_unpacklo_epi8 (_mm_unpackhi_epi64 (t20, t20), t22);
+  __m128i t32 = _mm_unpacklo_epi8 (t21, _mm_unpackhi_epi64 (t22, t22));
+
+  *c0 = _mm_unpacklo_epi8 (t30, _mm_unpackhi_epi64 (t31, t31));
+  *c1 = _mm_unpacklo_epi8 (_mm_unpackhi_epi64 (t30, t30), t32);
+  *c2 = _mm_unpacklo_epi8 (t31, _mm_unpackhi_epi64 (t32, t32));
+}
+
+/* 8 pixels in 16-bit lanes; the sum fits in 16 bits so wrapping adds are
+ * exact */
+static inline __m128i
+neo_luma_epi16_sse2 (__m128i r, __m128i g, __m128i b, const NeoLuma * luma)
+{
+  const __m128i round = _mm_set1_epi16 (NEO_LUMA_ROUND);
+  __m128i acc, lo, hi;
+
+  if (luma->lightness) {
+    lo = _mm_min_epi16 (r, _mm_min_epi16 (g, b));
+    hi = _mm_max_epi16 (r, _mm_max_epi16 (g, b));
+    acc = _mm_add_epi16 (_mm_add_epi16 (lo, hi), _mm_set1_epi16 (1));
+    return _mm_srli_epi16 (acc, 1);
+  }
+
+  acc = _mm_add_epi16 (_mm_mullo_epi16 (r, _mm_set1_epi16 (luma->weights[0])),
+      _mm_mullo_epi16 (g, _mm_set1_epi16 (luma->weights[1])));
+  acc = _mm_add_epi16 (acc,
+      _mm_mullo_epi16 (b, _mm_set1_epi16 (luma->weights[2])));
+  acc = _mm_add_epi16 (acc, round);
+
+  return _mm_srli_epi16 (acc, NEO_LUMA_SHIFT);
+}
+
+/* Picks component @c of 8 packed 4-byte pixels into 16-bit lanes. A macro
+ * rather than a function so that the shift stays an immediate. */
+#define NEO_EXTRACT4_EPI16_SSE2(v0, v1, c) \
+    _mm_packs_epi32 ( \
+        _mm_and_si128 (_mm_srli_epi32 ((v0), (c) * 8), _mm_set1_epi32 (0xff)), \
+        _mm_and_si128 (_mm_srli_epi32 ((v1), (c) * 8), _mm_set1_epi32 (0xff)))
+
+#define NEO_DEFINE_SSE2(isa, name, pstride, r, g, b) \
+void \
+neo_##name##_to_gray8_sse2 (guint8 * dest, const guint8 * src, gint width, \
+    const NeoLuma * luma) \
+{ \
+  const __m128i zero = _mm_setzero_si128 (); \
+  gint i = 0; \
+  \
+  for (; i + 16 <= width; i += 16) { \
+    const guint8 *s = src + i * pstride; \
+    __m128i lo, hi; \
+    \
+    if (pstride == 3) { \
+      __m128i c[3]; \
+      \
+      neo_deinterleave3_sse2 (s, &c[0], &c[1], &c[2]); \
+      lo = neo_luma_epi16_sse2 (_mm_unpacklo_epi8 (c[r % 3], zero), \
+          _mm_unpacklo_epi8 (c[g % 3], zero), _mm_unpacklo_epi8 (c[b % 3], zero), luma); \
+      hi = neo_luma_epi16_sse2 (_mm_unpackhi_epi8 (c[r % 3], zero), \
+          _mm_unpackhi_epi8 (c[g % 3], zero), _mm_unpackhi_epi8 (c[b % 3], zero), luma); \
+    } else { \
+      __m128i v0 = _mm_loadu_si128 ((const __m128i *) s); \
+      __m128i v1 = _mm_loadu_si128 ((const __m128i *) (s + 16)); \
+      __m128i v2 = _mm_loadu_si128 ((const __m128i *) (s + 32)); \
+      __m128i v3 = _mm_loadu_si128 ((const __m128i *) (s + 48)); \
+      \
+      lo = neo_luma_epi16_sse2 (NEO_EXTRACT4_EPI16_SSE2 (v0, v1, r), \
+          NEO_EXTRACT4_EPI16_SSE2 (v0, v1, g), \
+          NEO_EXTRACT4_EPI16_SSE2 (v0, v1, b), luma); \
+      hi = neo_luma_epi16_sse2 (NEO_EXTRACT4_EPI16_SSE2 (v2, v3, r), \
+          NEO_EXTRACT4_EPI16_SSE2 (v2, v3, g), \
+          NEO_EXTRACT4_EPI16_SSE2 (v2, v3, b), luma); \
+    } \
+    _mm_storeu_si128 ((__m128i *) (dest + i), _mm_packus_epi16 (lo, hi)); \
+  } \
+  \
+  if (i < width) \
+    neo_##name##_to_gray8_scalar (dest + i, src + i * pstride, width - i, \
+        luma); \
+}
+
+NEO_DEFINE_LAYOUTS (NEO_DEFINE_SSE2, sse2)
+
+/* movntdq needs 16-byte aligned destinations, the unaligned head and the
+ * tail use regular stores */
+void
+neo_stream_copy_sse2 (guint8 * dest, const guint8 * src, gint n)
+{
+  gint i = 0;
+
+  for (; i < n && ((guintptr) (dest + i) & 15); i++)
+    dest[i] = src[i];
+  for (; i + 16 <= n; i += 16)
+    _mm_stream_si128 ((__m128i *) (dest + i),
+        _mm_loadu_si128 ((const __m128i *) (src + i)));
+  for (; i < n; i++)
+    dest[i] = src[i];
+}
+
+void
+neo_stream_fence_sse2 (void)
+{
+  _mm_sfence ();
+}
+
+/* One output byte of 8 pixels: @p01 and @p23 hold bytes 0/1 and 2/3 of
+ * each pixel as 16-bit pairs, so two pmaddwd per half give the sum */
+static inline __m128i
+neo_matrix_row_sse2 (__m128i p01_lo, __m128i p01_hi, __m128i p23_lo,
+    __m128i p23_hi, const NeoColorMatrix * m, gint k)
+{
+  const __m128i c01 = _mm_set1_epi32 (
+      ((guint32) (guint16) m->coeffs[k][1] << 16) |
+      (guint16) m->coeffs[k][0]);
+  const __m128i c23 = _mm_set1_epi32 (
+      ((guint32) (guint16) m->coeffs[k][3] << 16) |
+      (guint16) m->coeffs[k][2]);
+  const __m128i offset = _mm_set1_epi32 (m->offsets[k]);
+  __m128i lo, hi;
+
+  lo = _mm_add_epi32 (_mm_madd_epi16 (p01_lo, c01),
+      _mm_madd_epi16 (p23_lo, c23));
+  hi = _mm_add_epi32 (_mm_madd_epi16 (p01_hi, c01),
+      _mm_madd_epi16 (p23_hi, c23));
+  lo = _mm_srai_epi32 (_mm_add_epi32 (lo, offset), NEO_MATRIX_SHIFT);
+  hi = _mm_srai_epi32 (_mm_add_epi32 (hi, offset), NEO_MATRIX_SHIFT);
+
+  /* the sums fit in 16 bits, packus then clamps to 0..255 */
+  lo = _mm_packs_epi32 (lo, hi);
+  return _mm_packus_epi16 (lo, lo);
+}
+
+void
+neo_color_matrix32_sse2 (guint8 * data, gint width,
+    const NeoColorMatrix * matrix)
+{
+  gint i = 0;
+
+  for (; i + 8 <= width; i += 8) {
+    guint8 *d = data + i * 4;
+    __m128i v0 = _mm_loadu_si128 ((const __m128i *) d);
+    __m128i v1 = _mm_loadu_si128 ((const __m128i *) (d + 16));
+    __m128i b0 = NEO_EXTRACT4_EPI16_SSE2 (v0, v1, 0);
+    __m128i b1 = NEO_EXTRACT4_EPI16_SSE2 (v0, v1, 1);
+    __m128i b2 = NEO_EXTRACT4_EPI16_SSE2 (v0, v1, 2);
+    __m128i b3 = NEO_EXTRACT4_EPI16_SSE2 (v0, v1, 3);
+    __m128i p01_lo = _mm_unpacklo_epi16 (b0, b1);
+    __m128i p01_hi = _mm_unpackhi_epi16 (b0, b1);
+    __m128i p23_lo = _mm_unpacklo_epi16 (b2, b3);
+    __m128i p23_hi = _mm_unpackhi_epi16 (b2, b3);
+    __m128i o0, o1, o2, o3, o01, o23;
+
+    o0 = neo_matrix_row_sse2 (p01_lo, p01_hi, p23_lo, p23_hi, matrix, 0);
+    o1 = neo_matrix_row_sse2 (p01_lo, p01_hi, p23_lo, p23_hi, matrix, 1);
+    o2 = neo_matrix_row_sse2 (p01_lo, p01_hi, p23_lo, p23_hi, matrix, 2);
+    o3 = neo_matrix_row_sse2 (p01_lo, p01_hi, p23_lo, p23_hi, matrix, 3);
+
+    /* back to packed pixels */
+    o01 = _mm_unpacklo_epi8 (o0, o1);
+    o23 = _mm_unpacklo_epi8 (o2, o3);
+    _mm_storeu_si128 ((__m128i *) d, _mm_unpacklo_epi16 (o01, o23));
+    _mm_storeu_si128 ((__m128i *) (d + 16), _mm_unpackhi_epi16 (o01, o23));
+  }
+
+  if (i < width)
+    neo_color_matrix32_scalar (data + i * 4, width - i, matrix);
+}
+
+/* The taps are non-negative and sum to 256, so the sums of 8-bit values
+ * fit unsigned 16-bit lanes and wrapping multiply-adds are exact */
+void
+neo_conv_row_sse2 (gint16 * dest, const guint8 * src, gint n, gint step,
+    const gint16 * taps, gint radius)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i round = _mm_set1_epi16 (1 << (NEO_CONV_ROW_SHIFT - 1));
+  __m128i t[2 * NEO_CONV_MAX_RADIUS + 1];
+  gint n_taps = 2 * radius + 1;
+  gint i = 0, k;
+
+  for (k = 0; k < n_taps; k++)
+    t[k] = _mm_set1_epi16 (taps[k]);
+
+  for (; i + 16 <= n; i += 16) {
+    const guint8 *s = src + i - radius * step;
+    __m128i lo = round, hi = round;
+
+    for (k = 0; k < n_taps; k++) {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (s + k * step));
+
+      lo = _mm_add_epi16 (lo, _mm_mullo_epi16 (_mm_unpacklo_epi8 (v, zero),
+              t[k]));
+      hi = _mm_add_epi16 (hi, _mm_mullo_epi16 (_mm_unpackhi_epi8 (v, zero),
+              t[k]));
+    }
+    _mm_storeu_si128 ((__m128i *) (dest + i),
+        _mm_srli_epi16 (lo, NEO_CONV_ROW_SHIFT));
+    _mm_storeu_si128 ((__m128i *) (dest + i + 8),
+        _mm_srli_epi16 (hi, NEO_CONV_ROW_SHIFT));
+  }
+
+  if (i < n)
+    neo_conv_row_scalar (dest + i, src + i, n - i, step, taps, radius);
+}
+
+/* Rows are taken two at a time, interleaved so that one pmaddwd applies
+ * both taps; an odd last row is paired with a zero tap */
+void
+neo_conv_column_sse2 (guint8 * dest, const gint16 * const *rows, gint n,
+    const gint16 * taps, gint radius)
+{
+  const __m128i round = _mm_set1_epi32 (1 << (NEO_CONV_COLUMN_SHIFT - 1));
+  __m128i pairs[NEO_CONV_MAX_RADIUS + 1];
+  gint n_taps = 2 * radius + 1;
+  gint i = 0, k, h;
+
+  for (k = 0; k < n_taps; k += 2) {
+    gint16 next = k + 1 < n_taps ? taps[k + 1] : 0;
+
+    pairs[k / 2] = _mm_set1_epi32 (((guint32) (guint16) next << 16) |
+        (guint16) taps[k]);
+  }
+
+  for (; i + 16 <= n; i += 16) {
+    __m128i acc[4] = { round, round, round, round };
+    __m128i lo, hi;
+
+    for (k = 0; k < n_taps; k += 2) {
+      const gint16 *r0 = rows[k];
+      const gint16 *r1 = rows[k + 1 < n_taps ? k + 1 : k];
+
+      for (h = 0; h < 2; h++) {
+        __m128i a = _mm_loadu_si128 ((const __m128i *) (r0 + i + 8 * h));
+        __m128i b = _mm_loadu_si128 ((const __m128i *) (r1 + i + 8 * h));
+
+        acc[2 * h] = _mm_add_epi32 (acc[2 * h],
+            _mm_madd_epi16 (_mm_unpacklo_epi16 (a, b), pairs[k / 2]));
+        acc[2 * h + 1] = _mm_add_epi32 (acc[2 * h + 1],
+            _mm_madd_epi16 (_mm_unpackhi_epi16 (a, b), pairs[k / 2]));
+      }
+    }
+
+    lo = _mm_packs_epi32 (_mm_srai_epi32 (acc[0], NEO_CONV_COLUMN_SHIFT),
+        _mm_srai_epi32 (acc[1], NEO_CONV_COLUMN_SHIFT));
+    hi = _mm_packs_epi32 (_mm_srai_epi32 (acc[2], NEO_CONV_COLUMN_SHIFT),
+        _mm_srai_epi32 (acc[3], NEO_CONV_COLUMN_SHIFT));
+    _mm_storeu_si128 ((__m128i *) (dest + i), _mm_packus_epi16 (lo, hi));
+  }
+
+  if (i < n) {
+    const gint16 *tail[2 * NEO_CONV_MAX_RADIUS + 1];
+
+    for (k = 0; k < n_taps; k++)
+      tail[k] = rows[k] + i;
+    neo_conv_column_scalar (dest + i, tail, n - i, taps, radius);
+  }
+}
+
+/* The detail times the amount needs 32 bits: pmaddwd of (detail, 1)
+ * pairs against (amount, 128) adds the rounding on the way */
+static inline __m128i
+neo_unsharp_epi16_sse2 (__m128i s, __m128i b, __m128i coeffs)
+{
+  const __m128i one = _mm_set1_epi16 (1);
+  __m128i detail = _mm_sub_epi16 (s, b);
+  __m128i lo = _mm_madd_epi16 (_mm_unpacklo_epi16 (detail, one), coeffs);
+  __m128i hi = _mm_madd_epi16 (_mm_unpackhi_epi16 (detail, one), coeffs);
+
+  detail = _mm_packs_epi32 (_mm_srai_epi32 (lo, 8), _mm_srai_epi32 (hi, 8));
+  return _mm_add_epi16 (s, detail);
+}
+
+void
+neo_unsharp_sse2 (guint8 * data, const guint8 * src, gint n, gint amount)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i coeffs = _mm_set1_epi32 ((128 << 16) | (guint16) amount);
+  gint i = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    __m128i s = _mm_loadu_si128 ((const __m128i *) (src + i));
+    __m128i b = _mm_loadu_si128 ((const __m128i *) (data + i));
+    __m128i lo = neo_unsharp_epi16_sse2 (_mm_unpacklo_epi8 (s, zero),
+        _mm_unpacklo_epi8 (b, zero), coeffs);
+    __m128i hi = neo_unsharp_epi16_sse2 (_mm_unpackhi_epi8 (s, zero),
+        _mm_unpackhi_epi8 (b, zero), coeffs);
+
+    _mm_storeu_si128 ((__m128i *) (data + i), _mm_packus_epi16 (lo, hi));
+  }
+
+  if (i < n)
+    neo_unsharp_scalar (data + i, src + i, n - i, amount);
+}
+
+static inline __m128i
+neo_abs_epi16_sse2 (__m128i v)
+{
+  return _mm_max_epi16 (v, _mm_sub_epi16 (_mm_setzero_si128 (), v));
+}
+
+/* Sobel of 8 values from their widened left (l), centre (c) and right (r)
+ * neighbours in the rows above (a), at (m) and below (b) */
+static inline __m128i
+neo_sobel_epi16_sse2 (__m128i al, __m128i ac, __m128i ar, __m128i ml,
+    __m128i mr, __m128i bl, __m128i bc, __m128i br)
+{
+  __m128i gx, gy;
+
+  gx = _mm_add_epi16 (_mm_sub_epi16 (ar, al), _mm_sub_epi16 (br, bl));
+  gx = _mm_add_epi16 (gx, _mm_slli_epi16 (_mm_sub_epi16 (mr, ml), 1));
+  gy = _mm_add_epi16 (_mm_add_epi16 (bl, br), _mm_slli_epi16 (bc, 1));
+  gy = _mm_sub_epi16 (gy, _mm_add_epi16 (_mm_add_epi16 (al, ar),
+          _mm_slli_epi16 (ac, 1)));
+
+  return _mm_srli_epi16 (_mm_add_epi16 (_mm_add_epi16 (neo_abs_epi16_sse2
+              (gx), neo_abs_epi16_sse2 (gy)), _mm_set1_epi16 (2)), 2);
+}
+
+#define NEO_LOAD_SSE2(p) _mm_loadu_si128 ((const __m128i *) (p))
+
+/* The first and last @step bytes lack a neighbour, the scalar span
+ * handles them */
+void
+neo_sobel_sse2 (guint8 * dest, const guint8 * above, const guint8 * row,
+    const guint8 * below, gint n, gint step)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  gint i = MIN (step, n);
+
+  neo_sobel_span_scalar (dest, above, row, below, 0, i, n, step);
+
+  for (; i + 16 + step <= n; i += 16) {
+    __m128i al = NEO_LOAD_SSE2 (above + i - step);
+    __m128i ac = NEO_LOAD_SSE2 (above + i);
+    __m128i ar = NEO_LOAD_SSE2 (above + i + step);
+    __m128i ml = NEO_LOAD_SSE2 (row + i - step);
+    __m128i mr = NEO_LOAD_SSE2 (row + i + step);
+    __m128i bl = NEO_LOAD_SSE2 (below + i - step);
+    __m128i bc = NEO_LOAD_SSE2 (below + i);
+    __m128i br = NEO_LOAD_SSE2 (below + i + step);
+    __m128i lo, hi;
+
+    lo = neo_sobel_epi16_sse2 (_mm_unpacklo_epi8 (al, zero),
+        _mm_unpacklo_epi8 (ac, zero), _mm_unpacklo_epi8 (ar, zero),
+        _mm_unpacklo_epi8 (ml, zero), _mm_unpacklo_epi8 (mr, zero),
+        _mm_unpacklo_epi8 (bl, zero), _mm_unpacklo_epi8 (bc, zero),
+        _mm_unpacklo_epi8 (br, zero));
+    hi = neo_sobel_epi16_sse2 (_mm_unpackhi_epi8 (al, zero),
+        _mm_unpackhi_epi8 (ac, zero), _mm_unpackhi_epi8 (ar, zero),
+        _mm_unpackhi_epi8 (ml, zero), _mm_unpackhi_epi8 (mr, zero),
+        _mm_unpackhi_epi8 (bl, zero), _mm_unpackhi_epi8 (bc, zero),
+        _mm_unpackhi_epi8 (br, zero));
+    _mm_storeu_si128 ((__m128i *) (dest + i), _mm_packus_epi16 (lo, hi));
+  }
+
+  neo_sobel_span_scalar (dest, above, row, below, i, n, n, step);
+}
+
+/* The 3D LUT kernels handle one pixel at a time with its four bytes side by
+ * side, the nodes being stored the same way. Bytes to keep come from the
+ * input pixel through @keep. */
+static inline __m128i
+neo_lut3d_keep_sse2 (const NeoLut3D * lut)
+{
+  guint8 mask[4];
+  guint32 bits;
+  gint k;
+
+  for (k = 0; k < 4; k++)
+    mask[k] = lut->keep[k] ? 0xff : 0;
+  memcpy (&bits, mask, 4);
+
+  return _mm_cvtsi32_si128 (bits);
+}
+
+static inline __m128i
+neo_load_pixel_sse2 (const guint8 * src)
+{
+  guint32 px;
+
+  memcpy (&px, src, 4);
+  return _mm_cvtsi32_si128 (px);
+}
+
+static inline void
+neo_store_pixel_sse2 (guint8 * dest, __m128i v, __m128i src, __m128i keep)
+{
+  guint32 px;
+
+  v = _mm_or_si128 (_mm_and_si128 (keep, src), _mm_andnot_si128 (keep, v));
+  px = _mm_cvtsi128_si32 (v);
+  memcpy (dest, &px, 4);
+}
+
+#define NEO_LOAD_NODE_SSE2(n) _mm_loadl_epi64 ((const __m128i *) (n))
+#define NEO_LERP_WEIGHTS_SSE2(f) _mm_set1_epi32 (((f) << 16) | (256 - (f)))
+
+/* lerp of the four values of @a and @b, 16-bit in the low half, into
+ * 32-bit lanes. pmaddwd of the interleaved values against (256 - f, f). */
+static inline __m128i
+neo_lerp_sse2 (__m128i a, __m128i b, __m128i weights)
+{
+  __m128i v = _mm_madd_epi16 (_mm_unpacklo_epi16 (a, b), weights);
+
+  return _mm_srai_epi32 (_mm_add_epi32 (v, _mm_set1_epi32 (128)), 8);
+}
+
+static inline __m128i
+neo_narrow_sse2 (__m128i v)
+{
+  return _mm_packs_epi32 (v, v);
+}
+
+void
+neo_lut3d_trilinear_sse2 (guint8 * dest, const guint8 * src, gint width,
+    const NeoLut3D * lut)
+{
+  const __m128i keep = neo_lut3d_keep_sse2 (lut);
+  const __m128i round = _mm_set1_epi32 (1 << (NEO_LUT3D_NODE_SHIFT - 1));
+  gint dr = lut->step[0] * 4, dg = lut->step[1] * 4, db = lut->step[2] * 4;
+  gint i, f[3];
+
+  if (lut->pstride != 4) {
+    neo_lut3d_trilinear_scalar (dest, src, width, lut);
+    return;
+  }
+
+  for (i = 0; i < width; i++) {
+    const guint8 *s = src + i * 4;
+    const gint16 *n = lut->nodes + neo_lut3d_cell (lut, s, f) * 4;
+    __m128i wr = NEO_LERP_WEIGHTS_SSE2 (f[0]);
+    __m128i c00, c10, c01, c11, c0, c1, c;
+
+    c00 = neo_lerp_sse2 (NEO_LOAD_NODE_SSE2 (n), NEO_LOAD_NODE_SSE2 (n + dr),
+        wr);
+    c10 = neo_lerp_sse2 (NEO_LOAD_NODE_SSE2 (n + dg),
+        NEO_LOAD_NODE_SSE2 (n + dg + dr), wr);
+    c01 = neo_lerp_sse2 (NEO_LOAD_NODE_SSE2 (n + db),
+        NEO_LOAD_NODE_SSE2 (n + db + dr), wr);
+    c11 = neo_lerp_sse2 (NEO_LOAD_NODE_SSE2 (n + db + dg),
+        NEO_LOAD_NODE_SSE2 (n + db + dg + dr), wr);
+    c0 = neo_lerp_sse2 (neo_narrow_sse2 (c00), neo_narrow_sse2 (c10),
+        NEO_LERP_WEIGHTS_SSE2 (f[1]));
+    c1 = neo_lerp_sse2 (neo_narrow_sse2 (c01), neo_narrow_sse2 (c11),
+        NEO_LERP_WEIGHTS_SSE2 (f[1]));
+    c = neo_lerp_sse2 (neo_narrow_sse2 (c0), neo_narrow_sse2 (c1),
+        NEO_LERP_WEIGHTS_SSE2 (f[2]));
+
+    c = _mm_srai_epi32 (_mm_add_epi32 (c, round), NEO_LUT3D_NODE_SHIFT);
+    c = neo_narrow_sse2 (c);
+    neo_store_pixel_sse2 (dest + i * 4, _mm_packus_epi16 (c, c),
+        neo_load_pixel_sse2 (s), keep);
+  }
+}
+
+void
+neo_lut3d_tetrahedral_sse2 (guint8 * dest, const guint8 * src, gint width,
+    const NeoLut3D * lut)
+{
+  const __m128i keep = neo_lut3d_keep_sse2 (lut);
+  const __m128i round = _mm_set1_epi32 (1 << (NEO_LUT3D_NODE_SHIFT + 7));
+  const gint16 *nodes = lut->nodes;
+  guint32 node[4];
+  gint i, w[4];
+
+  if (lut->pstride != 4) {
+    neo_lut3d_tetrahedral_scalar (dest, src, width, lut);
+    return;
+  }
+
+  for (i = 0; i < width; i++) {
+    const guint8 *s = src + i * 4;
+    __m128i p01, p23, c;
+
+    neo_lut3d_tetrahedron (lut, s, node, w);
+    p01 = _mm_unpacklo_epi16 (NEO_LOAD_NODE_SSE2 (nodes + node[0] * 4),
+        NEO_LOAD_NODE_SSE2 (nodes + node[1] * 4));
+    p23 = _mm_unpacklo_epi16 (NEO_LOAD_NODE_SSE2 (nodes + node[2] * 4),
+        NEO_LOAD_NODE_SSE2 (nodes + node[3] * 4));
+    c = _mm_add_epi32 (_mm_madd_epi16 (p01, _mm_set1_epi32 ((w[1] << 16) |
+                w[0])), _mm_madd_epi16 (p23, _mm_set1_epi32 ((w[3] << 16) |
+                w[2])));
+
+    c = _mm_srai_epi32 (_mm_add_epi32 (c, round), NEO_LUT3D_NODE_SHIFT + 8);
+    c = neo_narrow_sse2 (c);
+    neo_store_pixel_sse2 (dest + i * 4, _mm_packus_epi16 (c, c),
+        neo_load_pixel_sse2 (s), keep);
+  }
+}
+
+/* Sums of 4x4 bytes come from 16-bit column sums added pairwise twice */
+void
+neo_shrink4_sse2 (guint8 * dest, const guint8 * const *rows, gint n)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i ones = _mm_set1_epi16 (1);
+  const __m128i round = _mm_set1_epi32 (8);
+  const guint8 *tail[4];
+  gint i = 0, k;
+
+  for (; i + 4 <= n; i += 4) {
+    __m128i lo = zero, hi = zero, v;
+    guint32 out;
+
+    for (k = 0; k < 4; k++) {
+      __m128i r = _mm_loadu_si128 ((const __m128i *) (rows[k] + 4 * i));
+
+      lo = _mm_add_epi16 (lo, _mm_unpacklo_epi8 (r, zero));
+      hi = _mm_add_epi16 (hi, _mm_unpackhi_epi8 (r, zero));
+    }
+    v = _mm_packs_epi32 (_mm_madd_epi16 (lo, ones), _mm_madd_epi16 (hi,
+            ones));
+    v = _mm_srli_epi32 (_mm_add_epi32 (_mm_madd_epi16 (v, ones), round), 4);
+    v = _mm_packs_epi32 (v, v);
+    out = _mm_cvtsi128_si32 (_mm_packus_epi16 (v, v));
+    memcpy (dest + i, &out, 4);
+  }
+
+  if (i < n) {
+    for (k = 0; k < 4; k++)
+      tail[k] = rows[k] + 4 * i;
+    neo_shrink4_scalar (dest + i, tail, n - i);
+  }
+}
+
+void
+neo_block_sad_sse2 (guint32 * sums, const guint8 * a, const guint8 * b,
+    gint n)
+{
+  gint i = 0;
+
+  for (; i + 2 <= n; i += 2) {
+    __m128i sad = _mm_sad_epu8 (_mm_loadu_si128 ((const __m128i *) (a +
+                8 * i)), _mm_loadu_si128 ((const __m128i *) (b + 8 * i)));
+
+    sums[i] += _mm_cvtsi128_si32 (sad);
+    sums[i + 1] += _mm_cvtsi128_si32 (_mm_srli_si128 (sad, 8));
+  }
+
+  if (i < n)
+    neo_block_sad_scalar (sums + i, a + 8 * i, b + 8 * i, n - i);
+}
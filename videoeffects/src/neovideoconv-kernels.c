@@ -0,0 +1,488 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Row kernels used by the videoeffects elements and the runtime selection of
+ * the best one for the running CPU. The scalar functions in this file are
+ * the reference: every SIMD variant has to produce identical output.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#if defined(HAVE_NEON) && defined(__arm__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#include <string.h>
+
+#include "neovideoconv-kernels.h"
+
+/* weights scaled by 256, rounded so that each set sums to exactly 256 */
+static const gint neo_luma_weights[][3] = {
+  [NEO_LUMA_BT601] = {77, 150, 29},     /* 0.299, 0.587, 0.114 */
+  [NEO_LUMA_BT709] = {54, 184, 18},     /* 0.2126, 0.7152, 0.0722 */
+  [NEO_LUMA_BT2020] = {67, 174, 15},    /* 0.2627, 0.6780, 0.0593 */
+  [NEO_LUMA_AVERAGE] = {85, 86, 85},
+  [NEO_LUMA_LIGHTNESS] = {0, 0, 0},
+};
+
+void
+neo_luma_init (NeoLuma * luma, NeoLumaMethod method)
+{
+  gint c, v;
+
+  luma->lightness = method == NEO_LUMA_LIGHTNESS;
+  for (c = 0; c < 3; c++) {
+    luma->weights[c] = neo_luma_weights[method][c];
+    for (v = 0; v < 256; v++)
+      luma->lut[c][v] = luma->weights[c] * v + (c == 0 ? NEO_LUMA_ROUND : 0);
+  }
+}
+
+#define NEO_DEFINE_SCALAR(isa, name, pstride, r, g, b) \
+void \
+neo_##name##_to_gray8_scalar (guint8 * dest, const guint8 * src, gint width, \
+    const NeoLuma * luma) \
+{ \
+  const guint16 *lut_r = luma->lut[0]; \
+  const guint16 *lut_g = luma->lut[1]; \
+  const guint16 *lut_b = luma->lut[2]; \
+  gint i; \
+  \
+  if (luma->lightness) { \
+    for (i = 0; i < width; i++) { \
+      gint lo = MIN (src[r], MIN (src[g], src[b])); \
+      gint hi = MAX (src[r], MAX (src[g], src[b])); \
+      dest[i] = (lo + hi + 1) >> 1; \
+      src += pstride; \
+    } \
+    return; \
+  } \
+  \
+  for (i = 0; i < width; i++) { \
+    dest[i] = (lut_r[src[r]] + lut_g[src[g]] + lut_b[src[b]]) >> \
+        NEO_LUMA_SHIFT; \
+    src += pstride; \
+  } \
+}
+
+NEO_DEFINE_LAYOUTS (NEO_DEFINE_SCALAR, scalar)
+
+/* The weighted sum s is 0..255 * 256 before rounding, s + (s >> 8) spreads
+ * it over 0..65535 the way v * 257 does for 8-bit values */
+#define NEO_DEFINE_GRAY16(isa, name, pstride, r, g, b) \
+void \
+neo_##name##_to_gray16_scalar (guint8 * dest, const guint8 * src, \
+    gint width, const NeoLuma * luma) \
+{ \
+  const guint16 *lut_r = luma->lut[0]; \
+  const guint16 *lut_g = luma->lut[1]; \
+  const guint16 *lut_b = luma->lut[2]; \
+  guint v; \
+  gint i; \
+  \
+  for (i = 0; i < width; i++) { \
+    if (luma->lightness) { \
+      guint lo = MIN (src[r], MIN (src[g], src[b])); \
+      guint hi = MAX (src[r], MAX (src[g], src[b])); \
+      v = ((lo + hi) * 257 + 1) >> 1; \
+    } else { \
+      v = lut_r[src[r]] + lut_g[src[g]] + lut_b[src[b]] - NEO_LUMA_ROUND; \
+      v += v >> 8; \
+    } \
+    dest[2 * i] = v & 0xff; \
+    dest[2 * i + 1] = v >> 8; \
+    src += pstride; \
+  } \
+}
+
+NEO_DEFINE_LAYOUTS (NEO_DEFINE_GRAY16, scalar)
+
+/* In-place desaturation reuses the GRAY8 kernel of the same instruction set
+ * on chunks small enough for the luma to stay in L1 until it is written
+ * back into the pixels it came from. */
+#define NEO_DESATURATE_CHUNK 256
+
+#define NEO_DEFINE_DESATURATE(isa, name, pstride, r, g, b) \
+void \
+neo_##name##_desaturate_##isa (guint8 * data, gint width, \
+    const NeoLuma * luma) \
+{ \
+  guint8 y[NEO_DESATURATE_CHUNK]; \
+  gint i, n; \
+  \
+  while (width > 0) { \
+    n = MIN (width, NEO_DESATURATE_CHUNK); \
+    neo_##name##_to_gray8_##isa (y, data, n, luma); \
+    for (i = 0; i < n; i++) { \
+      data[r] = data[g] = data[b] = y[i]; \
+      data += pstride; \
+    } \
+    width -= n; \
+  } \
+}
+
+NEO_DEFINE_LAYOUTS (NEO_DEFINE_DESATURATE, scalar)
+#ifdef HAVE_SSE2
+NEO_DEFINE_LAYOUTS (NEO_DEFINE_DESATURATE, sse2)
+#endif
+#ifdef HAVE_AVX2
+NEO_DEFINE_LAYOUTS (NEO_DEFINE_DESATURATE, avx2)
+#endif
+#ifdef HAVE_NEON
+NEO_DEFINE_LAYOUTS (NEO_DEFINE_DESATURATE, neon)
+#endif
+
+/* The streaming variant converts a chunk at a time into a buffer that
+ * stays in L1 and moves it out with non-temporal stores, while the source
+ * of the next chunk is being prefetched. The prefetches use low temporal
+ * locality: a non-temporal hint measured slower, it keeps the lines out of
+ * the levels the hardware prefetcher feeds. */
+#define NEO_STREAM_CHUNK 512
+#define NEO_CACHE_LINE 64
+
+#if defined(__GNUC__)
+#define NEO_PREFETCH(p) __builtin_prefetch ((p), 0, 1)
+#else
+#define NEO_PREFETCH(p) G_STMT_START { } G_STMT_END
+#endif
+
+#define NEO_DEFINE_STREAM(isa, name, pstride, r, g, b) \
+void \
+neo_##name##_to_gray8_stream_##isa (guint8 * dest, const guint8 * src, \
+    gint width, const NeoLuma * luma) \
+{ \
+  guint8 y[NEO_STREAM_CHUNK]; \
+  gint i, n, p; \
+  \
+  for (i = 0; i < width; i += n) { \
+    n = MIN (width - i, NEO_STREAM_CHUNK); \
+    for (p = 0; p < NEO_STREAM_CHUNK * pstride; p += NEO_CACHE_LINE) \
+      NEO_PREFETCH (src + (i + n) * pstride + p); \
+    neo_##name##_to_gray8_##isa (y, src + i * pstride, n, luma); \
+    neo_stream_copy_##isa (dest + i, y, n); \
+  } \
+  neo_stream_fence_##isa (); \
+}
+
+NEO_DEFINE_LAYOUTS (NEO_DEFINE_STREAM, scalar)
+#ifdef HAVE_SSE2
+NEO_DEFINE_LAYOUTS (NEO_DEFINE_STREAM, sse2)
+#endif
+#ifdef HAVE_AVX2
+NEO_DEFINE_LAYOUTS (NEO_DEFINE_STREAM, avx2)
+#endif
+#ifdef HAVE_NEON
+NEO_DEFINE_LAYOUTS (NEO_DEFINE_STREAM, neon)
+#endif
+
+/* plain C has no non-temporal stores */
+void
+neo_stream_copy_scalar (guint8 * dest, const guint8 * src, gint n)
+{
+  memcpy (dest, src, n);
+}
+
+void
+neo_stream_fence_scalar (void)
+{
+}
+
+#define NEO_MATRIX_APPLY(m, px, k) \
+    CLAMP (((m)->coeffs[k][0] * (px)[0] + (m)->coeffs[k][1] * (px)[1] + \
+        (m)->coeffs[k][2] * (px)[2] + (m)->coeffs[k][3] * (px)[3] + \
+        (m)->offsets[k]) >> NEO_MATRIX_SHIFT, 0, 255)
+
+void
+neo_color_matrix24_scalar (guint8 * data, gint width,
+    const NeoColorMatrix * matrix)
+{
+  guint8 px[4] = { 0, };
+  gint i, k;
+
+  for (i = 0; i < width; i++, data += 3) {
+    memcpy (px, data, 3);
+    for (k = 0; k < 3; k++)
+      data[k] = NEO_MATRIX_APPLY (matrix, px, k);
+  }
+}
+
+void
+neo_color_matrix32_scalar (guint8 * data, gint width,
+    const NeoColorMatrix * matrix)
+{
+  guint8 px[4];
+  gint i, k;
+
+  for (i = 0; i < width; i++, data += 4) {
+    memcpy (px, data, 4);
+    for (k = 0; k < 4; k++)
+      data[k] = NEO_MATRIX_APPLY (matrix, px, k);
+  }
+}
+
+void
+neo_conv_row_scalar (gint16 * dest, const guint8 * src, gint n, gint step,
+    const gint16 * taps, gint radius)
+{
+  gint i, k;
+
+  src -= radius * step;
+  for (i = 0; i < n; i++) {
+    guint sum = 0;
+
+    for (k = 0; k <= 2 * radius; k++)
+      sum += taps[k] * src[i + k * step];
+    dest[i] = (sum + (1 << (NEO_CONV_ROW_SHIFT - 1))) >> NEO_CONV_ROW_SHIFT;
+  }
+}
+
+void
+neo_conv_column_scalar (guint8 * dest, const gint16 * const *rows, gint n,
+    const gint16 * taps, gint radius)
+{
+  gint i, k;
+
+  for (i = 0; i < n; i++) {
+    gint sum = 1 << (NEO_CONV_COLUMN_SHIFT - 1);
+
+    for (k = 0; k <= 2 * radius; k++)
+      sum += taps[k] * rows[k][i];
+    dest[i] = CLAMP (sum >> NEO_CONV_COLUMN_SHIFT, 0, 255);
+  }
+}
+
+void
+neo_unsharp_scalar (guint8 * data, const guint8 * src, gint n, gint amount)
+{
+  gint i;
+
+  for (i = 0; i < n; i++) {
+    gint detail = ((src[i] - data[i]) * amount + 128) >> 8;
+
+    data[i] = CLAMP (src[i] + detail, 0, 255);
+  }
+}
+
+void
+neo_sobel_span_scalar (guint8 * dest, const guint8 * above,
+    const guint8 * row, const guint8 * below, gint start, gint end, gint n,
+    gint step)
+{
+  gint i;
+
+  for (i = start; i < end; i++) {
+    gint l = i >= step ? i - step : i;
+    gint r = i + step < n ? i + step : i;
+    gint gx = (above[r] - above[l]) + 2 * (row[r] - row[l]) +
+        (below[r] - below[l]);
+    gint gy = (below[l] + 2 * below[i] + below[r]) -
+        (above[l] + 2 * above[i] + above[r]);
+
+    dest[i] = MIN ((ABS (gx) + ABS (gy) + 2) >> 2, 255);
+  }
+}
+
+void
+neo_sobel_scalar (guint8 * dest, const guint8 * above, const guint8 * row,
+    const guint8 * below, gint n, gint step)
+{
+  neo_sobel_span_scalar (dest, above, row, below, 0, n, n, step);
+}
+
+/* Trilinear interpolation is three rounds of lerps, along R, G then B,
+ * each rounded back to the node scale. The SIMD kernels follow the same
+ * steps. Nodes stay within 0..255 * 128, so no result needs clamping. */
+#define NEO_LERP(a, b, f) (((a) * (256 - (f)) + (b) * (f) + 128) >> 8)
+
+void
+neo_lut3d_trilinear_scalar (guint8 * dest, const guint8 * src, gint width,
+    const NeoLut3D * lut)
+{
+  gint pstride = lut->pstride;
+  gint dr = lut->step[0] * 4, dg = lut->step[1] * 4, db = lut->step[2] * 4;
+  gint i, k, f[3];
+
+  for (i = 0; i < width; i++, src += pstride, dest += pstride) {
+    const gint16 *n = lut->nodes + neo_lut3d_cell (lut, src, f) * 4;
+    guint8 out[4];
+
+    for (k = 0; k < pstride; k++) {
+      gint c00 = NEO_LERP (n[k], n[dr + k], f[0]);
+      gint c10 = NEO_LERP (n[dg + k], n[dg + dr + k], f[0]);
+      gint c01 = NEO_LERP (n[db + k], n[db + dr + k], f[0]);
+      gint c11 = NEO_LERP (n[db + dg + k], n[db + dg + dr + k], f[0]);
+      gint c0 = NEO_LERP (c00, c10, f[1]);
+      gint c1 = NEO_LERP (c01, c11, f[1]);
+      gint c = NEO_LERP (c0, c1, f[2]);
+
+      out[k] = lut->keep[k] ? src[k] :
+          (c + (1 << (NEO_LUT3D_NODE_SHIFT - 1))) >> NEO_LUT3D_NODE_SHIFT;
+    }
+    memcpy (dest, out, pstride);
+  }
+}
+
+void
+neo_lut3d_tetrahedral_scalar (guint8 * dest, const guint8 * src, gint width,
+    const NeoLut3D * lut)
+{
+  gint pstride = lut->pstride;
+  guint32 node[4];
+  gint i, j, k, weight[4];
+
+  for (i = 0; i < width; i++, src += pstride, dest += pstride) {
+    guint8 out[4];
+
+    neo_lut3d_tetrahedron (lut, src, node, weight);
+    for (k = 0; k < pstride; k++) {
+      gint sum = 1 << (NEO_LUT3D_NODE_SHIFT + 7);
+
+      for (j = 0; j < 4; j++)
+        sum += weight[j] * lut->nodes[node[j] * 4 + k];
+      out[k] = lut->keep[k] ? src[k] : sum >> (NEO_LUT3D_NODE_SHIFT + 8);
+    }
+    memcpy (dest, out, pstride);
+  }
+}
+
+void
+neo_shrink4_scalar (guint8 * dest, const guint8 * const *rows, gint n)
+{
+  gint i, j, k;
+
+  for (i = 0; i < n; i++) {
+    gint sum = 8;
+
+    for (k = 0; k < 4; k++) {
+      for (j = 0; j < 4; j++)
+        sum += rows[k][4 * i + j];
+    }
+    dest[i] = sum >> 4;
+  }
+}
+
+void
+neo_block_sad_scalar (guint32 * sums, const guint8 * a, const guint8 * b,
+    gint n)
+{
+  gint i, j;
+
+  for (i = 0; i < n; i++) {
+    guint32 sum = 0;
+
+    for (j = 0; j < 8; j++)
+      sum += ABS (a[8 * i + j] - b[8 * i + j]);
+    sums[i] += sum;
+  }
+}
+
+static const NeoKernels neo_kernels_scalar = NEO_KERNELS_INIT (scalar);
+
+#ifdef HAVE_SSE2
+static const NeoKernels neo_kernels_sse2 = NEO_KERNELS_INIT (sse2);
+#endif
+
+#ifdef HAVE_AVX2
+static const NeoKernels neo_kernels_avx2 = NEO_KERNELS_INIT (avx2);
+#endif
+
+#ifdef HAVE_NEON
+static const NeoKernels neo_kernels_neon = NEO_KERNELS_INIT (neon);
+#endif
+
+static gboolean
+neo_cpu_has (const gchar * feature)
+{
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+  __builtin_cpu_init ();
+  if (g_str_equal (feature, "sse2"))
+    return __builtin_cpu_supports ("sse2");
+  if (g_str_equal (feature, "avx2"))
+    return __builtin_cpu_supports ("avx2");
+#elif defined(__aarch64__)
+  if (g_str_equal (feature, "neon"))
+    return TRUE;
+#elif defined(__arm__) && defined(__linux__) && defined(HWCAP_NEON)
+  if (g_str_equal (feature, "neon"))
+    return (getauxval (AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+  return FALSE;
+}
+
+/* Returns the usable kernel sets, best first, terminated by NULL */
+const NeoKernels *const *
+neo_kernels_get_available (void)
+{
+  static const NeoKernels *available[5];
+  static gsize init = 0;
+
+  if (g_once_init_enter (&init)) {
+    gint n = 0;
+
+#ifdef HAVE_AVX2
+    if (neo_cpu_has ("avx2"))
+      available[n++] = &neo_kernels_avx2;
+#endif
+#ifdef HAVE_SSE2
+    if (neo_cpu_has ("sse2"))
+      available[n++] = &neo_kernels_sse2;
+#endif
+#ifdef HAVE_NEON
+    if (neo_cpu_has ("neon"))
+      available[n++] = &neo_kernels_neon;
+#endif
+    available[n++] = &neo_kernels_scalar;
+    available[n] = NULL;
+
+    g_once_init_leave (&init, 1);
+  }
+
+  return available;
+}
+
+/* The best available set, unless NEOVIDEOCONV_KERNELS names another
+ * available one, e.g. to compare them */
+const NeoKernels *
+neo_kernels_get_default (void)
+{
+  const gchar *name = g_getenv ("NEOVIDEOCONV_KERNELS");
+  const NeoKernels *kernels = NULL;
+
+  if (name)
+    kernels = neo_kernels_get_by_name (name);
+
+  return kernels ? kernels : neo_kernels_get_available ()[0];
+}
+
+const NeoKernels *
+neo_kernels_get_by_name (const gchar * name)
+{
+  const NeoKernels *const *k;
+
+  for (k = neo_kernels_get_available (); *k; k++) {
+    if (g_str_equal ((*k)->name, name))
+      return *k;
+  }
+
+  return NULL;
+}
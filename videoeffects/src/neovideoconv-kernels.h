@@ -0,0 +1,380 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _NEOVIDEOCONV_KERNELS_H_
+#define _NEOVIDEOCONV_KERNELS_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Weighted methods use fixed-point weights scaled by 256 that sum to 256.
+ * y = (wr * r + wg * g + wb * b + 128) >> 8 never exceeds 16 bits, which
+ * lets the SIMD kernels stay in 16-bit lanes and still match the scalar
+ * reference bit for bit. */
+#define NEO_LUMA_SHIFT 8
+#define NEO_LUMA_ROUND (1 << (NEO_LUMA_SHIFT - 1))
+
+typedef enum
+{
+  NEO_LUMA_BT601,
+  NEO_LUMA_BT709,
+  NEO_LUMA_BT2020,
+  NEO_LUMA_AVERAGE,
+  NEO_LUMA_LIGHTNESS,           /* (min + max + 1) / 2, not weighted */
+} NeoLumaMethod;
+
+typedef struct _NeoLuma NeoLuma;
+
+/* Everything the kernels need to know about the luma method. The scalar
+ * kernels use the tables, where lut[c][v] = weights[c] * v with the
+ * rounding folded into the R table, the SIMD ones the weights. */
+struct _NeoLuma
+{
+  gboolean lightness;
+  gint weights[3];
+  guint16 lut[3][256];
+};
+
+void neo_luma_init (NeoLuma * luma, NeoLumaMethod method);
+
+/* Packed 24/32-bit layouts, named after their byte order in memory. Alpha
+ * and padding bytes are ignored so e.g. RGBx and RGBA share a layout. */
+typedef enum
+{
+  NEO_LAYOUT_RGB,               /* RGB */
+  NEO_LAYOUT_BGR,               /* BGR */
+  NEO_LAYOUT_RGBX,              /* RGBx, RGBA */
+  NEO_LAYOUT_BGRX,              /* BGRx, BGRA */
+  NEO_LAYOUT_XRGB,              /* xRGB, ARGB */
+  NEO_LAYOUT_XBGR,              /* xBGR, ABGR */
+  NEO_N_LAYOUTS
+} NeoLayout;
+
+/* A 3x4 colour matrix mapped onto the bytes of a packed pixel: byte k of
+ * the output is (sum over j of coeffs[k][j] * byte j + offsets[k]) >> 8,
+ * clamped to 0..255. Coefficients are scaled by 256 and stay within
+ * -2048..2047, offsets are scaled by 256 with the rounding folded in.
+ * Alpha and padding bytes map to themselves. */
+#define NEO_MATRIX_SHIFT 8
+#define NEO_MATRIX_COEFF_MIN -2048
+#define NEO_MATRIX_COEFF_MAX 2047
+
+typedef struct _NeoColorMatrix NeoColorMatrix;
+
+struct _NeoColorMatrix
+{
+  gint16 coeffs[4][4];
+  gint32 offsets[4];
+};
+
+/* Separable filters work on bytes: a row of n bytes whose horizontal
+ * neighbours are step bytes apart, 1 for GRAY8 and the pixel stride for
+ * packed RGB, so every component is filtered on its own. Taps are scaled
+ * by 256, non-negative and sum to 256. The horizontal pass keeps 6
+ * fractional bits in 16-bit lanes, the vertical pass rounds them away. */
+#define NEO_CONV_MAX_RADIUS 16
+#define NEO_CONV_ROW_SHIFT 2
+#define NEO_CONV_COLUMN_SHIFT 14
+
+/* A 3D colour lookup table laid out for the pixels of one format. nodes
+ * holds 4 values per node, in the byte order of the pixel with 0 for the
+ * byte that isn't R, G or B, scaled by 128 and within 0..255 * 128. For
+ * input component c of value v, index[c][v] is the distance in nodes of
+ * the node at or below v from the first node and frac[c][v] the weight of
+ * the next node along c out of 256, step[c] the distance between the two.
+ * The bytes set in keep, in the pixel's byte order, are copied from the
+ * input pixel. */
+#define NEO_LUT3D_NODE_SHIFT 7
+
+typedef struct _NeoLut3D NeoLut3D;
+
+struct _NeoLut3D
+{
+  gint pstride;
+  gint offsets[3];
+  guint8 keep[4];
+  const gint16 *nodes;
+  guint32 step[3];
+  guint32 index[3][256];
+  guint16 frac[3][256];
+};
+
+/* The node at the low corner of the cell holding pixel @px, in nodes from
+ * the first one, and the position of @px in the cell out of 256 */
+static inline guint32
+neo_lut3d_cell (const NeoLut3D * lut, const guint8 * px, gint frac[3])
+{
+  guint32 node = 0;
+  gint c;
+
+  for (c = 0; c < 3; c++) {
+    guint v = px[lut->offsets[c]];
+
+    node += lut->index[c][v];
+    frac[c] = lut->frac[c][v];
+  }
+
+  return node;
+}
+
+/* The four corners of the tetrahedron of the cell holding pixel @px and
+ * their weights out of 256. The cell is split along its diagonal by the
+ * order of the three fractions. */
+static inline void
+neo_lut3d_tetrahedron (const NeoLut3D * lut, const guint8 * px,
+    guint32 node[4], gint weight[4])
+{
+  guint32 dr = lut->step[0], dg = lut->step[1], db = lut->step[2];
+  guint32 d1, d2;
+  gint f[3], f1, f2, f3;
+
+  node[0] = neo_lut3d_cell (lut, px, f);
+
+  if (f[0] > f[1]) {
+    if (f[1] > f[2]) {
+      d1 = dr, d2 = dr + dg, f1 = f[0], f2 = f[1], f3 = f[2];
+    } else if (f[0] > f[2]) {
+      d1 = dr, d2 = dr + db, f1 = f[0], f2 = f[2], f3 = f[1];
+    } else {
+      d1 = db, d2 = db + dr, f1 = f[2], f2 = f[0], f3 = f[1];
+    }
+  } else {
+    if (f[2] > f[1]) {
+      d1 = db, d2 = db + dg, f1 = f[2], f2 = f[1], f3 = f[0];
+    } else if (f[2] > f[0]) {
+      d1 = dg, d2 = dg + db, f1 = f[1], f2 = f[2], f3 = f[0];
+    } else {
+      d1 = dg, d2 = dg + dr, f1 = f[1], f2 = f[0], f3 = f[2];
+    }
+  }
+
+  node[1] = node[0] + d1;
+  node[2] = node[0] + d2;
+  node[3] = node[0] + dr + dg + db;
+  weight[0] = 256 - f1;
+  weight[1] = f1 - f2;
+  weight[2] = f2 - f3;
+  weight[3] = f3;
+}
+
+/* Converts @width packed pixels of one row into GRAY8 */
+typedef void (*NeoToGray8Func) (guint8 * dest, const guint8 * src,
+    gint width, const NeoLuma * luma);
+/* Same, writing @width GRAY16_LE values that keep the 8 fractional bits of
+ * the weighted sum */
+typedef NeoToGray8Func NeoToGray16Func;
+/* Replaces R, G and B of @width packed pixels with their luma, in place */
+typedef void (*NeoDesaturateFunc) (guint8 * data, gint width,
+    const NeoLuma * luma);
+/* Applies @matrix to @width packed pixels, in place */
+typedef void (*NeoColorMatrixFunc) (guint8 * data, gint width,
+    const NeoColorMatrix * matrix);
+
+/* Horizontal pass: dest[i] is the sum of taps[k] * src[i + (k - radius) *
+ * step] over the 2 * radius + 1 taps, shifted down by NEO_CONV_ROW_SHIFT.
+ * Reads radius * step bytes before and after the @n bytes of @src. */
+typedef void (*NeoConvRowFunc) (gint16 * dest, const guint8 * src, gint n,
+    gint step, const gint16 * taps, gint radius);
+/* Vertical pass over the 2 * radius + 1 horizontal pass rows in @rows,
+ * writing the rounded and clamped sums weighted by @taps */
+typedef void (*NeoConvColumnFunc) (guint8 * dest, const gint16 * const *rows,
+    gint n, const gint16 * taps, gint radius);
+/* Unsharp mask: @data holds the blur of @src and becomes src + (src - blur)
+ * * amount / 256, clamped */
+typedef void (*NeoUnsharpFunc) (guint8 * data, const guint8 * src, gint n,
+    gint amount);
+/* Sobel gradient magnitude (|gx| + |gy|) / 4 of the @n bytes of @row, its
+ * neighbours @step bytes apart. Edge bytes reuse themselves for the
+ * missing neighbour, @above and @below are the rows around @row. */
+typedef void (*NeoSobelFunc) (guint8 * dest, const guint8 * above,
+    const guint8 * row, const guint8 * below, gint n, gint step);
+
+/* Maps @width packed pixels of @src through @lut into @dest, which may be
+ * @src */
+typedef void (*NeoLut3DFunc) (guint8 * dest, const guint8 * src, gint width,
+    const NeoLut3D * lut);
+
+/* Shrinks 4 rows by 4 in both directions: dest[i] is the rounded mean of
+ * the 4x4 bytes starting at byte 4 * i of each of the 4 @rows, for @n
+ * bytes of @dest */
+typedef void (*NeoShrink4Func) (guint8 * dest, const guint8 * const *rows,
+    gint n);
+/* Adds the sum of absolute differences of each of the @n groups of 8 bytes
+ * of @a and @b to the matching one of @sums */
+typedef void (*NeoBlockSadFunc) (guint32 * sums, const guint8 * a,
+    const guint8 * b, gint n);
+
+typedef struct _NeoKernels NeoKernels;
+
+struct _NeoKernels
+{
+  const gchar *name;
+  NeoToGray8Func to_gray8[NEO_N_LAYOUTS];
+  NeoDesaturateFunc desaturate[NEO_N_LAYOUTS];
+  NeoToGray16Func to_gray16[NEO_N_LAYOUTS];
+  /* to_gray8 for frames larger than the cache: the source is prefetched
+   * ahead and the output written with non-temporal stores, so neither
+   * evicts what downstream still needs. Same output as to_gray8. */
+  NeoToGray8Func to_gray8_stream[NEO_N_LAYOUTS];
+  /* colour matrix over 3 and 4 byte pixels, whatever their layout */
+  NeoColorMatrixFunc color_matrix24;
+  NeoColorMatrixFunc color_matrix32;
+  /* convolution passes of neoconvolve */
+  NeoConvRowFunc conv_row;
+  NeoConvColumnFunc conv_column;
+  NeoUnsharpFunc unsharp;
+  NeoSobelFunc sobel;
+  /* 3D LUT interpolation of neolut3d, SIMD for 4-byte pixels only */
+  NeoLut3DFunc lut3d_trilinear;
+  NeoLut3DFunc lut3d_tetrahedral;
+  /* background difference of neomotion */
+  NeoShrink4Func shrink4;
+  NeoBlockSadFunc block_sad;
+};
+
+const NeoKernels *neo_kernels_get_default (void);
+const NeoKernels *neo_kernels_get_by_name (const gchar * name);
+const NeoKernels *const *neo_kernels_get_available (void);
+
+/* Every instruction set provides one function per layout, with the pixel
+ * stride and component offsets baked in at compile time. These are only
+ * meant to be used by the dispatcher. */
+#define NEO_DECLARE_KERNELS(isa) \
+  void neo_rgb_to_gray8_##isa (guint8 * dest, const guint8 * src, gint width, \
+      const NeoLuma * luma); \
+  void neo_bgr_to_gray8_##isa (guint8 * dest, const guint8 * src, gint width, \
+      const NeoLuma * luma); \
+  void neo_rgbx_to_gray8_##isa (guint8 * dest, const guint8 * src, gint width, \
+      const NeoLuma * luma); \
+  void neo_bgrx_to_gray8_##isa (guint8 * dest, const guint8 * src, gint width, \
+      const NeoLuma * luma); \
+  void neo_xrgb_to_gray8_##isa (guint8 * dest, const guint8 * src, gint width, \
+      const NeoLuma * luma); \
+  void neo_xbgr_to_gray8_##isa (guint8 * dest, const guint8 * src, gint width, \
+      const NeoLuma * luma); \
+  void neo_rgb_desaturate_##isa (guint8 * data, gint width, \
+      const NeoLuma * luma); \
+  void neo_bgr_desaturate_##isa (guint8 * data, gint width, \
+      const NeoLuma * luma); \
+  void neo_rgbx_desaturate_##isa (guint8 * data, gint width, \
+      const NeoLuma * luma); \
+  void neo_bgrx_desaturate_##isa (guint8 * data, gint width, \
+      const NeoLuma * luma); \
+  void neo_xrgb_desaturate_##isa (guint8 * data, gint width, \
+      const NeoLuma * luma); \
+  void neo_xbgr_desaturate_##isa (guint8 * data, gint width, \
+      const NeoLuma * luma); \
+  void neo_rgb_to_gray8_stream_##isa (guint8 * dest, const guint8 * src, \
+      gint width, const NeoLuma * luma); \
+  void neo_bgr_to_gray8_stream_##isa (guint8 * dest, const guint8 * src, \
+      gint width, const NeoLuma * luma); \
+  void neo_rgbx_to_gray8_stream_##isa (guint8 * dest, const guint8 * src, \
+      gint width, const NeoLuma * luma); \
+  void neo_bgrx_to_gray8_stream_##isa (guint8 * dest, const guint8 * src, \
+      gint width, const NeoLuma * luma); \
+  void neo_xrgb_to_gray8_stream_##isa (guint8 * dest, const guint8 * src, \
+      gint width, const NeoLuma * luma); \
+  void neo_xbgr_to_gray8_stream_##isa (guint8 * dest, const guint8 * src, \
+      gint width, const NeoLuma * luma); \
+  /* copies @n bytes bypassing the cache where the instruction set can, \
+   * the stores are ordered once neo_stream_fence_##isa () returns */ \
+  void neo_stream_copy_##isa (guint8 * dest, const guint8 * src, gint n); \
+  void neo_stream_fence_##isa (void); \
+  void neo_color_matrix32_##isa (guint8 * data, gint width, \
+      const NeoColorMatrix * matrix); \
+  void neo_conv_row_##isa (gint16 * dest, const guint8 * src, gint n, \
+      gint step, const gint16 * taps, gint radius); \
+  void neo_conv_column_##isa (guint8 * dest, const gint16 * const *rows, \
+      gint n, const gint16 * taps, gint radius); \
+  void neo_unsharp_##isa (guint8 * data, const guint8 * src, gint n, \
+      gint amount); \
+  void neo_sobel_##isa (guint8 * dest, const guint8 * above, \
+      const guint8 * row, const guint8 * below, gint n, gint step); \
+  void neo_lut3d_trilinear_##isa (guint8 * dest, const guint8 * src, \
+      gint width, const NeoLut3D * lut); \
+  void neo_lut3d_tetrahedral_##isa (guint8 * dest, const guint8 * src, \
+      gint width, const NeoLut3D * lut); \
+  void neo_shrink4_##isa (guint8 * dest, const guint8 * const *rows, \
+      gint n); \
+  void neo_block_sad_##isa (guint32 * sums, const guint8 * a, \
+      const guint8 * b, gint n)
+
+/* Instantiates one function per layout for instruction set @isa from a
+ * define (isa, name, pixel stride, R offset, G offset, B offset) macro */
+#define NEO_DEFINE_LAYOUTS(define, isa) \
+  define (isa, rgb, 3, 0, 1, 2) \
+  define (isa, bgr, 3, 2, 1, 0) \
+  define (isa, rgbx, 4, 0, 1, 2) \
+  define (isa, bgrx, 4, 2, 1, 0) \
+  define (isa, xrgb, 4, 1, 2, 3) \
+  define (isa, xbgr, 4, 3, 2, 1)
+
+#define NEO_KERNELS_INIT(isa) { \
+    #isa, { \
+      neo_rgb_to_gray8_##isa, neo_bgr_to_gray8_##isa, \
+      neo_rgbx_to_gray8_##isa, neo_bgrx_to_gray8_##isa, \
+      neo_xrgb_to_gray8_##isa, neo_xbgr_to_gray8_##isa, \
+    }, { \
+      neo_rgb_desaturate_##isa, neo_bgr_desaturate_##isa, \
+      neo_rgbx_desaturate_##isa, neo_bgrx_desaturate_##isa, \
+      neo_xrgb_desaturate_##isa, neo_xbgr_desaturate_##isa, \
+    }, { \
+      neo_rgb_to_gray16_scalar, neo_bgr_to_gray16_scalar, \
+      neo_rgbx_to_gray16_scalar, neo_bgrx_to_gray16_scalar, \
+      neo_xrgb_to_gray16_scalar, neo_xbgr_to_gray16_scalar, \
+    }, { \
+      neo_rgb_to_gray8_stream_##isa, neo_bgr_to_gray8_stream_##isa, \
+      neo_rgbx_to_gray8_stream_##isa, neo_bgrx_to_gray8_stream_##isa, \
+      neo_xrgb_to_gray8_stream_##isa, neo_xbgr_to_gray8_stream_##isa, \
+    }, \
+    neo_color_matrix24_scalar, neo_color_matrix32_##isa, \
+    neo_conv_row_##isa, neo_conv_column_##isa, neo_unsharp_##isa, \
+    neo_sobel_##isa, neo_lut3d_trilinear_##isa, \
+    neo_lut3d_tetrahedral_##isa, neo_shrink4_##isa, neo_block_sad_##isa, \
+  }
+
+NEO_DECLARE_KERNELS (scalar);
+
+/* GRAY16 output is rare enough that every set shares the scalar kernels */
+#define NEO_DECLARE_GRAY16(isa, name, pstride, r, g, b) \
+  void neo_##name##_to_gray16_scalar (guint8 * dest, const guint8 * src, \
+      gint width, const NeoLuma * luma);
+NEO_DEFINE_LAYOUTS (NEO_DECLARE_GRAY16, scalar)
+/* and so do 3-byte pixels for the colour matrix, they are hardly used with
+ * effects */
+void neo_color_matrix24_scalar (guint8 * data, gint width,
+    const NeoColorMatrix * matrix);
+/* Sobel of bytes @start to @end of a row, for the edges and tails the SIMD
+ * kernels leave out */
+void neo_sobel_span_scalar (guint8 * dest, const guint8 * above,
+    const guint8 * row, const guint8 * below, gint start, gint end, gint n,
+    gint step);
+#ifdef HAVE_SSE2
+NEO_DECLARE_KERNELS (sse2);
+#endif
+#ifdef HAVE_AVX2
+NEO_DECLARE_KERNELS (avx2);
+#endif
+#ifdef HAVE_NEON
+NEO_DECLARE_KERNELS (neon);
+#endif
+
+G_END_DECLS
+#endif
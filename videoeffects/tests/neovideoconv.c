@@ -0,0 +1,94 @@
+/* GStreamer
+ * Copyright (C) 2022 Taruntej Kanakamalla <taruntejk@live.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+
+#define I420_CAPS "video/x-raw,format=I420,width=64,height=64,framerate=30/1"
+
+/* in place only the chroma of the regions of interest is neutralised */
+GST_START_TEST (test_roi_in_place_keeps_chroma)
+{
+  GstHarness *h = gst_harness_new_parse ("neovideoconv roi=true");
+  GstCaps *caps = gst_caps_from_string (I420_CAPS);
+  GstVideoInfo info;
+  GstVideoFrame frame;
+  GstBuffer *buf;
+  guint8 *u, *v;
+  gint u_stride, v_stride, x, y;
+
+  gst_harness_set_caps (h, gst_caps_ref (caps), gst_caps_ref (caps));
+  fail_unless (gst_video_info_from_caps (&info, caps));
+  gst_caps_unref (caps);
+
+  buf = gst_buffer_new_allocate (NULL, info.size, NULL);
+  fail_unless (gst_video_frame_map (&frame, &info, buf, GST_MAP_WRITE));
+  memset (GST_VIDEO_FRAME_PLANE_DATA (&frame, 0), 200,
+      GST_VIDEO_FRAME_PLANE_STRIDE (&frame, 0) * 64);
+  memset (GST_VIDEO_FRAME_PLANE_DATA (&frame, 1), 50,
+      GST_VIDEO_FRAME_PLANE_STRIDE (&frame, 1) * 32);
+  memset (GST_VIDEO_FRAME_PLANE_DATA (&frame, 2), 60,
+      GST_VIDEO_FRAME_PLANE_STRIDE (&frame, 2) * 32);
+  gst_video_frame_unmap (&frame);
+  gst_buffer_add_video_region_of_interest_meta (buf, "face", 16, 16, 16, 16);
+
+  buf = gst_harness_push_and_pull (h, buf);
+  fail_unless (buf != NULL);
+  fail_unless (gst_video_frame_map (&frame, &info, buf, GST_MAP_READ));
+  u = GST_VIDEO_FRAME_PLANE_DATA (&frame, 1);
+  v = GST_VIDEO_FRAME_PLANE_DATA (&frame, 2);
+  u_stride = GST_VIDEO_FRAME_PLANE_STRIDE (&frame, 1);
+  v_stride = GST_VIDEO_FRAME_PLANE_STRIDE (&frame, 2);
+  for (y = 0; y < 32; y++) {
+    for (x = 0; x < 32; x++) {
+      gboolean inside = x >= 8 && x < 16 && y >= 8 && y < 16;
+
+      fail_unless_equals_int (u[y * u_stride + x], inside ? 128 : 50);
+      fail_unless_equals_int (v[y * v_stride + x], inside ? 128 : 60);
+    }
+  }
+  fail_unless_equals_int (((guint8 *) GST_VIDEO_FRAME_PLANE_DATA (&frame,
+              0))[0], 200);
+  gst_video_frame_unmap (&frame);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+neovideoconv_suite (void)
+{
+  Suite *s = suite_create ("neovideoconv");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_roi_in_place_keeps_chroma);
+
+  return s;
+}
+
+GST_CHECK_MAIN (neovideoconv);